@@ -0,0 +1,394 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+// BoostTestCmd runs a unit test executable like BoostTestUi does, without
+// the gui. Results are written to the console or to a file and the exit code
+// tells whether all tests passed. Given a directory, it runs all unit test
+// executables in it and its subdirectories.
+
+#include <csignal>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include "Utilities.h"
+#include "ExeRunner.h"
+#include "Workspace.h"
+#include "ListingCache.h"
+#include "ConsoleObserver.h"
+
+namespace gj {
+
+struct ExitCode
+{
+	enum type
+	{
+		Passed = 0,
+		Failed = 1,
+		Error = 2
+	};
+};
+
+class UsageError : public std::runtime_error
+{
+public:
+	explicit UsageError(const std::string& msg) : std::runtime_error(msg)
+	{
+	}
+};
+
+struct CmdOptions
+{
+	CmdOptions() : logLevel(1), options(0), processes(0), iterations(1), timeout(0), runTimeout(0), memoryLimit(0), jobs(0), list(false), noCache(false)
+	{
+	}
+
+	std::wstring fileName;
+	std::wstring arguments;
+	std::vector<std::string> run;
+	std::string output;
+	int logLevel;
+	unsigned options;
+	unsigned processes;
+	unsigned iterations;
+	unsigned timeout;
+	unsigned runTimeout;
+	unsigned memoryLimit;
+	unsigned jobs;
+	bool list;
+	bool noCache;
+};
+
+void WriteUsage(std::ostream& os)
+{
+	os <<
+		"Usage: BoostTestCmd [options] <unit test executable> [--args <arguments>]\n"
+		"       BoostTestCmd [options] <directory>\n"
+		"\n"
+		"A directory is searched for unit test executables, these run concurrently\n"
+		"as one test run.\n"
+		"\n"
+		"Options:\n"
+		"  --run <test>          Run only this test case or suite, may be repeated\n"
+		"  --log_level <level>   error, message (default) or all\n"
+		"  --randomize           Run the test cases in random order\n"
+		"  --repeat              Repeat the test run until a test fails\n"
+		"  --iterations <n>      Run the tests n times in one test process, stop at the\n"
+		"                        first failure, 0: until a test fails\n"
+		"  --resident            Repeat in the same test process, without restarting it\n"
+		"  --isolate             Run each test case in a forked process of its own\n"
+		"  --zygote              With --parallel, fork the workers from one test process\n"
+		"  --wait_for_debugger   Wait for a debugger to attach before running\n"
+		"  --parallel <n>        Run the test cases in n processes, 0: one per core\n"
+		"  --timeout <s>         Kill a test case that runs longer than s seconds\n"
+		"  --run_timeout <s>     Abort the test run when it takes longer than s seconds\n"
+		"  --memory_limit <MB>   Limit the address space of each test process (POSIX)\n"
+		"  --output <file>       Write the test log to file instead of the console\n"
+		"  --list                List the test cases and exit\n"
+		"  --no_cache            Always start the executables to list their test cases\n"
+		"  --jobs <n>            Examine and run at most n executables of a directory\n"
+		"                        at a time, 0: one per core (default)\n"
+		"  --args <arguments>    Pass all remaining arguments to the unit test\n"
+		"\n"
+		"Exit code: 0 if all tests passed, 1 if a test failed, 2 on errors.\n";
+}
+
+int GetLogLevel(const std::string& level)
+{
+	if (level == "error")
+		return 0;
+	if (level == "message")
+		return 1;
+	if (level == "all")
+		return 2;
+	throw UsageError("Invalid log level: " + level);
+}
+
+unsigned GetNumber(const std::string& value)
+{
+	std::istringstream ss(value);
+	unsigned number;
+	if (!(ss >> number) || !ss.eof())
+		throw UsageError("Invalid number: " + value);
+	return number;
+}
+
+std::wstring QuoteArg(const std::string& arg)
+{
+	if (arg.find_first_of(" \t") == std::string::npos)
+		return MultiByteToWideChar(arg);
+	return L"\"" + MultiByteToWideChar(arg) + L"\"";
+}
+
+CmdOptions ParseCommandLine(int argc, char* argv[])
+{
+	CmdOptions cmd;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		auto value = [&]() -> std::string
+		{
+			if (i + 1 >= argc)
+				throw UsageError("Missing value for " + arg);
+			return argv[++i];
+		};
+
+		if (arg == "--args")
+		{
+			while (++i < argc)
+			{
+				if (!cmd.arguments.empty())
+					cmd.arguments += L' ';
+				cmd.arguments += QuoteArg(argv[i]);
+			}
+		}
+		else if (arg.substr(0, 2) != "--")
+			cmd.fileName = MultiByteToWideChar(arg);
+		else if (arg == "--run")
+			cmd.run.push_back(value());
+		else if (arg == "--log_level")
+			cmd.logLevel = GetLogLevel(value());
+		else if (arg == "--randomize")
+			cmd.options |= TestRunner::Randomize;
+		else if (arg == "--repeat")
+			cmd.options |= TestRunner::Repeat;
+		else if (arg == "--iterations")
+			cmd.iterations = GetNumber(value());
+		else if (arg == "--resident")
+			cmd.options |= TestRunner::Resident;
+		else if (arg == "--isolate")
+			cmd.options |= TestRunner::Isolate;
+		else if (arg == "--zygote")
+			cmd.options |= TestRunner::Zygote;
+		else if (arg == "--wait_for_debugger")
+			cmd.options |= TestRunner::WaitForDebugger;
+		else if (arg == "--parallel")
+		{
+			cmd.options |= TestRunner::Parallel;
+			cmd.processes = GetNumber(value());
+		}
+		else if (arg == "--timeout")
+			cmd.timeout = GetNumber(value());
+		else if (arg == "--run_timeout")
+			cmd.runTimeout = GetNumber(value());
+		else if (arg == "--memory_limit")
+			cmd.memoryLimit = GetNumber(value());
+		else if (arg == "--output")
+			cmd.output = value();
+		else if (arg == "--list")
+			cmd.list = true;
+		else if (arg == "--no_cache")
+			cmd.noCache = true;
+		else if (arg == "--jobs")
+			cmd.jobs = GetNumber(value());
+		else
+			throw UsageError("Unknown option: " + arg);
+	}
+
+	if (cmd.fileName.empty())
+		throw UsageError("No unit test executable specified");
+	return cmd;
+}
+
+// Enables the test cases that match one of the --run names, by full name
+// with or without the name of the root test suite. A suite name selects
+// all test cases in it.
+class SelectTestUnits : public TestTreeVisitor
+{
+public:
+	SelectTestUnits(TestRunner& runner, const std::vector<std::string>& names) :
+		m_pRunner(&runner),
+		m_names(names),
+		m_count(0)
+	{
+	}
+
+	unsigned count() const
+	{
+		return m_count;
+	}
+
+	virtual void VisitTestCase(TestCase& tc) override
+	{
+		bool enable = IsSelected(tc.fullName);
+		m_pRunner->EnableTestUnit(tc.id, enable);
+		if (enable)
+		{
+			++m_count;
+			for (auto it = m_suites.begin(); it != m_suites.end(); ++it)
+				m_pRunner->EnableTestUnit((*it)->id, true);
+		}
+	}
+
+	virtual void EnterTestSuite(TestSuite& ts) override
+	{
+		if (m_suites.empty())
+			m_rootPrefix = ts.fullName + ".";
+		m_pRunner->EnableTestUnit(ts.id, false);
+		m_suites.push_back(&ts);
+	}
+
+	virtual void LeaveTestSuite() override
+	{
+		m_suites.pop_back();
+	}
+
+private:
+	static bool Matches(const std::string& fullName, const std::string& name)
+	{
+		return fullName.compare(0, name.size(), name) == 0 &&
+			(fullName.size() == name.size() || fullName[name.size()] == '.');
+	}
+
+	bool IsSelected(const std::string& fullName) const
+	{
+		for (auto it = m_names.begin(); it != m_names.end(); ++it)
+		{
+			if (Matches(fullName, *it) || Matches(fullName, m_rootPrefix + *it))
+				return true;
+		}
+		return false;
+	}
+
+	TestRunner* m_pRunner;
+	std::vector<std::string> m_names;
+	std::string m_rootPrefix;
+	std::vector<TestSuite*> m_suites;
+	unsigned m_count;
+};
+
+class ListTestCases : public TestTreeVisitor
+{
+public:
+	explicit ListTestCases(std::ostream& os) : m_pOs(&os)
+	{
+	}
+
+	virtual void VisitTestCase(TestCase& tc) override
+	{
+		if (tc.enabled)
+			*m_pOs << tc.fullName << "\n";
+	}
+
+private:
+	std::ostream* m_pOs;
+};
+
+volatile std::sig_atomic_t g_interrupted = 0;
+
+extern "C" void OnInterrupt(int /*signal*/)
+{
+	g_interrupted = 1;
+}
+
+// Runs the selected test cases of an ExeRunner or a Workspace.
+template <typename Runner>
+int RunTests(Runner& runner, ConsoleObserver& observer, const CmdOptions& cmd, std::ostream& os)
+{
+	if (!cmd.run.empty())
+	{
+		SelectTestUnits select(runner, cmd.run);
+		runner.TraverseTestTree(select);
+		if (select.count() == 0)
+			throw std::runtime_error("No test cases selected");
+	}
+
+	if (cmd.list)
+	{
+		ListTestCases list(os);
+		runner.TraverseTestTree(list);
+		return ExitCode::Passed;
+	}
+
+	runner.SetTimeouts(cmd.timeout, cmd.runTimeout);
+	runner.SetMemoryLimit(cmd.memoryLimit);
+
+	// Ctrl-C stops the test processes and a --repeat loop, the summary is still written.
+	std::signal(SIGINT, OnInterrupt);
+	runner.Run(cmd.logLevel, cmd.options, cmd.arguments);
+	while (!observer.WaitForFinish(100))
+	{
+		if (g_interrupted)
+			runner.Abort();
+	}
+	runner.Wait();
+	observer.WriteSummary();
+	return observer.Passed() ? ExitCode::Passed : ExitCode::Failed;
+}
+
+// Runs all unit test executables in a directory. An executable that cannot be
+// listed is reported and makes the exit code 2, the others still run.
+int RunWorkspace(const CmdOptions& cmd, std::ostream& os)
+{
+	ConsoleObserver observer(os);
+	Workspace workspace(cmd.fileName, observer, cmd.jobs);
+	observer.SetRunner(workspace);
+	if (workspace.Size() == 0)
+		throw std::runtime_error("No unit test executables found");
+
+	bool error = false;
+	for (std::size_t i = 0; i < workspace.Size(); ++i)
+	{
+		if (!workspace.GetRunner(i))
+		{
+			std::cerr << Str(workspace.GetFileName(i)) << ": " << workspace.GetError(i) << "\n";
+			error = true;
+		}
+	}
+
+	int exitCode = RunTests(workspace, observer, cmd, os);
+	return error ? ExitCode::Error : exitCode;
+}
+
+int Run(const CmdOptions& cmd)
+{
+	std::ofstream file;
+	if (!cmd.output.empty())
+	{
+		file.open(cmd.output.c_str());
+		if (!file)
+			throw std::runtime_error("Cannot open " + cmd.output);
+	}
+	std::ostream& os = cmd.output.empty() ? std::cout : file;
+
+	if (cmd.noCache)
+		ListingCache::SetDirectory(std::wstring());
+	if (boost::filesystem::is_directory(cmd.fileName))
+		return RunWorkspace(cmd, os);
+
+	ConsoleObserver observer(os);
+	ExeRunner runner(cmd.fileName, observer);
+	observer.SetRunner(runner);
+
+	if (cmd.processes > 0)
+		runner.SetShardCount(cmd.processes);
+	runner.SetIterations(cmd.iterations);
+	return RunTests(runner, observer, cmd, os);
+}
+
+} // namespace gj
+
+int main(int argc, char* argv[])
+try
+{
+	return gj::Run(gj::ParseCommandLine(argc, argv));
+}
+catch (gj::UsageError& ex)
+{
+	std::cerr << "BoostTestCmd: " << ex.what() << "\n\n";
+	gj::WriteUsage(std::cerr);
+	return gj::ExitCode::Error;
+}
+catch (std::exception& ex)
+{
+	std::cerr << "BoostTestCmd: " << ex.what() << "\n";
+	return gj::ExitCode::Error;
+}
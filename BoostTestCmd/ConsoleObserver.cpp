@@ -0,0 +1,221 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#include <iomanip>
+#include <iostream>
+#include "Utilities.h"
+#include "ConsoleObserver.h"
+
+namespace gj {
+
+ConsoleObserver::ConsoleObserver(std::ostream& os) :
+	m_pOs(&os),
+	m_pRunner(nullptr),
+	m_testCaseState(TestCaseState::Success),
+	m_testsRunCount(0),
+	m_ignoredTestCount(0),
+	m_testIterationCount(0),
+	m_assertionsPassed(0),
+	m_assertionsFailed(0),
+	m_error(false),
+	m_finished(false)
+{
+}
+
+void ConsoleObserver::SetRunner(TestRunner& runner)
+{
+	m_pRunner = &runner;
+}
+
+unsigned ConsoleObserver::TestsRunCount() const
+{
+	return m_testsRunCount;
+}
+
+unsigned ConsoleObserver::FailedTestCount() const
+{
+	return m_failedTests.size();
+}
+
+unsigned ConsoleObserver::IgnoredTestCount() const
+{
+	return m_ignoredTestCount;
+}
+
+unsigned ConsoleObserver::TestIterationCount() const
+{
+	return m_testIterationCount;
+}
+
+bool ConsoleObserver::Passed() const
+{
+	return !m_error && m_failedTests.empty();
+}
+
+bool ConsoleObserver::WaitForFinish(unsigned milliseconds)
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	if (!m_finished)
+		m_finishedCondition.timed_wait(lock, boost::posix_time::milliseconds(milliseconds));
+	return m_finished;
+}
+
+void ConsoleObserver::WriteSummary()
+{
+	*m_pOs << "Test iterations: " << m_testIterationCount;
+	if (m_testIterationCount > 1)
+		*m_pOs << " (" << std::fixed << std::setprecision(1) << m_testIterationCount / m_timer.Get() << "/s)";
+	*m_pOs << ", Tests run: " << m_testsRunCount
+		<< ", Failed tests: " << m_failedTests.size()
+		<< ", Ignored tests: " << m_ignoredTestCount << "\n";
+	*m_pOs << "Assertions passed: " << m_assertionsPassed
+		<< ", Assertions failed: " << m_assertionsFailed << "\n";
+
+	for (auto it = m_failedTests.begin(); it != m_failedTests.end(); ++it)
+		*m_pOs << "Failed: " << *it << "\n";
+
+	*m_pOs << (Passed() ? "Passed" : "Failed") << std::endl;
+}
+
+std::string ConsoleObserver::GetName(unsigned id) const
+{
+	if (auto p = m_pRunner ? m_pRunner->GetTestUnitPtr(id) : nullptr)
+		return p->fullName;
+	return stringbuilder() << "test unit " << id;
+}
+
+void ConsoleObserver::test_message(Severity::type /*severity*/, const LogText& msg)
+{
+	*m_pOs << msg.View() << "\n";
+}
+
+void ConsoleObserver::test_output(OutputStream::type /*stream*/, unsigned /*sequence*/, Severity::type /*severity*/, const LogText& msg)
+{
+	*m_pOs << msg.View() << "\n";
+}
+
+void ConsoleObserver::test_waiting(const std::wstring& processName, unsigned processId)
+{
+	std::cerr << "Attach debugger to " << Str(processName) << ", pid: " << processId << " and press Enter to continue" << std::endl;
+	std::string line;
+	std::getline(std::cin, line);
+	m_pRunner->Continue();
+}
+
+void ConsoleObserver::test_start()
+{
+}
+
+void ConsoleObserver::test_finish()
+{
+	m_pOs->flush();
+}
+
+void ConsoleObserver::test_aborted()
+{
+	m_error = true;
+}
+
+void ConsoleObserver::test_iteration_start(unsigned /*test_cases_amount*/)
+{
+	m_testCaseState = TestCaseState::Success;
+}
+
+void ConsoleObserver::test_iteration_finish()
+{
+	++m_testIterationCount;
+}
+
+void ConsoleObserver::test_suite_start(unsigned /*id*/)
+{
+}
+
+void ConsoleObserver::test_case_start(unsigned /*id*/)
+{
+	m_testCaseState = TestCaseState::Success;
+}
+
+void ConsoleObserver::test_case_finish(unsigned id, unsigned long /*elapsed*/)
+{
+	EndTestCase(id, m_testCaseState);
+}
+
+void ConsoleObserver::test_case_finish(unsigned id, unsigned long /*elapsed*/, TestCaseState::type state)
+{
+	EndTestCase(id, state);
+}
+
+void ConsoleObserver::EndTestCase(unsigned id, TestCaseState::type state)
+{
+	if (state == TestCaseState::Ignored)
+		++m_ignoredTestCount;
+	if (state == TestCaseState::Failed)
+		m_failedTests.push_back(GetName(id));
+
+	++m_testsRunCount;
+	m_testCaseState = TestCaseState::Success;
+}
+
+void ConsoleObserver::test_suite_finish(unsigned /*id*/, unsigned long /*elapsed*/)
+{
+}
+
+void ConsoleObserver::test_unit_skipped(unsigned /*id*/)
+{
+}
+
+void ConsoleObserver::test_unit_aborted(unsigned /*id*/)
+{
+	m_error = true;
+}
+
+void ConsoleObserver::test_unit_ignored(const std::string& /*msg*/)
+{
+	m_testCaseState = TestCaseState::Ignored;
+}
+
+void ConsoleObserver::assertion_result(bool passed)
+{
+	if (passed)
+		return;
+
+	m_testCaseState = TestCaseState::Failed;
+	m_error = true;
+}
+
+void ConsoleObserver::test_case_assertions(unsigned /*id*/, unsigned passed, unsigned failed)
+{
+	m_assertionsPassed += passed;
+	m_assertionsFailed += failed;
+}
+
+void ConsoleObserver::exception_caught(const std::string& what)
+{
+	*m_pOs << what << "\n";
+	m_testCaseState = TestCaseState::Failed;
+	m_error = true;
+}
+
+void ConsoleObserver::TestStarted()
+{
+	m_timer.Reset();
+}
+
+void ConsoleObserver::TestFinished()
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_finished = true;
+	m_finishedCondition.notify_all();
+}
+
+// The output is written right away.
+unsigned ConsoleObserver::QueuedEvents()
+{
+	return 0;
+}
+
+} // namespace gj
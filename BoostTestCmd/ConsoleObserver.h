@@ -0,0 +1,86 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#ifndef BOOST_TESTUI_CONSOLEOBSERVER_H
+#define BOOST_TESTUI_CONSOLEOBSERVER_H
+
+#pragma once
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+#pragma warning(push, 3) // conversion from 'int' to 'unsigned short', possible loss of data
+#include <boost/thread.hpp>
+#pragma warning(pop)
+#include "TestRunner.h"
+
+namespace gj {
+
+class ConsoleObserver : public TestObserver
+{
+public:
+	explicit ConsoleObserver(std::ostream& os);
+
+	void SetRunner(TestRunner& runner);
+
+	unsigned TestsRunCount() const;
+	unsigned FailedTestCount() const;
+	unsigned IgnoredTestCount() const;
+	unsigned TestIterationCount() const;
+	bool Passed() const;
+	bool WaitForFinish(unsigned milliseconds);
+	void WriteSummary();
+
+	virtual void test_message(Severity::type severity, const LogText& msg) override;
+	virtual void test_output(OutputStream::type stream, unsigned sequence, Severity::type severity, const LogText& msg) override;
+
+	virtual void test_waiting(const std::wstring& processName, unsigned processId) override;
+	virtual void test_start() override;
+	virtual void test_finish() override;
+	virtual void test_aborted() override;
+	virtual void test_iteration_start(unsigned test_cases_amount) override;
+	virtual void test_iteration_finish() override;
+	virtual void test_suite_start(unsigned id) override;
+	virtual void test_case_start(unsigned id) override;
+	virtual void test_case_finish(unsigned id, unsigned long elapsed) override;
+	virtual void test_case_finish(unsigned id, unsigned long elapsed, TestCaseState::type state) override;
+	virtual void test_suite_finish(unsigned id, unsigned long elapsed) override;
+	virtual void test_unit_skipped(unsigned id) override;
+	virtual void test_unit_aborted(unsigned id) override;
+
+	virtual void test_unit_ignored(const std::string& msg) override;
+	virtual void assertion_result(bool passed) override;
+	virtual void test_case_assertions(unsigned id, unsigned passed, unsigned failed) override;
+	virtual void exception_caught(const std::string& what) override;
+
+	virtual void TestStarted() override;
+	virtual void TestFinished() override;
+	virtual unsigned QueuedEvents() override;
+
+private:
+	std::string GetName(unsigned id) const;
+	void EndTestCase(unsigned id, TestCaseState::type state);
+
+	std::ostream* m_pOs;
+	TestRunner* m_pRunner;
+	TestCaseState::type m_testCaseState;
+	unsigned m_testsRunCount;
+	unsigned m_ignoredTestCount;
+	unsigned m_testIterationCount;
+	unsigned m_assertionsPassed;
+	unsigned m_assertionsFailed;
+	bool m_error;
+	std::vector<std::string> m_failedTests;
+	boost::mutex m_mutex;
+	boost::condition_variable m_finishedCondition;
+	bool m_finished;
+	Timer m_timer;
+};
+
+} // namespace gj
+
+#endif // BOOST_TESTUI_CONSOLEOBSERVER_H
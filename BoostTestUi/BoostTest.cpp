@@ -134,6 +134,14 @@ ArgumentBuilder::ArgumentBuilder(const std::wstring& fileName, ExeRunner& runner
 {
 }
 
+std::unique_ptr<gj::ArgumentBuilder> ArgumentBuilder::Clone(ExeRunner& runner, TestObserver& observer) const
+{
+	auto p = new ArgumentBuilder(*this);
+	p->m_pRunner = &runner;
+	p->m_pObserver = &observer;
+	return std::unique_ptr<gj::ArgumentBuilder>(p);
+}
+
 std::wstring ArgumentBuilder::GetExePathName()
 {
 	return m_fileName;
@@ -326,6 +334,13 @@ void ArgumentBuilder::HandleClientNotification(const std::string& line)
 		m_pRunner->OnTestUnitAborted(GetArg<unsigned>(ss));
 	else if (command == "assertion")
 		m_pRunner->OnTestAssertion(GetArg<bool>(ss));
+	else if (command == "unit_assertions")
+	{
+		unsigned id = GetArg<unsigned>(ss);
+		unsigned passed = GetArg<unsigned>(ss);
+		if (m_pRunner->GetTestUnitPtr(id))
+			m_pRunner->OnTestAssertions(passed);
+	}
 	else if (command == "exception")
 		m_pRunner->OnTestExceptionCaught(GetArg<std::string>(ss));
 	else if (command == "waiting")
@@ -334,20 +349,20 @@ void ArgumentBuilder::HandleClientNotification(const std::string& line)
 		m_pObserver->test_message(Severity::Info, line);
 }
 
-void ArgumentBuilder::FilterMessage(const std::string& msg)
+void ArgumentBuilder::FilterMessage(std::string_view msg)
 {
-	if (msg[0] == '#')
-		return HandleClientNotification(msg);
+	if (!msg.empty() && msg[0] == '#')
+		return HandleClientNotification(std::string(msg));
 
 	Severity::type severity = Severity::Info;
 
 	static const std::regex reError("\\): (fatal )?error ");
-	std::smatch sm;
-	if (std::regex_search(msg, sm, reError))
+	std::cmatch sm;
+	if (std::regex_search(msg.data(), msg.data() + msg.size(), sm, reError))
 		severity = sm[1].matched? Severity::Fatal: Severity::Error;
 
 	static const std::regex reAssertion("Assertion failed:");
-	if (std::regex_search(msg, reAssertion))
+	if (std::regex_search(msg.data(), msg.data() + msg.size(), reAssertion))
 		severity =  Severity::Assertion;
 
 	m_pObserver->test_message(severity, msg);
@@ -108,6 +108,14 @@ ArgumentBuilder::ArgumentBuilder(const std::wstring& fileName, ExeRunner& runner
 {
 }
 
+std::unique_ptr<gj::ArgumentBuilder> ArgumentBuilder::Clone(ExeRunner& runner, TestObserver& observer) const
+{
+	auto p = new ArgumentBuilder(*this);
+	p->m_pRunner = &runner;
+	p->m_pObserver = &observer;
+	return std::unique_ptr<gj::ArgumentBuilder>(p);
+}
+
 std::wstring ArgumentBuilder::GetExePathName()
 {
 	return m_fileName;
@@ -185,13 +193,19 @@ void ArgumentBuilder::LoadTestUnits(TestUnitNode& tree, std::istream& is, const
 
 unsigned ArgumentBuilder::GetEnabledOptions(unsigned /*options*/) const
 {
+#ifdef _WIN32
 	return ExeRunner::Randomize | ExeRunner::WaitForDebugger;
+#else // !_WIN32
+	return ExeRunner::Randomize | ExeRunner::WaitForDebugger | ExeRunner::Isolate;
+#endif // _WIN32
 }
 
 std::wstring ArgumentBuilder::BuildArgs(TestRunner& runner, int logLevel, unsigned& options)
 {
 	std::wostringstream args;
 	args << L"--log_level=" << GetLogLevelArg(logLevel);
+	// Terminal colors would put escape codes in front of the #-notifications
+	args << L" --color_output=no";
 
 	if (options & ExeRunner::Randomize)
 		args << L" --random=1";
@@ -206,9 +220,29 @@ std::wstring ArgumentBuilder::BuildArgs(TestRunner& runner, int logLevel, unsign
 	if (!getArg.AllCases())
 		args << L" " << getArg.GetArg();
 	args << L" -- --gui_run";
+	if (options & ExeRunner::Isolate)
+		args << L" --gui_isolate";
 	return args.str();
 }
 
+bool ArgumentBuilder::BuildWorkerArgs(int logLevel, unsigned options, std::wstring& args)
+{
+	args = std::wstring(L"--log_level=") + GetLogLevelArg(logLevel) + L" --color_output=no";
+	if (options & ExeRunner::Randomize)
+		args += L" --random=1";
+	args += L" -- --gui_run";
+	if (options & ExeRunner::Isolate)
+		args += L" --gui_isolate";
+	args += L" --gui_worker";
+	return true;
+}
+
+bool ArgumentBuilder::GetRepeatArg(unsigned iterations, std::wstring& arg) const
+{
+	arg = L"--gui_repeat=" + std::to_wstring(iterations);
+	return true;
+}
+
 void ArgumentBuilder::HandleClientNotification(const std::string& line)
 {
 	std::istringstream ss(line);
@@ -222,6 +256,8 @@ void ArgumentBuilder::HandleClientNotification(const std::string& line)
 		m_pRunner->OnTestIterationFinish();
 	else if (command == "aborted")
 		m_pObserver->test_aborted();
+	else if (command == "waiting")
+		m_pRunner->OnWaiting();
 	else if (command == "unit_start")
 	{
 		if (auto p = m_pRunner->GetTestUnitPtr(GetArg<unsigned>(ss)))
@@ -250,32 +286,46 @@ void ArgumentBuilder::HandleClientNotification(const std::string& line)
 		m_pRunner->OnTestUnitAborted(GetArg<unsigned>(ss));
 	else if (command == "assertion")
 		m_pRunner->OnTestAssertion(GetArg<bool>(ss));
+	else if (command == "unit_assertions")
+	{
+		unsigned id = GetArg<unsigned>(ss);
+		unsigned passed = GetArg<unsigned>(ss);
+		if (m_pRunner->GetTestUnitPtr(id))
+			m_pRunner->OnTestAssertions(passed);
+	}
 	else if (command == "exception")
 		m_pRunner->OnTestExceptionCaught(GetArg<std::string>(ss));
 	else
 		m_pObserver->test_message(Severity::Info, line);
 }
 
-void ArgumentBuilder::FilterMessage(const std::string& msg)
+void ArgumentBuilder::FilterMessage(std::string_view msg)
 {
 	if (msg == "Press any key to continue...")
 		return m_pRunner->OnWaiting();
 
-	if (msg[0] == '#')
-		return HandleClientNotification(msg);
-
-	Severity::type severity = Severity::Info;
+	if (!msg.empty() && msg[0] == '#')
+		return HandleClientNotification(std::string(msg));
 
-	static const std::regex reError("\\): (fatal )?error ");
-	std::smatch sm;
-	if (std::regex_search(msg, sm, reError))
-		severity = sm[1].matched? Severity::Fatal: Severity::Error;
+	m_pObserver->test_message(GetSeverity(msg), msg);
+}
 
-	static const std::regex reAssertion("Assertion failed:");
-	if (std::regex_search(msg, reAssertion))
-		severity =  Severity::Assertion;
+bool ArgumentBuilder::HasEventChannel() const
+{
+	return true;
+}
 
-	m_pObserver->test_message(severity, msg);
+Severity::type ArgumentBuilder::GetSeverity(std::string_view msg) const
+{
+	// Every line of test output passes here, plain searches are much cheaper than std::regex.
+	if (msg.find("Assertion failed:") != std::string_view::npos)
+		return Severity::Assertion;
+	if (msg.find("): error ") != std::string_view::npos)
+		return Severity::Error;
+	if (msg.find("): fatal error ") != std::string_view::npos)
+		return Severity::Fatal;
+
+	return Severity::Info;
 }
 
 } // namespace BoostTest2
@@ -97,6 +97,14 @@ ArgumentBuilder::ArgumentBuilder(const std::wstring& fileName, ExeRunner& runner
 {
 }
 
+std::unique_ptr<gj::ArgumentBuilder> ArgumentBuilder::Clone(ExeRunner& runner, TestObserver& observer) const
+{
+	auto p = new ArgumentBuilder(*this);
+	p->m_pRunner = &runner;
+	p->m_pObserver = &observer;
+	return std::unique_ptr<gj::ArgumentBuilder>(p);
+}
+
 std::wstring ArgumentBuilder::GetExePathName()
 {
 	return m_fileName;
@@ -155,9 +163,22 @@ void ArgumentBuilder::LoadTestUnits(TestUnitNode& tree, std::istream& is, const
 	}
 }
 
+void ArgumentBuilder::LoadCachedTestUnits(const TestUnitNode& tree)
+{
+	const TestUnitNode& node = tree.children.front();
+	m_rootId = node.data.id;
+	m_ids[node.data.name] = node.data.id;
+	for (auto it = node.children.begin(); it != node.children.end(); ++it)
+		m_ids[it->data.name] = it->data.id;
+}
+
 unsigned ArgumentBuilder::GetEnabledOptions(unsigned /*options*/) const
 {
+#ifdef _WIN32
 	return ExeRunner::Randomize | ExeRunner::WaitForDebugger;
+#else // !_WIN32
+	return ExeRunner::Randomize | ExeRunner::WaitForDebugger | ExeRunner::Isolate;
+#endif // _WIN32
 }
 
 std::wstring ArgumentBuilder::BuildArgs(TestRunner& runner, int logLevel, unsigned& options)
@@ -175,6 +196,9 @@ std::wstring ArgumentBuilder::BuildArgs(TestRunner& runner, int logLevel, unsign
 	if (options & ExeRunner::WaitForDebugger)
 		args << L" --gui_wait";
 
+	if (options & ExeRunner::Isolate)
+		args << L" --gui_isolate";
+
 	GetEnableArg getArg;
 	runner.TraverseTestTree(getArg);
 	if (!getArg.AllCases())
@@ -183,6 +207,33 @@ std::wstring ArgumentBuilder::BuildArgs(TestRunner& runner, int logLevel, unsign
 	return args.str();
 }
 
+bool ArgumentBuilder::BuildWorkerArgs(int logLevel, unsigned options, std::wstring& args)
+{
+	args = L"-r boosttestui";
+	if (logLevel > 1)
+		args += L" --success";
+	if (options & ExeRunner::Randomize)
+		args += L" --order rand";
+	if (options & ExeRunner::Isolate)
+		args += L" --gui_isolate";
+	args += L" --gui_worker";
+	return true;
+}
+
+bool ArgumentBuilder::GetRepeatArg(unsigned iterations, std::wstring& arg) const
+{
+	arg = L"--gui_repeat=" + std::to_wstring(iterations);
+	return true;
+}
+
+std::string ArgumentBuilder::GetWorkerBatch(const std::vector<unsigned>& ids)
+{
+	std::string batch;
+	for (auto it = ids.begin(); it != ids.end(); ++it)
+		batch += m_pRunner->GetTestUnit(*it).name + '\n';
+	return batch + '\n';
+}
+
 template <typename T>
 T get_arg(const std::string& s)
 {
@@ -242,10 +293,14 @@ void ArgumentBuilder::HandleClientNotification(const std::string& line)
 		m_pRunner->OnTestUnitSkipped(GetId(GetArg(ss)));
 	else if (command == "TestStarted")
 		m_pRunner->OnTestCaseStart(GetId(GetArg(ss)));
+	else if (command == "TestAborted")
+		m_pRunner->OnTestUnitAborted(GetId(GetArg(ss)));
 	else if (command == "SuiteStarted")
 		m_pRunner->OnTestSuiteStart(GetId(GetArg(ss)));
 	else if (command == "Assertion")
 		m_pRunner->OnTestAssertion(GetArg<bool>(ss));
+	else if (command == "TestAssertions")
+		m_pRunner->OnTestAssertions(GetArg<unsigned>(ss));
 	else if (command == "TestFinished")
 	{
 		auto state = GetArg<bool>(ss) ? TestCaseState::Success : TestCaseState::Failed;
@@ -266,10 +321,10 @@ void ArgumentBuilder::HandleClientNotification(const std::string& line)
 	}
 }
 
-void ArgumentBuilder::FilterMessage(const std::string& msg)
+void ArgumentBuilder::FilterMessage(std::string_view msg)
 {
-	if (msg[0] == '#')
-		return HandleClientNotification(msg);
+	if (!msg.empty() && msg[0] == '#')
+		return HandleClientNotification(std::string(msg));
 
 //	static const std::regex reError(": Error$");
 //	std::smatch sm;
@@ -283,5 +338,16 @@ void ArgumentBuilder::FilterMessage(const std::string& msg)
 	m_pObserver->test_message(Severity::Info, msg);
 }
 
+bool ArgumentBuilder::HasEventChannel() const
+{
+	return true;
+}
+
+// The events name the test units, the root suite has no name.
+unsigned ArgumentBuilder::GetEventUnitId(const ClientEvent& event)
+{
+	return event.text.empty() ? m_rootId : GetId(event.text);
+}
+
 } // namespace CatchTest
 } // namespace gj
@@ -22,13 +22,20 @@ class ArgumentBuilder : public gj::ArgumentBuilder
 public:
 	explicit ArgumentBuilder(const std::wstring& fileName, ExeRunner& runner, TestObserver& observer);
 
+	virtual std::unique_ptr<gj::ArgumentBuilder> Clone(ExeRunner& runner, TestObserver& observer) const override;
 	virtual std::wstring GetExePathName() override;
 	virtual std::wstring GetListArg() override;
 	virtual void LoadTestUnits(TestUnitNode& tree, std::istream& is, const std::string& testName) override;
+	virtual void LoadCachedTestUnits(const TestUnitNode& tree) override;
 
 	unsigned GetEnabledOptions(unsigned options) const override;
 	virtual std::wstring BuildArgs(TestRunner& runner, int logLevel, unsigned& options) override;
-	virtual void FilterMessage(const std::string& msg) override;
+	virtual void FilterMessage(std::string_view msg) override;
+	virtual bool BuildWorkerArgs(int logLevel, unsigned options, std::wstring& args) override;
+	virtual bool GetRepeatArg(unsigned iterations, std::wstring& arg) const override;
+	virtual std::string GetWorkerBatch(const std::vector<unsigned>& ids) override;
+	virtual bool HasEventChannel() const override;
+	virtual unsigned GetEventUnitId(const ClientEvent& event) override;
 
 private:
 	unsigned GetId(const std::string& name);
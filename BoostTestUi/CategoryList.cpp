@@ -41,6 +41,11 @@ bool CategoryList::IsSelected(const std::string& category) const
 	return it != m_categories.end() && it->second;
 }
 
+bool CategoryList::Contains(const std::string& category) const
+{
+	return m_categories.find(category) != m_categories.end();
+}
+
 bool CategoryList::IsEmpty() const
 {
 	return m_categories.size() == 1;
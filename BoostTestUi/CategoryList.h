@@ -30,6 +30,7 @@ public:
 	void SetSelection(const std::string& category, bool select = true);
 	bool IsDefaultSelected() const;
 	bool IsSelected(const std::string& category) const;
+	bool Contains(const std::string& category) const;
 	bool IsEmpty() const;
 	iterator begin() const;
 	iterator end() const;
@@ -0,0 +1,389 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#include "stdafx.h"
+#include <algorithm>
+#include <exception>
+#include <boost/filesystem.hpp>
+#include "Utilities.h"
+#include "hstream.h"
+#include "ChildRunner.h"
+
+namespace gj {
+
+// Keep the enabled test cases with index [begin, end) in tree order enabled,
+// disable the others and the test suites that are left without test cases.
+bool SelectTestCases(TestUnitNode& node, unsigned& index, unsigned begin, unsigned end)
+{
+	if (node.data.type == TestUnit::TestCase)
+	{
+		if (node.data.enabled)
+		{
+			node.data.enabled = index >= begin && index < end;
+			++index;
+		}
+		return node.data.enabled;
+	}
+
+	bool enabled = false;
+	for (auto it = node.children.begin(); it != node.children.end(); ++it)
+	{
+		if (SelectTestCases(*it, index, begin, end))
+			enabled = true;
+	}
+	node.data.enabled = enabled;
+	return enabled;
+}
+
+ShardRunner::ShardRunner(ExeRunner& parent, unsigned shard, unsigned shardCount, TestObserver& observer) :
+	ExeRunner(parent, observer)
+{
+	if (m_pArgBuilder->GetShardEnvironment(shard, shardCount, m_environment))
+		return;
+
+	unsigned count = CountEnabledTestCases(m_tree);
+	unsigned index = 0;
+	SelectTestCases(m_tree, index, shard * count / shardCount, (shard + 1) * count / shardCount);
+}
+
+WorkerRunner::WorkerRunner(ExeRunner& parent, TestScheduler& scheduler, TestObserver& observer) :
+	ExeRunner(parent, observer),
+	m_scheduler(scheduler)
+{
+}
+
+// The thread of the worker calls the overrides of this class.
+WorkerRunner::~WorkerRunner()
+{
+	Abort();
+	Wait();
+}
+
+void WorkerRunner::StartWorker(const std::wstring& arguments)
+{
+	m_testArgs = arguments;
+	StartTestProcess();
+#ifndef _WIN32
+	if (m_pLoop)
+	{
+		m_pObserver->TestStarted();
+		return StartReading();
+	}
+#endif
+	m_pThread.reset(new boost::thread([this]() { RunWorker(); }));
+}
+
+void WorkerRunner::StartForkedWorker(const Process& zygote, unsigned worker, unsigned workers, const std::wstring& arguments)
+{
+	m_testArgs = arguments;
+	m_hChannelIn = zygote.GetChannelIn(worker);
+	{
+		boost::mutex::scoped_lock lock(m_processMutex);
+		m_hChannelOut = zygote.GetChannelOut(worker);
+		m_hZygote = zygote.GetProcessHandle();
+	}
+	if (m_pArgBuilder->HasEventChannel())
+	{
+		m_hEvents = zygote.GetChannelOut(workers + worker);
+		m_eventsOpen = false;
+		m_eventDecoder = EventDecoder();
+	}
+	m_pOutputReader.reset(new LineReader(m_hChannelOut));
+	m_pErrorReader.reset();
+	m_channelName = stringbuilder() << "Process " << zygote.GetProcessId() << ": " << Str(zygote.GetName()) << ", worker " << worker;
+	m_pObserver->test_start();
+	m_pObserver->test_message(Severity::Info, m_channelName + ", started");
+	m_testFinished = false;
+#ifndef _WIN32
+	if (m_pLoop)
+	{
+		m_pObserver->TestStarted();
+		return StartReading();
+	}
+#endif
+	m_pThread.reset(new boost::thread([this]() { RunWorker(); }));
+}
+
+void WorkerRunner::OnWaiting()
+{
+	SendBatch();
+}
+
+void WorkerRunner::OnTestCaseStart(unsigned id)
+{
+	m_batch.erase(std::remove(m_batch.begin(), m_batch.end(), id), m_batch.end());
+	m_batchStarted = true;
+	ExeRunner::OnTestCaseStart(id);
+}
+
+#ifndef _WIN32
+
+void WorkerRunner::AbortTestProcess()
+{
+	m_batchStarted = false;
+	ExeRunner::AbortTestProcess();
+}
+
+// Does what RunWorker() does when the test process ends.
+void WorkerRunner::OnTestProcessExit()
+{
+	try
+	{
+		WaitForTestProcess();
+		m_scheduler.Requeue(m_batch);
+		m_batch.clear();
+		if (!m_testFinished)
+			EndCrashedTestCase();
+
+		if (m_batchStarted && !m_scheduler.Empty())
+		{
+			m_batchStarted = false;
+			StartTestProcess();
+			return StartReading();
+		}
+	}
+	catch (std::exception& e)
+	{
+		m_pObserver->exception_caught(e.what());
+	}
+	m_pObserver->TestFinished();
+}
+
+#endif
+
+// The zygote collects the exit status of a forked worker.
+void WorkerRunner::WaitForTestProcess()
+{
+	if (m_hChannelOut == NoFileHandle)
+		return ExeRunner::WaitForTestProcess();
+
+	ReportTimeout();
+	m_pObserver->test_message(Severity::Info, m_channelName + ", finished");
+	m_pObserver->test_finish();
+	m_hChannelIn = NoFileHandle;
+	{
+		boost::mutex::scoped_lock lock(m_processMutex);
+		m_hChannelOut = NoFileHandle;
+		m_hZygote = NoProcessHandle;
+	}
+	m_hEvents = NoFileHandle;
+}
+
+FileHandle WorkerRunner::GetTestOutput() const
+{
+	return m_hChannelOut != NoFileHandle ? m_hChannelOut : ExeRunner::GetTestOutput();
+}
+
+bool WorkerRunner::HasTestProcess()
+{
+	{
+		boost::mutex::scoped_lock lock(m_processMutex);
+		if (m_hChannelOut != NoFileHandle)
+			return true;
+	}
+	return ExeRunner::HasTestProcess();
+}
+
+// A forked worker takes the zygote and its other workers along.
+void WorkerRunner::KillTestProcess()
+{
+#ifndef _WIN32
+	{
+		boost::mutex::scoped_lock lock(m_processMutex);
+		if (m_hChannelOut != NoFileHandle)
+			return KillProcessGroup(m_hZygote);
+	}
+#endif
+	ExeRunner::KillTestProcess();
+}
+
+void WorkerRunner::SetTestCaseDuration(unsigned id, unsigned elapsed)
+{
+	m_scheduler.TestCaseFinished(id, elapsed);
+}
+
+// A worker that ended in the middle of a batch is restarted as long as there is work left,
+// unless it did not get to start a test case: then its startup is broken and the other
+// workers take over its batch.
+void WorkerRunner::RunWorker()
+try
+{
+	m_pObserver->TestStarted();
+	auto guard = make_guard([this]() { m_pObserver->TestFinished(); });
+
+	for (;;)
+	{
+		RunTestIteration();
+		WaitForTestProcess();
+		m_scheduler.Requeue(m_batch);
+		m_batch.clear();
+		if (!m_testFinished)
+			EndCrashedTestCase();
+
+		if (!m_batchStarted || m_scheduler.Empty())
+			break;
+
+		m_batchStarted = false;
+		StartTestProcess();
+	}
+}
+catch (std::exception& e)
+{
+	m_pObserver->exception_caught(e.what());
+}
+
+void WorkerRunner::SendBatch()
+{
+	m_batch = m_scheduler.NextBatch();
+	m_batchStarted = false;
+	m_testFinished = m_batch.empty();
+
+	hstream hs(GetTestInput());
+	hs << m_pArgBuilder->GetWorkerBatch(m_batch) << std::flush;
+}
+
+FileHandle WorkerRunner::GetTestInput() const
+{
+	return m_hChannelIn != NoFileHandle ? m_hChannelIn : m_pProcess->GetStdIn();
+}
+
+ResidentRunner::ResidentRunner(ExeRunner& parent, TestObserver& observer, const std::wstring& arguments, TestDurations& durations) :
+	ExeRunner(parent, observer),
+	m_parentDurations(durations)
+{
+	m_testArgs = arguments;
+	StartResidentProcess();
+}
+
+// An empty batch ends an idle worker, the others are aborted.
+ResidentRunner::~ResidentRunner()
+{
+	if (!m_pProcess)
+		return;
+
+	if (m_idle)
+	{
+		hstream hs(m_pProcess->GetStdIn());
+		hs << m_pArgBuilder->GetWorkerBatch(std::vector<unsigned>()) << std::flush;
+	}
+	else
+	{
+		KillTestProcess();
+	}
+	WaitForTestProcess();
+}
+
+bool ResidentRunner::CanRun(const std::wstring& arguments) const
+{
+	return m_pProcess && arguments == m_testArgs && boost::filesystem::last_write_time(m_pArgBuilder->GetExePathName()) == m_writeTime;
+}
+
+void ResidentRunner::StartResidentProcess()
+{
+	m_writeTime = boost::filesystem::last_write_time(m_pArgBuilder->GetExePathName());
+	StartTestProcess();
+	m_idle = false;
+}
+
+void ResidentRunner::OnWaiting()
+{
+	m_idle = true;
+}
+
+bool ResidentRunner::IsIdle() const
+{
+	return m_idle;
+}
+
+void ResidentRunner::SetTestCaseDuration(unsigned id, unsigned elapsed)
+{
+	m_parentDurations[id] = elapsed;
+}
+
+// Reads the output of the resident test process until it waits for the next batch.
+bool ResidentRunner::ReadResidentProcess()
+{
+#ifndef _WIN32
+	if (m_hEvents != NoFileHandle)
+	{
+		ReadTestEvents();
+		return m_idle;
+	}
+#endif
+
+	std::string_view line;
+	while (!m_idle && m_pOutputReader->GetLine(line))
+	{
+		m_pArgBuilder->FilterMessage(line);
+	}
+	return m_idle;
+}
+
+// A resident process that crashes is restarted and gets the test cases of the batch that
+// did not run yet, the observer sees the partial runs as one iteration. When it crashed
+// before it started a test case, the iteration is closed and the run ends.
+void ResidentRunner::RunTestCases(const std::vector<unsigned>& testCases)
+try
+{
+	m_pObserver->TestStarted();
+	auto guard = make_guard([this]() { m_pObserver->TestFinished(); });
+
+	std::vector<unsigned> batch(testCases);
+	for (;;)
+	{
+		m_testFinished = false;
+		if (ReadResidentProcess())
+		{
+			m_idle = false;
+			hstream hs(m_pProcess->GetStdIn());
+			hs << m_pArgBuilder->GetWorkerBatch(batch) << std::flush;
+			ReadResidentProcess();
+		}
+
+		if (!m_idle)
+		{
+			WaitForTestProcess();
+			if (m_testFinished || m_aborted)
+				break;
+
+			EndCrashedTestCase();
+			bool started = m_startedTestCases.size() != m_processStartedTestCases;
+			if (!started && batch.size() == testCases.size())
+				break;
+
+			if (!started)
+			{
+				OnTestIterationFinish();
+				break;
+			}
+
+			std::vector<unsigned> startedTestCases(m_startedTestCases);
+			std::sort(startedTestCases.begin(), startedTestCases.end());
+			batch.erase(std::remove_if(batch.begin(), batch.end(), [&](unsigned id) { return std::binary_search(startedTestCases.begin(), startedTestCases.end(), id); }), batch.end());
+			StartResidentProcess();
+			if (!batch.empty())
+			{
+				m_pObserver->test_message(Severity::Info, (stringbuilder() << "Continuing with the " << batch.size() << " test cases that did not run").str());
+				m_continuing = true;
+				continue;
+			}
+			OnTestIterationFinish();
+		}
+
+		batch = testCases;
+		if (!m_repeat)
+			break;
+
+		WaitForObserver();
+	}
+}
+catch (std::exception& e)
+{
+	m_pObserver->exception_caught(e.what());
+}
+
+} // namespace gj
@@ -0,0 +1,100 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#ifndef BOOST_TESTUI_CHILDRUNNER_H
+#define BOOST_TESTUI_CHILDRUNNER_H
+
+#pragma once
+
+#include <ctime>
+#include <string>
+#include <vector>
+#include "ExeRunner.h"
+
+namespace gj {
+
+// The runners that an ExeRunner starts for a part of its test run. They run on a copy of
+// its test tree and report to the observer that it gives them.
+
+// Runs a part of the enabled test cases of parent in a test process of its own.
+class ShardRunner : public ExeRunner
+{
+public:
+	ShardRunner(ExeRunner& parent, unsigned shard, unsigned shardCount, TestObserver& observer);
+};
+
+// Runs the batches of test cases that scheduler hands out in a resident worker process.
+// A worker that the zygote forked reads its output and events from the channels of the
+// zygote, it is restarted as a process of its own when it crashes.
+class WorkerRunner : public ExeRunner
+{
+public:
+	WorkerRunner(ExeRunner& parent, TestScheduler& scheduler, TestObserver& observer);
+	~WorkerRunner();
+
+	void StartWorker(const std::wstring& arguments);
+	void StartForkedWorker(const Process& zygote, unsigned worker, unsigned workers, const std::wstring& arguments);
+
+	virtual void OnWaiting() override;
+	virtual void OnTestCaseStart(unsigned id) override;
+
+protected:
+#ifndef _WIN32
+	virtual void AbortTestProcess() override;
+	virtual void OnTestProcessExit() override;
+#endif
+	virtual void WaitForTestProcess() override;
+	virtual FileHandle GetTestOutput() const override;
+	virtual bool HasTestProcess() override;
+	virtual void KillTestProcess() override;
+	virtual void SetTestCaseDuration(unsigned id, unsigned elapsed) override;
+
+private:
+	void RunWorker();
+	void SendBatch();
+	FileHandle GetTestInput() const;
+
+	TestScheduler& m_scheduler;
+	std::vector<unsigned> m_batch;
+	bool m_batchStarted = false;
+	FileHandle m_hChannelIn = NoFileHandle;
+	// Guarded by m_processMutex, the watchdog thread reads them.
+	FileHandle m_hChannelOut = NoFileHandle;
+	ProcessHandle m_hZygote = NoProcessHandle;
+	std::string m_channelName;
+};
+
+// The resident test process is a worker that runs all enabled test cases as one batch.
+// It is reused as long as the executable and the arguments don't change. The test case
+// durations go to those of the parent.
+class ResidentRunner : public ExeRunner
+{
+public:
+	ResidentRunner(ExeRunner& parent, TestObserver& observer, const std::wstring& arguments, TestDurations& durations);
+	~ResidentRunner();
+
+	bool CanRun(const std::wstring& arguments) const;
+	void RunTestCases(const std::vector<unsigned>& testCases);
+
+	virtual void OnWaiting() override;
+
+protected:
+	virtual bool IsIdle() const override;
+	virtual void SetTestCaseDuration(unsigned id, unsigned elapsed) override;
+
+private:
+	void StartResidentProcess();
+	bool ReadResidentProcess();
+
+	TestDurations& m_parentDurations;
+	bool m_idle = false;
+	std::time_t m_writeTime = 0;
+};
+
+} // namespace gj
+
+#endif // BOOST_TESTUI_CHILDRUNNER_H
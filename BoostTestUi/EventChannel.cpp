@@ -0,0 +1,65 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#include "stdafx.h"
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include "EventChannel.h"
+
+namespace gj {
+
+ClientEvent::ClientEvent() :
+	type(Hello),
+	id(0),
+	value(0)
+{
+}
+
+void EventDecoder::Append(const char* data, std::size_t size)
+{
+	m_buffer.append(data, size);
+}
+
+bool EventDecoder::Empty() const
+{
+	return m_buffer.empty();
+}
+
+std::uint32_t GetUint32(const char* p)
+{
+	std::uint32_t value;
+	std::memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+bool EventDecoder::Next(ClientEvent& event)
+{
+	const std::size_t headerSize = 4 + 1 + 4 + 4 + 4;
+	if (m_buffer.size() < headerSize)
+		return false;
+
+	std::size_t size = GetUint32(m_buffer.data());
+	if (size < headerSize - 4)
+		throw std::runtime_error("Invalid event record");
+	if (m_buffer.size() < 4 + size)
+		return false;
+
+	const char* p = m_buffer.data() + 4;
+	std::size_t length = GetUint32(p + 9);
+	if (length != size - (headerSize - 4))
+		throw std::runtime_error("Invalid event record");
+
+	event.type = static_cast<ClientEvent::Type>(static_cast<unsigned char>(p[0]));
+	event.id = GetUint32(p + 1);
+	event.value = GetUint32(p + 5);
+	event.text.assign(p + 13, length);
+	m_buffer.erase(0, 4 + size);
+	return true;
+}
+
+} // namespace gj
@@ -0,0 +1,71 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#ifndef BOOST_TESTUI_EVENTCHANNEL_H
+#define BOOST_TESTUI_EVENTCHANNEL_H
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace gj {
+
+// The gui headers write their test events as binary records to the event channel,
+// a pipe apart from the test output, when started with --gui_events=<fd>.
+// A record is, in native byte order:
+//   uint32 size of the rest of the record
+//   uint8  type
+//   uint32 id, the test unit id for frameworks that have ids
+//   uint32 value, a count, an elapsed time or an assertion result
+//   uint32 text length, followed by the text: a test unit name or an exception message
+struct ClientEvent
+{
+	enum Type
+	{
+		Hello = 0,
+		Waiting = 1,
+		IterationStart = 2,
+		IterationFinish = 3,
+		Aborted = 4,
+		UnitStart = 5,
+		UnitFinish = 6,
+		UnitPassed = 7,
+		UnitFailed = 8,
+		UnitSkipped = 9,
+		UnitAborted = 10,
+		Assertion = 11,
+		Exception = 12,
+		UnitAssertions = 13,
+	};
+
+	ClientEvent();
+
+	Type type;
+	unsigned id;
+	unsigned value;
+	std::string text;
+};
+
+// The file descriptor of the event channel in the test process.
+const int EventChannelFd = 4;
+
+// Splits the data read from the event channel into records.
+class EventDecoder
+{
+public:
+	void Append(const char* data, std::size_t size);
+	bool Next(ClientEvent& event);
+	bool Empty() const;
+
+private:
+	std::string m_buffer;
+};
+
+} // namespace gj
+
+#endif // BOOST_TESTUI_EVENTCHANNEL_H
@@ -6,8 +6,17 @@
 // See http://boosttestui.wordpress.com/ for the boosttestui home page.
 
 #include "stdafx.h"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <istream>
 #include <stdexcept>
-#include <boost/filesystem.hpp>
+#ifndef _WIN32
+#include <cerrno>
+#include <poll.h>
+#include "IoLoop.h"
+#endif
 #include "Utilities.h"
 #include "hstream.h"
 #include "GetUnitTestType.h"
@@ -16,7 +25,9 @@
 #include "CatchTest.h"
 #include "GoogleTest.h"
 #include "NUnitTest.h"
+#include "ListingCache.h"
 #include "ExeRunner.h"
+#include "ChildRunner.h"
 
 namespace gj {
 
@@ -51,18 +62,240 @@ private:
 	std::vector<TestSuite*> m_suites;
 };
 
-void ExeRunner::Load()
+// Passes the test units that a parser adds to tree to a visitor in tree order, while it
+// parses. The last test unit in tree order is held back until Finish(), the parser may
+// still change it, like the tags that follow a Catch test case.
+class TestUnitStream
 {
-	Process proc(m_pArgBuilder->GetExePathName(), m_pArgBuilder->GetListArg());
+public:
+	TestUnitStream(TestUnitNode& tree, TestTreeVisitor& visitor) :
+		m_tree(tree),
+		m_visitor(visitor),
+		m_openSuites(0)
+	{
+	}
+
+	void Update()
+	{
+		std::vector<std::size_t> next(m_path);
+		if (!Advance(next))
+			return;
+
+		for (std::vector<std::size_t> after(next); Advance(after); next = after)
+			Visit(next);
+	}
+
+	void Finish()
+	{
+		std::vector<std::size_t> next(m_path);
+		while (Advance(next))
+			Visit(next);
+		for (; m_openSuites > 0; --m_openSuites)
+			m_visitor.LeaveTestSuite();
+	}
+
+private:
+	TestUnitNode& At(const std::vector<std::size_t>& path) const
+	{
+		TestUnitNode* p = &m_tree;
+		for (auto it = path.begin(); it != path.end(); ++it)
+			p = &p->children[*it];
+		return *p;
+	}
+
+	// Moves path to the next test unit in tree order, returns false at the end of the tree.
+	bool Advance(std::vector<std::size_t>& path) const
+	{
+		if (!At(path).children.empty())
+		{
+			path.push_back(0);
+			return true;
+		}
+
+		while (!path.empty())
+		{
+			std::size_t index = path.back();
+			path.pop_back();
+			if (index + 1 < At(path).children.size())
+			{
+				path.push_back(index + 1);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// The test suites above the test unit at path are the ones that are open.
+	void Visit(const std::vector<std::size_t>& path)
+	{
+		for (; m_openSuites + 1 > path.size(); --m_openSuites)
+			m_visitor.LeaveTestSuite();
+
+		TestUnitNode& node = At(path);
+		if (node.data.type == TestUnit::TestCase)
+		{
+			m_visitor.VisitTestCase(static_cast<TestCase&>(node.data));
+		}
+		else
+		{
+			m_visitor.EnterTestSuite(static_cast<TestSuite&>(node.data));
+			m_openSuites = path.size();
+		}
+		m_path = path;
+	}
+
+	TestUnitNode& m_tree;
+	TestTreeVisitor& m_visitor;
+	std::vector<std::size_t> m_path;
+	std::size_t m_openSuites;
+};
+
+// Reads the output of a listing process and calls waiting() before it waits for more.
+class ListingStreamBuf : public std::streambuf
+{
+public:
+	ListingStreamBuf(FileHandle handle, const std::function<void ()>& waiting) :
+		m_handle(handle),
+		m_waiting(waiting)
+	{
+	}
+
+protected:
+	virtual int_type underflow() override
+	{
+		if (gptr() < egptr())
+			return traits_type::to_int_type(*gptr());
+
+		m_waiting();
+		std::size_t size = 0;
+		if (!ReadHandle(m_handle, m_buffer, sizeof(m_buffer), size) || size == 0)
+			return traits_type::eof();
 
-	hstream hs(proc.GetStdOut());
+		setg(m_buffer, m_buffer, m_buffer + size);
+		return traits_type::to_int_type(*gptr());
+	}
+
+private:
+	FileHandle m_handle;
+	std::function<void ()> m_waiting;
+	char m_buffer[4096];
+};
+
+LoadCanceledError::LoadCanceledError() :
+	std::runtime_error("Loading canceled")
+{
+}
+
+LoadCancellation::LoadCancellation() :
+	m_canceled(false)
+{
+}
+
+void LoadCancellation::Cancel()
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_canceled = true;
+	for (auto it = m_listings.begin(); it != m_listings.end(); ++it)
+		KillProcess(*it);
+}
+
+bool LoadCancellation::IsCanceled() const
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	return m_canceled;
+}
+
+void LoadCancellation::Check() const
+{
+	if (IsCanceled())
+		throw LoadCanceledError();
+}
+
+void LoadCancellation::AddListing(ProcessHandle hProcess)
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	if (m_canceled)
+		KillProcess(hProcess);
+	m_listings.push_back(hProcess);
+}
+
+void LoadCancellation::RemoveListing(ProcessHandle hProcess)
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_listings.erase(std::remove(m_listings.begin(), m_listings.end(), hProcess), m_listings.end());
+}
+
+// Reads the test tree of a listing process. The process is registered with the
+// LoadCancellation until its output ends, so it is not killed after it is reaped.
+// The test units that are parsed from the listing so far are passed to pUnits each time
+// the parser waits for more of the listing.
+void ParseListing(ArgumentBuilder& argBuilder, Process& proc, TestUnitNode& tree, TestTreeVisitor* pUnits)
+{
+	if (!pUnits)
+	{
+		hstream hs(proc.GetStdOut());
+		return argBuilder.LoadTestUnits(tree, hs, Str(proc.GetName()).str());
+	}
+
+	TestUnitStream units(tree, *pUnits);
+	ListingStreamBuf buf(proc.GetStdOut(), [&units]() { units.Update(); });
+	std::istream is(&buf);
+	argBuilder.LoadTestUnits(tree, is, Str(proc.GetName()).str());
+	units.Finish();
+}
+
+void LoadListing(ArgumentBuilder& argBuilder, Process& proc, TestUnitNode& tree, LoadCancellation* pCancellation, TestTreeVisitor* pUnits)
+{
+	if (!pCancellation)
+		return ParseListing(argBuilder, proc, tree, pUnits);
+
+	pCancellation->AddListing(proc.GetProcessHandle());
+	std::exception_ptr error;
+	try
+	{
+		ParseListing(argBuilder, proc, tree, pUnits);
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+	pCancellation->RemoveListing(proc.GetProcessHandle());
+
+	// A killed listing ends with a parse error or a partial test tree.
+	if (pCancellation->IsCanceled())
+	{
+		proc.Wait();
+		throw LoadCanceledError();
+	}
+	if (error)
+		std::rethrow_exception(error);
+}
+
+// An unchanged test executable is not started, its test tree comes from the ListingCache
+// and is passed to pUnits as a whole.
+void ExeRunner::Load(LoadCancellation* pCancellation, TestTreeVisitor* pUnits)
+{
+	ListingCache cache(m_fileName, m_pArgBuilder->GetExePathName() + L" " + m_pArgBuilder->GetListArg());
 	m_tree.children.clear();
-	m_pArgBuilder->LoadTestUnits(m_tree, hs, Str(proc.GetName()).str());
-	if (m_tree.children.empty())
-		throw std::runtime_error("No test cases");
+	bool cached = cache.Load(m_tree);
+	if (cached)
+	{
+		m_pArgBuilder->LoadCachedTestUnits(m_tree);
+	}
+	else
+	{
+		Process proc(m_pArgBuilder->GetExePathName(), m_pArgBuilder->GetListArg());
+		LoadListing(*m_pArgBuilder, proc, m_tree, pCancellation, pUnits);
+		proc.Wait();
+		if (m_tree.children.empty())
+			throw std::runtime_error("No test cases");
+		cache.Store(m_tree);
+	}
 
 	PathNameVisitor setFullNames;
 	TraverseTestTree(setFullNames);
+	if (pUnits && cached)
+		TraverseTestTree(*pUnits);
 }
 
 NoHeaderError::NoHeaderError(const char* msg, UnitTestType::type testType) :
@@ -76,9 +309,9 @@ UnitTestType::type NoHeaderError::GetUnitTestType() const
 	return m_testType;
 }
 
-std::unique_ptr<ArgumentBuilder> CreateArgumentBuilder(const std::wstring& fileName, ExeRunner& runner, TestObserver& observer)
+std::unique_ptr<ArgumentBuilder> CreateArgumentBuilder(const std::wstring& fileName, const std::string& testType, ExeRunner& runner, TestObserver& observer)
 {
-	std::string type = GetUnitTestType(WideCharToMultiByte(fileName));
+	std::string type = testType.empty() ? GetUnitTestType(WideCharToMultiByte(fileName)) : testType;
 	if (type == "boost")
 		return std::unique_ptr<ArgumentBuilder>(new BoostTest::ArgumentBuilder(fileName, runner, observer));
 	if (type == "boost2")
@@ -102,20 +335,137 @@ std::unique_ptr<ArgumentBuilder> CreateArgumentBuilder(const std::wstring& fileN
 	throw std::runtime_error("This is not a supported unit test executable");
 }
 
-ExeRunner::ExeRunner(const std::wstring& fileName, TestObserver& observer) :
+unsigned CountEnabledTestCases(const TestUnitNode& node)
+{
+	if (node.data.type == TestUnit::TestCase)
+		return node.data.enabled ? 1 : 0;
+
+	unsigned count = 0;
+	for (auto it = node.children.begin(); it != node.children.end(); ++it)
+		count += CountEnabledTestCases(*it);
+	return count;
+}
+
+void GetEnabledTestCases(const TestUnitNode& node, std::vector<unsigned>& testCases)
+{
+	if (node.data.type == TestUnit::TestCase)
+	{
+		if (node.data.enabled)
+			testCases.push_back(node.data.id);
+		return;
+	}
+
+	for (auto it = node.children.begin(); it != node.children.end(); ++it)
+		GetEnabledTestCases(*it, testCases);
+}
+
+// Disable the test cases in the sorted ids and the test suites that are left without test cases.
+bool DisableTestCases(TestUnitNode& node, const std::vector<unsigned>& ids)
+{
+	if (node.data.type == TestUnit::TestCase)
+	{
+		if (std::binary_search(ids.begin(), ids.end(), node.data.id))
+			node.data.enabled = false;
+		return node.data.enabled;
+	}
+
+	bool enabled = false;
+	for (auto it = node.children.begin(); it != node.children.end(); ++it)
+	{
+		if (DisableTestCases(*it, ids))
+			enabled = true;
+	}
+	node.data.enabled = enabled;
+	return enabled;
+}
+
+struct ExeRunner::Shard
+{
+	explicit Shard(ShardMerger& merger) :
+		observer(merger)
+	{
+	}
+
+	ShardObserver observer;
+	std::unique_ptr<ExeRunner> pRunner;
+};
+
+// Milliseconds on a clock that the watchdog thread compares the #unit_start times against.
+long long GetSteadyTime()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Checks the timeouts of a run on a thread of its own, so it also stops a test process
+// that hangs without writing anything. It stops after a run timeout aborted the run.
+struct ExeRunner::Watchdog
+{
+	explicit Watchdog(ExeRunner& runner) :
+		stop(false)
+	{
+		if (runner.m_testCaseTimeout > 0 || runner.m_runTimeout > 0)
+			thread.reset(new boost::thread([this, &runner]() { Run(runner); }));
+	}
+
+	~Watchdog()
+	{
+		if (!thread)
+			return;
+
+		{
+			boost::mutex::scoped_lock lock(mutex);
+			stop = true;
+		}
+		condition.notify_all();
+		thread->join();
+	}
+
+	void Run(ExeRunner& runner)
+	{
+		Timer timer;
+		boost::posix_time::milliseconds interval(static_cast<long>(WatchdogInterval));
+		for (;;)
+		{
+			{
+				boost::mutex::scoped_lock lock(mutex);
+				if (condition.timed_wait(lock, interval, [this]() { return stop; }))
+					return;
+			}
+			if (!runner.CheckTimeouts(timer.Get()))
+				return;
+		}
+	}
+
+	boost::mutex mutex;
+	boost::condition_variable condition;
+	bool stop;
+	std::unique_ptr<boost::thread> thread;
+};
+
+ExeRunner::ExeRunner(const std::wstring& fileName, TestObserver& observer, const std::string& testType, LoadCancellation* pCancellation, TestTreeVisitor* pUnits) :
 	m_pObserver(&observer),
 	m_tree(TestUnit(0, TestUnit::TestSuite, "root")),
-	m_pArgBuilder(CreateArgumentBuilder(fileName, *this, observer)),
-	m_hProcess(nullptr),
-	m_hStdin(nullptr)
+	m_pArgBuilder(CreateArgumentBuilder(fileName, testType, *this, observer)),
+	m_fileName(fileName)
+{
+	Load(pCancellation, pUnits);
+}
+
+ExeRunner::ExeRunner(ExeRunner& parent, TestObserver& observer) :
+	m_pObserver(&observer),
+	m_tree(parent.m_tree),
+	m_pArgBuilder(parent.m_pArgBuilder->Clone(*this, observer)),
+	m_pLoop(parent.m_pLoop),
+	m_shardCount(1),
+	m_memoryLimit(parent.m_memoryLimit)
 {
-	Load();
 }
 
 ExeRunner::~ExeRunner()
 {
 	Abort();
 	Wait();
+	m_pResident.reset();
 }
 
 void TraverseTestTreeNode(TestUnitNode& node, TestTreeVisitor& v)
@@ -161,9 +511,19 @@ void ExeRunner::EnableTestUnit(unsigned id, bool enable)
 
 unsigned ExeRunner::GetEnabledOptions(unsigned options)
 {
-	unsigned enabled = m_pArgBuilder->GetEnabledOptions(options);
+	unsigned enabled = m_pArgBuilder->GetEnabledOptions(options) | ExeRunner::Parallel;
+	std::wstring workerArgs;
+	if (m_pArgBuilder->BuildWorkerArgs(0, options, workerArgs))
+	{
+		enabled |= ExeRunner::Resident;
+#ifndef _WIN32
+		enabled |= ExeRunner::Zygote;
+#endif
+	}
 	if ((options & ExeRunner::Repeat) != 0)
 		enabled = (enabled & ~ExeRunner::WaitForDebugger) | ExeRunner::Repeat;
+	if ((options & (ExeRunner::Parallel | ExeRunner::Resident)) != 0)
+		enabled &= ~ExeRunner::WaitForDebugger;
 	return enabled;
 }
 
@@ -175,6 +535,8 @@ bool ExeRunner::IsRunning() const
 void ExeRunner::SetRepeat(bool repeat)
 {
 	m_repeat = repeat;
+	if (m_pResident)
+		m_pResident->SetRepeat(repeat);
 }
 
 std::wstring ExeRunner::GetCommand(int logLevel, unsigned options, const std::wstring& arguments)
@@ -182,23 +544,141 @@ std::wstring ExeRunner::GetCommand(int logLevel, unsigned options, const std::ws
 	return L"\"" + m_pArgBuilder->GetExePathName() + L"\" " + m_pArgBuilder->BuildPublicArgs(*this, logLevel, options) + L" " + arguments;
 }
 
+void ExeRunner::SetShardCount(unsigned count)
+{
+	m_shardCount = std::max(1u, count);
+}
+
+// Runs the test tree count times in one test process, 0 until a test fails.
+// This needs a gui header that supports it, others run the tree once.
+void ExeRunner::SetIterations(unsigned count)
+{
+	m_iterations = count;
+}
+
+void ExeRunner::SetTimeouts(unsigned testCaseTimeout, unsigned runTimeout)
+{
+	m_testCaseTimeout = testCaseTimeout;
+	m_runTimeout = runTimeout;
+}
+
+void ExeRunner::SetMemoryLimit(unsigned megabytes)
+{
+	m_memoryLimit = megabytes;
+}
+
+std::wstring ExeRunner::BuildTestArgs(int logLevel, unsigned options, const std::wstring& arguments)
+{
+	std::wstring args = m_pArgBuilder->BuildArgs(*this, logLevel, options);
+	std::wstring repeatArg;
+	if (m_iterations != 1 && m_pArgBuilder->GetRepeatArg(m_iterations, repeatArg))
+		args += L" " + repeatArg;
+	return args + L" " + arguments;
+}
+
 void ExeRunner::Run(int logLevel, unsigned options, const std::wstring& arguments)
 {
 	if (m_pThread)
 		return;
 
-	m_testArgs = m_pArgBuilder->BuildArgs(*this, logLevel, options) + L" " + arguments;
+	m_logLevel = logLevel;
+	m_options = options;
+	m_arguments = arguments;
+	m_aborted = false;
+	m_continuing = false;
+	if ((options & ExeRunner::Parallel) != 0 && m_shardCount > 1)
+	{
+		m_pResident.reset();
+		m_repeat = (options & ExeRunner::Repeat) != 0;
+		unsigned shardOptions = options & ~(ExeRunner::Repeat | ExeRunner::Parallel | ExeRunner::WaitForDebugger);
+		m_pThread.reset(new boost::thread([=]() { RunShards(logLevel, shardOptions, arguments); }));
+		return;
+	}
+
+	std::wstring workerArgs;
+	if ((options & ExeRunner::Resident) != 0 && m_pArgBuilder->BuildWorkerArgs(logLevel, options, workerArgs))
+	{
+		workerArgs += L" " + arguments;
+		if (m_pResident && !m_pResident->CanRun(workerArgs))
+			m_pResident.reset();
+		if (!m_pResident)
+			m_pResident.reset(new ResidentRunner(*this, *m_pObserver, workerArgs, m_durations));
+		m_pResident->SetTimeouts(m_testCaseTimeout, m_runTimeout);
+		m_pResident->SetRepeat((options & ExeRunner::Repeat) != 0);
+		std::vector<unsigned> testCases;
+		GetEnabledTestCases(m_tree, testCases);
+		m_pThread.reset(new boost::thread([this, testCases]() { RunResident(testCases); }));
+		return;
+	}
+
+	m_pResident.reset();
+
+	m_testArgs = BuildTestArgs(logLevel, options, arguments);
 	m_repeat = (options & ExeRunner::Repeat) != 0;
+	m_waitingTestArgs.clear();
+	if ((m_pArgBuilder->GetEnabledOptions(options) & ExeRunner::WaitForDebugger) != 0)
+	{
+		unsigned waitOptions = (options & ~ExeRunner::Repeat) | ExeRunner::WaitForDebugger;
+		m_waitingTestArgs = BuildTestArgs(logLevel, waitOptions, arguments);
+	}
 	StartTestProcess();
+#ifndef _WIN32
+	if (m_pLoop)
+	{
+		m_pObserver->TestStarted();
+		return StartReading();
+	}
+#endif
 	m_pThread.reset(new boost::thread([this]() { RunTest(); }));
 }
 
+// The test events come over the first channel of the process, apart from its output.
+// Then stderr is read apart from stdout, so it cannot split the lines of the test output.
+// On POSIX, each test process leads a process group of its own that KillTestProcess() ends.
+std::unique_ptr<Process> ExeRunner::CreateTestProcess(const std::wstring& arguments) const
+{
+#ifndef _WIN32
+	std::size_t memoryLimit = static_cast<std::size_t>(m_memoryLimit) << 20;
+	if (m_pArgBuilder->HasEventChannel())
+		return std::unique_ptr<Process>(new Process(m_pArgBuilder->GetExePathName(), arguments + L" --gui_events=" + std::to_wstring(EventChannelFd), m_environment, 1, true, memoryLimit));
+	return std::unique_ptr<Process>(new Process(m_pArgBuilder->GetExePathName(), arguments, m_environment, 0, false, memoryLimit));
+#else
+	return std::unique_ptr<Process>(new Process(m_pArgBuilder->GetExePathName(), arguments, m_environment));
+#endif
+}
+
 void ExeRunner::StartTestProcess()
 {
-	m_pProcess.reset(new Process(m_pArgBuilder->GetExePathName(), m_testArgs));
-	m_hProcess = m_pProcess->GetProcessHandle();
+	StartTestProcess(CreateTestProcess(m_testArgs));
+}
+
+void ExeRunner::StartTestProcess(std::unique_ptr<Process> pProcess)
+{
+	m_pProcess = std::move(pProcess);
+	m_continued = false;
+	m_runningTestCase = 0;
+	m_processStartedTestCases = m_startedTestCases.size();
+#ifndef _WIN32
+	if (m_pArgBuilder->HasEventChannel())
+	{
+		m_hEvents = m_pProcess->GetChannelOut(0);
+		m_eventsOpen = false;
+		m_eventDecoder = EventDecoder();
+		m_pErrorReader.reset(new LineReader(m_pProcess->GetStdErr()));
+	}
+	else
+#endif
+	{
+		m_pErrorReader.reset();
+	}
+	{
+		boost::mutex::scoped_lock lock(m_processMutex);
+		m_hProcess = m_pProcess->GetProcessHandle();
+	}
+	m_pOutputReader.reset(new LineReader(m_pProcess->GetStdOut()));
+	m_outputSequence = 0;
 	m_pObserver->test_start();
-	m_pObserver->test_message(Severity::Info, stringbuilder() << "Process " << m_pProcess->GetProcessId() << ": " << Str(m_pProcess->GetName()) << ", started");
+	m_pObserver->test_message(Severity::Info, (stringbuilder() << "Process " << m_pProcess->GetProcessId() << ": " << Str(m_pProcess->GetName()) << ", started").str());
 	m_testFinished = false;
 }
 
@@ -207,30 +687,166 @@ void ExeRunner::WaitForTestProcess()
 	if (!m_pProcess)
 		return;
 
+	// The watchdog thread and Abort() must be done with the process id before it is reaped
+	// and can be reused, until then the ended process keeps it.
+#ifndef _WIN32
+	m_pProcess->WaitForExit();
+#endif
+	{
+		boost::mutex::scoped_lock lock(m_processMutex);
+		m_hProcess = NoProcessHandle;
+	}
 	m_pProcess->Wait();
-	m_pObserver->test_message(Severity::Info, stringbuilder() << "Process " << m_pProcess->GetProcessId() << ": " << Str(m_pProcess->GetName()) << ", finished");
+	ReportTimeout();
+	m_pObserver->test_message(Severity::Info, (stringbuilder() << "Process " << m_pProcess->GetProcessId() << ": " << Str(m_pProcess->GetName()) << ", finished").str());
 	m_pObserver->test_finish();
 	m_pProcess.reset();
-	m_hProcess = nullptr;
+	m_hEvents = NoFileHandle;
+}
+
+// A repeated test run only waits for the observer when it has fallen behind.
+void ExeRunner::WaitForObserver()
+{
+	while (m_repeat && m_pObserver->QueuedEvents() > MaxQueuedEvents)
+		boost::thread::sleep(boost::get_system_time() + boost::posix_time::milliseconds(1));
 }
 
 void ExeRunner::Continue()
 {
-	if (!m_hStdin)
+	if (m_hStdin == NoFileHandle)
 		return;
 
 	hstream hs(m_hStdin);
 	hs.put('\n');
-	m_hStdin = nullptr;
+	m_hStdin = NoFileHandle;
 }
 
 void ExeRunner::Abort()
 {
-	if (!m_hProcess)
+	m_repeat = false;
+	m_aborted = true;
+	{
+		boost::mutex::scoped_lock lock(m_shardMutex);
+		// The workers of this runner share its scheduler.
+		if (m_pScheduler && !m_shards.empty())
+			m_pScheduler->Cancel();
+		for (auto it = m_shards.begin(); it != m_shards.end(); ++it)
+			(*it)->pRunner->Abort();
+#ifndef _WIN32
+		// Takes the forked workers along:
+		if (m_pZygote)
+			KillProcessGroup(m_pZygote->GetProcessHandle());
+#endif
+	}
+
+	// An idle resident test process is kept for the next run.
+	if (m_pResident && m_pThread)
+		m_pResident->Abort();
+
+	KillTestProcess();
+}
+
+// A test process leads a process group of its own on POSIX, killing the group also ends the
+// processes that the test started, like the ones that --isolate forks for each test case.
+void ExeRunner::KillTestProcess()
+{
+	boost::mutex::scoped_lock lock(m_processMutex);
+	if (m_hProcess == NoProcessHandle)
 		return;
 
-	m_repeat = false;
-	TerminateProcess(m_hProcess, static_cast<unsigned>(-1));
+#ifdef _WIN32
+	KillProcess(m_hProcess);
+#else
+	KillProcessGroup(m_hProcess);
+#endif
+}
+
+// Runs on the watchdog thread. A test case that runs too long is killed with its test process,
+// a forked worker takes the zygote and its other workers along. Returns false when the run
+// took too long, then it is aborted.
+bool ExeRunner::CheckTimeouts(double runTime)
+{
+	unsigned runTimeout = m_runTimeout > 0 && runTime >= m_runTimeout ? m_runTimeout : 0;
+	{
+		boost::mutex::scoped_lock lock(m_shardMutex);
+		if (CheckTestCaseTimeout(m_testCaseTimeout, runTimeout) && runTimeout == 0)
+			KillTestProcess();
+		for (auto it = m_shards.begin(); it != m_shards.end(); ++it)
+		{
+			ExeRunner& runner = *(*it)->pRunner;
+			if (runner.CheckTestCaseTimeout(m_testCaseTimeout, runTimeout) && runTimeout == 0)
+				runner.KillTestProcess();
+		}
+	}
+
+	if (runTimeout == 0)
+		return true;
+
+	Abort();
+	return false;
+}
+
+// Decides whether the test process of this runner is to be killed, the runner reports why
+// when the process ended. A run timeout, runTimeout > 0, names the test case it interrupts.
+bool ExeRunner::CheckTestCaseTimeout(unsigned testCaseTimeout, unsigned runTimeout)
+{
+	if (!HasTestProcess())
+		return false;
+
+	// The id is read before the start time, so the time of a test case that just started
+	// cannot be taken for the time of the one before it.
+	unsigned id = m_runningTestCase;
+	long long elapsed = GetSteadyTime() - m_testCaseStartTime;
+
+	std::string name;
+	if (id != 0)
+	{
+		boost::mutex::scoped_lock lock(m_timeoutMutex);
+		if (auto p = GetTestUnitPtr(id))
+			name = p->fullName;
+	}
+
+	stringbuilder message;
+	if (id == 0)
+		message << "Test process";
+	else if (!name.empty())
+		message << "Test case " << name << " (id " << id << ")";
+	else
+		message << "Test case " << id;
+
+	if (runTimeout > 0)
+		message << " killed, the test run timed out after " << runTimeout << " s";
+	else if (id != 0 && testCaseTimeout > 0 && elapsed >= testCaseTimeout * 1000ll)
+		message << " timed out after " << testCaseTimeout << " s";
+	else
+		return false;
+
+	// The process is already being killed:
+	boost::mutex::scoped_lock lock(m_timeoutMutex);
+	if (!m_timeoutMessage.empty())
+		return false;
+
+	m_timedOutTestCase = id;
+	m_timeoutMessage = message.str();
+	return true;
+}
+
+void ExeRunner::ReportTimeout()
+{
+	unsigned id;
+	std::string message;
+	{
+		boost::mutex::scoped_lock lock(m_timeoutMutex);
+		id = m_timedOutTestCase;
+		message.swap(m_timeoutMessage);
+		m_timedOutTestCase = 0;
+	}
+	if (message.empty())
+		return;
+
+	m_pObserver->test_message(Severity::Fatal, message);
+	if (id != 0)
+		AbortTestCase(id);
 }
 
 void ExeRunner::Wait()
@@ -245,32 +861,64 @@ void ExeRunner::Wait()
 
 void ExeRunner::OnWaiting()
 {
+	if (m_continued)
+		return;
+
 	m_hStdin = m_pProcess->GetStdIn();
 	m_pObserver->test_waiting(m_pProcess->GetName(), m_pProcess->GetProcessId());
 }
 
+// A test process that continues after a crash runs the rest of the iteration that crashed.
 void ExeRunner::OnTestIterationStart(unsigned count)
 {
+	if (m_continuing)
+	{
+		m_continuing = false;
+		return;
+	}
+
+	m_startedTestCases.clear();
+	m_processStartedTestCases = 0;
+	m_openSuites.clear();
 	m_pObserver->test_iteration_start(count);
 }
 
 void ExeRunner::OnTestSuiteStart(unsigned id)
 {
+	m_openSuites.push_back(id);
 	m_pObserver->test_suite_start(id);
 }
 
 void ExeRunner::OnTestCaseStart(unsigned id)
 {
+	m_assertionsPassed = 0;
+	m_assertionsFailed = 0;
+	m_testCaseStartTime = GetSteadyTime();
+	m_runningTestCase = id;
+	m_startedTestCases.push_back(id);
 	m_pObserver->test_case_start(id);
 }
 
+// Passed assertions are only counted, the test case reports the counts when it finishes.
 void ExeRunner::OnTestAssertion(bool passed)
 {
-	if (!passed)
-		m_repeat = false;
+	if (passed)
+	{
+		++m_assertionsPassed;
+		return;
+	}
+
+	++m_assertionsFailed;
+	m_repeat = false;
 	m_pObserver->assertion_result(passed);
 }
 
+// The headers count the passed assertions of a test case and report them once.
+void ExeRunner::OnTestAssertions(unsigned passed)
+{
+	m_assertionsPassed += passed;
+}
+
 void ExeRunner::OnTestExceptionCaught(const std::string& what)
 {
 	m_repeat = false;
@@ -279,19 +927,101 @@ void ExeRunner::OnTestExceptionCaught(const std::string& what)
 
 void ExeRunner::OnTestCaseFinish(unsigned id, unsigned elapsed)
 {
+	SetTestCaseDuration(id, elapsed);
+	EndTestCase(id);
 	m_pObserver->test_case_finish(id, elapsed);
 }
 
 void ExeRunner::OnTestCaseFinish(unsigned id, unsigned elapsed, TestCaseState::type state)
 {
+	if (state == TestCaseState::Failed)
+		m_repeat = false;
+	SetTestCaseDuration(id, elapsed);
+	EndTestCase(id);
 	m_pObserver->test_case_finish(id, elapsed, state);
 }
 
+void ExeRunner::SetTestCaseDuration(unsigned id, unsigned elapsed)
+{
+	m_durations[id] = elapsed;
+}
+
+void ExeRunner::EndTestCase(unsigned id)
+{
+	m_pObserver->test_case_assertions(id, m_assertionsPassed, m_assertionsFailed);
+	m_assertionsPassed = 0;
+	m_assertionsFailed = 0;
+	m_runningTestCase = 0;
+}
+
 void ExeRunner::OnTestSuiteFinish(unsigned id, unsigned elapsed)
 {
+	if (!m_openSuites.empty() && m_openSuites.back() == id)
+		m_openSuites.pop_back();
 	m_pObserver->test_suite_finish(id, elapsed);
 }
 
+// Reports a test case that its test process did not finish as aborted and failed, the way
+// the headers report a test case that crashed in a forked process.
+void ExeRunner::AbortTestCase(unsigned id)
+{
+	unsigned elapsed = static_cast<unsigned>(GetSteadyTime() - m_testCaseStartTime);
+	OnTestUnitAborted(id);
+	OnTestCaseFinish(id, elapsed, TestCaseState::Failed);
+}
+
+// Reports the unexpected end of the test process and the test case that was running then
+// as aborted, and closes the test suites that were open. All run modes report a crash so.
+void ExeRunner::EndCrashedTestCase()
+{
+	OnTestAssertion(false);
+	m_pObserver->test_message(Severity::Fatal, "Unexpected end of test process");
+	if (unsigned id = m_runningTestCase)
+	{
+		m_pObserver->test_message(Severity::Fatal, (stringbuilder() << "Test case " << GetTestUnit(id).fullName << " (id " << id << ") crashed").str());
+		AbortTestCase(id);
+	}
+	while (!m_openSuites.empty())
+	{
+		m_pObserver->test_suite_finish(m_openSuites.back(), 0);
+		m_openSuites.pop_back();
+	}
+}
+
+// Starts a test process for the enabled test cases that did not get to run yet after the
+// crashed one was ended. The observer sees the partial runs as one iteration. Workers and
+// the resident process are restarted by their own runners instead, and a test process
+// that ended before it started a test case is not restarted.
+bool ExeRunner::ContinueAfterCrash()
+{
+	if (m_aborted || !m_environment.empty())
+		return false;
+	if (m_startedTestCases.size() == m_processStartedTestCases)
+		return false;
+
+	std::vector<unsigned> started(m_startedTestCases);
+	std::sort(started.begin(), started.end());
+	TestUnitNode tree(m_tree);
+	if (!DisableTestCases(tree, started))
+		return false;
+
+	// The arguments select the enabled test cases of the tree. The watchdog thread looks up
+	// test units in the tree, so it is swapped under the lock that it takes for that.
+	auto swapTree = [&]()
+	{
+		boost::mutex::scoped_lock lock(m_timeoutMutex);
+		std::swap(m_tree, tree);
+	};
+	swapTree();
+	auto guard = make_guard(swapTree);
+	unsigned options = m_options & ~(ExeRunner::Repeat | ExeRunner::WaitForDebugger);
+	std::wstring args = m_pArgBuilder->BuildArgs(*this, m_logLevel, options) + L" " + m_arguments;
+	m_pObserver->test_message(Severity::Info, (stringbuilder() << "Continuing with the " << CountEnabledTestCases(m_tree) << " test cases that did not run").str());
+	StartTestProcess(CreateTestProcess(args));
+	m_continuing = true;
+	return true;
+}
+
 void ExeRunner::OnTestUnitSkipped(unsigned id)
 {
 	m_pObserver->test_unit_skipped(id);
@@ -300,6 +1030,7 @@ void ExeRunner::OnTestUnitSkipped(unsigned id)
 void ExeRunner::OnTestUnitAborted(unsigned id)
 {
 	m_repeat = false;
+	m_runningTestCase = 0;
 	m_pObserver->test_unit_aborted(id);
 }
 
@@ -346,23 +1077,51 @@ try
 {
 	m_pObserver->TestStarted();
 	auto guard = make_guard([this]() { m_pObserver->TestFinished(); });
+	Watchdog watchdog(*this);
+
+	// While an iteration runs, the process for the next one starts up and waits to be continued.
+	// A test process that continues after a crash keeps the one that is already waiting.
+	std::unique_ptr<Process> pNextProcess;
+	auto nextGuard = make_guard([&pNextProcess]()
+	{
+		if (!pNextProcess)
+			return;
+		KillProcess(pNextProcess->GetProcessHandle());
+		pNextProcess->Wait();
+	});
 
 	for (;;)
 	{
+		if (m_repeat && !m_waitingTestArgs.empty() && !pNextProcess)
+			pNextProcess = CreateTestProcess(m_waitingTestArgs);
+
 		RunTestIteration();
 		WaitForTestProcess();
 		if (!m_testFinished)
 		{
-			OnTestAssertion(false);
-			m_pObserver->test_message(Severity::Fatal, "Unexpected end of test process");
+			EndCrashedTestCase();
+			if (ContinueAfterCrash())
+				continue;
 		}
 
 		if (!m_repeat)
 			break;
 
-		// Limit to 10 iterations/s to allow GUI to catch up.
-		boost::thread::sleep(boost::get_system_time() + boost::posix_time::milliseconds(100));
-		StartTestProcess();
+		WaitForObserver();
+		if (!m_repeat)
+			break;
+
+		if (!pNextProcess)
+		{
+			StartTestProcess();
+			continue;
+		}
+
+		StartTestProcess(std::move(pNextProcess));
+		hstream hs(m_pProcess->GetStdIn());
+		hs.put('\n');
+		hs.flush();
+		m_continued = true;
 	}
 }
 catch (std::exception& e)
@@ -372,12 +1131,474 @@ catch (std::exception& e)
 
 void ExeRunner::RunTestIteration()
 {
-	hstream hs(m_pProcess->GetStdOut());
-	std::string line;
-	while (std::getline(hs, line))
+#ifndef _WIN32
+	if (m_hEvents != NoFileHandle)
+		return ReadTestEvents();
+#endif
+
+	LineReader reader(GetTestOutput());
+	std::string_view line;
+	while (reader.GetLine(line))
+	{
+		m_pArgBuilder->FilterMessage(line);
+	}
+}
+
+void ExeRunner::HandleClientEvent(const ClientEvent& event)
+{
+	switch (event.type)
+	{
+	case ClientEvent::Hello:
+		m_eventsOpen = true;
+		break;
+	case ClientEvent::Waiting:
+		OnWaiting();
+		break;
+	case ClientEvent::IterationStart:
+		OnTestIterationStart(event.value);
+		break;
+	case ClientEvent::IterationFinish:
+		OnTestIterationFinish();
+		break;
+	case ClientEvent::Aborted:
+		m_pObserver->test_aborted();
+		break;
+	case ClientEvent::Assertion:
+		OnTestAssertion(event.value != 0);
+		break;
+	case ClientEvent::Exception:
+		OnTestExceptionCaught(event.text);
+		break;
+	case ClientEvent::UnitAssertions:
+		OnTestAssertions(event.value);
+		break;
+	default:
+		HandleTestUnitEvent(event);
+		break;
+	}
+}
+
+void ExeRunner::HandleTestUnitEvent(const ClientEvent& event)
+{
+	auto p = GetTestUnitPtr(m_pArgBuilder->GetEventUnitId(event));
+	if (!p)
+		return;
+
+	switch (event.type)
+	{
+	case ClientEvent::UnitStart:
+		if (p->type == TestUnit::TestCase)
+			OnTestCaseStart(p->id);
+		else
+			OnTestSuiteStart(p->id);
+		break;
+	case ClientEvent::UnitFinish:
+		if (p->type == TestUnit::TestCase)
+			OnTestCaseFinish(p->id, event.value);
+		else
+			OnTestSuiteFinish(p->id, event.value);
+		break;
+	case ClientEvent::UnitPassed:
+		OnTestCaseFinish(p->id, event.value, TestCaseState::Success);
+		break;
+	case ClientEvent::UnitFailed:
+		OnTestCaseFinish(p->id, event.value, TestCaseState::Failed);
+		break;
+	case ClientEvent::UnitSkipped:
+		OnTestUnitSkipped(p->id);
+		break;
+	case ClientEvent::UnitAborted:
+		OnTestUnitAborted(p->id);
+		break;
+	default:
+		throw std::runtime_error("Invalid event record");
+	}
+}
+
+#ifndef _WIN32
+
+bool IsReadable(FileHandle handle)
+{
+	pollfd fd = { handle, POLLIN, 0 };
+	return poll(&fd, 1, 0) > 0;
+}
+
+// Reads stdout, stderr and the event channel until the test process closes them all, or
+// until it waits for the next batch. The header flushes its output before it writes an
+// event, the pending output is read first to keep the messages in order with the events.
+// Only the stdout before the Hello event can hold the text protocol of an older header.
+void ExeRunner::ReadTestEvents()
+{
+	OpenTestStreams();
+	FileHandle hOutput = GetTestOutput();
+	FileHandle hError = m_readingError ? m_pProcess->GetStdErr() : NoFileHandle;
+	while ((m_readingOutput || m_readingError || m_readingEvents) && !IsIdle())
+	{
+		pollfd fds[] = { { m_readingOutput ? hOutput : -1, POLLIN, 0 }, { m_readingError ? hError : -1, POLLIN, 0 }, { m_readingEvents ? m_hEvents : -1, POLLIN, 0 } };
+		if (poll(fds, 3, -1) < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			throw std::runtime_error("poll failed");
+		}
+		ReadTestStreams(fds[0].revents != 0, fds[1].revents != 0, fds[2].revents != 0);
+	}
+}
+
+// The output goes to stdout or to the channel of a forked worker, stderr and the
+// event channel are only there when the header opens the event channel.
+void ExeRunner::OpenTestStreams()
+{
+	m_readingOutput = true;
+	m_readingError = m_pErrorReader && m_pProcess && m_pProcess->GetStdErr() != NoFileHandle;
+	m_readingEvents = m_hEvents != NoFileHandle;
+}
+
+// Reads the streams that are ready. The header flushes its output before it writes an
+// event, the pending output is read first to keep the messages in order with the events.
+void ExeRunner::ReadTestStreams(bool output, bool error, bool events)
+{
+	if (events && m_readingEvents)
+	{
+		FileHandle hOutput = GetTestOutput();
+		while (m_readingOutput && m_eventsOpen && IsReadable(hOutput))
+			m_readingOutput = ReadTestOutput(*m_pOutputReader, OutputStream::StdOut);
+		while (m_readingError && m_eventsOpen && IsReadable(m_pProcess->GetStdErr()))
+			m_readingError = ReadTestOutput(*m_pErrorReader, OutputStream::StdErr);
+		m_readingEvents = ReadEventChannel();
+		return;
+	}
+	if (output && m_readingOutput)
+		m_readingOutput = ReadTestOutput(*m_pOutputReader, OutputStream::StdOut);
+	if (error && m_readingError)
+		m_readingError = ReadTestOutput(*m_pErrorReader, OutputStream::StdErr);
+}
+
+// Hands the streams of the test process to the IoLoop of the parent runner. The loop
+// calls OnTestStreamReady() for each stream that is ready and OnTestProcessExit() when
+// the process ended after it closed all streams, so no thread waits for this runner.
+void ExeRunner::StartReading()
+{
+	OpenTestStreams();
+	m_pLoop->AddReader(GetTestOutput(), [this]() { OnTestStreamReady(true, false, false); });
+	if (m_readingError)
+		m_pLoop->AddReader(m_pProcess->GetStdErr(), [this]() { OnTestStreamReady(false, true, false); });
+	if (m_readingEvents)
+		m_pLoop->AddReader(m_hEvents, [this]() { OnTestStreamReady(false, false, true); });
+}
+
+// The streams stay open until WaitForTestProcess(), so their handles are not reused before.
+// The event handler may have read the output that made its stream ready in the same round.
+void ExeRunner::OnTestStreamReady(bool output, bool error, bool events)
+try
+{
+	if (output && !IsReadable(GetTestOutput()))
+		return;
+	if (error && !IsReadable(m_pProcess->GetStdErr()))
+		return;
+
+	ReadTestStreams(output, error, events);
+	if (!m_readingOutput)
+		m_pLoop->Remove(GetTestOutput());
+	if (!m_readingError && m_pErrorReader)
+		m_pLoop->Remove(m_pProcess->GetStdErr());
+	if (!m_readingEvents && m_hEvents != NoFileHandle)
+		m_pLoop->Remove(m_hEvents);
+	if (!m_readingOutput && !m_readingError && !m_readingEvents)
+		WaitForTestExit();
+}
+catch (std::exception& e)
+{
+	m_pObserver->exception_caught(e.what());
+	AbortTestProcess();
+}
+
+// Stops reading a test process after an error, the exception is all there is to report.
+void ExeRunner::AbortTestProcess()
+{
+	if (m_readingOutput)
+		m_pLoop->Remove(GetTestOutput());
+	if (m_readingError)
+		m_pLoop->Remove(m_pProcess->GetStdErr());
+	if (m_readingEvents)
+		m_pLoop->Remove(m_hEvents);
+	m_readingOutput = false;
+	m_readingError = false;
+	m_readingEvents = false;
+	m_testFinished = true;
+	KillTestProcess();
+	WaitForTestExit();
+}
+
+// A forked worker has no process of its own, the zygote reaps it.
+void ExeRunner::WaitForTestExit()
+{
+	if (m_hProcess != NoProcessHandle)
+		m_pLoop->AddProcess(m_hProcess, [this]() { OnTestProcessExit(); });
+	else
+		OnTestProcessExit();
+}
+
+// Does what RunTest() does when the test process ends.
+void ExeRunner::OnTestProcessExit()
+{
+	try
+	{
+		WaitForTestProcess();
+		if (!m_testFinished)
+		{
+			EndCrashedTestCase();
+			if (ContinueAfterCrash())
+				return StartReading();
+		}
+	}
+	catch (std::exception& e)
+	{
+		m_pObserver->exception_caught(e.what());
+	}
+	m_pObserver->TestFinished();
+}
+
+// Sends the complete lines of test output to the log, returns false at the end of the output.
+// Until the header opened the event channel, stdout is parsed for the text protocol.
+bool ExeRunner::ReadTestOutput(LineReader& reader, OutputStream::type stream)
+{
+	bool more = reader.Read();
+	std::string_view line;
+	while (reader.NextLine(line))
+	{
+		unsigned sequence = ++m_outputSequence;
+		if (m_eventsOpen || stream == OutputStream::StdErr)
+			m_pObserver->test_output(stream, sequence, m_pArgBuilder->GetSeverity(line), line);
+		else
+			m_pArgBuilder->FilterMessage(line);
+	}
+	return more;
+}
+
+// Handles the complete event records, returns false when the test process closed the event channel.
+bool ExeRunner::ReadEventChannel()
+{
+	char buffer[4096];
+	std::size_t size = 0;
+	if (!ReadHandle(m_hEvents, buffer, sizeof(buffer), size) || size == 0)
+		return false;
+
+	m_eventDecoder.Append(buffer, size);
+	ClientEvent event;
+	while (m_eventDecoder.Next(event))
+		HandleClientEvent(event);
+	return true;
+}
+
+#endif
+
+void ExeRunner::RunShards(int logLevel, unsigned options, const std::wstring& arguments)
+try
+{
+	m_pObserver->TestStarted();
+	auto guard = make_guard([this]() { m_pObserver->TestFinished(); });
+	Watchdog watchdog(*this);
+
+#ifndef _WIN32
+	// One loop on this thread reads all shards, however many there are.
+	IoLoop loop;
+	m_pLoop = &loop;
+	auto loopGuard = make_guard([this]() { m_pLoop = nullptr; });
+#endif
+
+	std::wstring workerArgs;
+	bool workers = m_pArgBuilder->BuildWorkerArgs(logLevel, options, workerArgs);
+	for (;;)
+	{
+		ShardMerger merger(*m_pObserver);
+		m_pObserver->test_iteration_start(CountEnabledTestCases(m_tree));
+		if (workers)
+		{
+			RunWorkers(merger, logLevel, options, arguments);
+		}
+		else
+		{
+			StartShards(merger, logLevel, options, arguments);
+			WaitForShards();
+		}
+		m_pObserver->test_iteration_finish();
+
+		if (!m_repeat || merger.Failed())
+			break;
+
+		WaitForObserver();
+	}
+}
+catch (std::exception& e)
+{
+	m_pObserver->exception_caught(e.what());
+}
+
+void ExeRunner::StartShards(ShardMerger& merger, int logLevel, unsigned options, const std::wstring& arguments)
+{
+	unsigned shardCount = std::min(m_shardCount, CountEnabledTestCases(m_tree));
+
+	boost::mutex::scoped_lock lock(m_shardMutex);
+	try
 	{
-		m_pArgBuilder->FilterMessage(Chomp(line));
+		for (unsigned shard = 0; shard < shardCount; ++shard)
+		{
+			std::unique_ptr<Shard> pShard(new Shard(merger));
+			pShard->pRunner.reset(new ShardRunner(*this, shard, shardCount, pShard->observer));
+			m_shards.push_back(std::move(pShard));
+			m_shards.back()->pRunner->Run(logLevel, options, arguments);
+		}
 	}
+	catch (...)
+	{
+		for (auto it = m_shards.begin(); it != m_shards.end(); ++it)
+			(*it)->pRunner->Abort();
+		lock.unlock();
+		WaitForShards();
+		throw;
+	}
+}
+
+void ExeRunner::WaitForShards()
+{
+#ifndef _WIN32
+	if (m_pLoop)
+		m_pLoop->Run();
+#endif
+	for (auto it = m_shards.begin(); it != m_shards.end(); ++it)
+		(*it)->pRunner->Wait();
+
+	boost::mutex::scoped_lock lock(m_shardMutex);
+	m_shards.clear();
+}
+
+void ExeRunner::RunWorkers(ShardMerger& merger, int logLevel, unsigned options, const std::wstring& arguments)
+{
+	std::vector<unsigned> testCases;
+	GetEnabledTestCases(m_tree, testCases);
+	TestScheduler scheduler(testCases, m_durations, m_shardCount, (options & ExeRunner::Randomize) != 0);
+	unsigned workerCount = std::min<unsigned>(m_shardCount, testCases.size());
+
+	std::wstring workerArgs;
+	m_pArgBuilder->BuildWorkerArgs(logLevel, options, workerArgs);
+	workerArgs += L" " + arguments;
+
+	{
+		boost::mutex::scoped_lock lock(m_shardMutex);
+		m_pScheduler = &scheduler;
+		try
+		{
+#ifndef _WIN32
+			// The event channels of the forked workers follow their batch channels,
+			// the zygote opens the one of worker 0.
+			std::wstring zygoteArgs;
+			if ((options & ExeRunner::Zygote) != 0 && m_pArgBuilder->BuildZygoteArgs(logLevel, options, workerCount, zygoteArgs))
+			{
+				unsigned channels = workerCount;
+				if (m_pArgBuilder->HasEventChannel())
+				{
+					channels *= 2;
+					zygoteArgs += L" --gui_events=" + std::to_wstring(EventChannelFd + 2 * workerCount);
+				}
+				m_pZygote.reset(new Process(m_pArgBuilder->GetExePathName(), zygoteArgs + L" " + arguments, m_environment, channels, false, static_cast<std::size_t>(m_memoryLimit) << 20));
+				m_pObserver->test_message(Severity::Info, (stringbuilder() << "Process " << m_pZygote->GetProcessId() << ": " << Str(m_pZygote->GetName()) << ", forking " << workerCount << " workers").str());
+			}
+#endif
+			for (unsigned worker = 0; worker < workerCount; ++worker)
+			{
+				std::unique_ptr<Shard> pShard(new Shard(merger));
+				std::unique_ptr<WorkerRunner> pRunner(new WorkerRunner(*this, scheduler, pShard->observer));
+				WorkerRunner& runner = *pRunner;
+				pShard->pRunner = std::move(pRunner);
+				m_shards.push_back(std::move(pShard));
+				if (m_pZygote)
+					runner.StartForkedWorker(*m_pZygote, worker, workerCount, workerArgs);
+				else
+					runner.StartWorker(workerArgs);
+			}
+		}
+		catch (...)
+		{
+			scheduler.Cancel();
+			for (auto it = m_shards.begin(); it != m_shards.end(); ++it)
+				(*it)->pRunner->Abort();
+#ifndef _WIN32
+			if (m_pZygote)
+				KillProcessGroup(m_pZygote->GetProcessHandle());
+#endif
+			lock.unlock();
+			WaitForShards();
+			if (m_pZygote)
+				m_pZygote->Wait();
+			m_pZygote.reset();
+			m_pScheduler = nullptr;
+			throw;
+		}
+	}
+
+#ifndef _WIN32
+	// The zygote writes to its own output only before it forks or when forking fails.
+	std::unique_ptr<LineReader> pZygoteReader;
+	if (m_pZygote)
+	{
+		FileHandle hOutput = m_pZygote->GetStdOut();
+		pZygoteReader.reset(new LineReader(hOutput));
+		m_pLoop->AddReader(hOutput, [&, hOutput]()
+		{
+			bool more = pZygoteReader->Read();
+			std::string_view line;
+			while (pZygoteReader->NextLine(line))
+			{
+				std::string msg(line);
+				merger.Post([msg](TestObserver& observer) { observer.test_message(Severity::Info, msg); });
+			}
+			if (!more)
+				m_pLoop->Remove(hOutput);
+		});
+	}
+#endif
+
+	WaitForShards();
+	if (m_pZygote)
+		m_pZygote->Wait();
+	{
+		boost::mutex::scoped_lock lock(m_shardMutex);
+		m_pZygote.reset();
+		m_pScheduler = nullptr;
+	}
+	m_durations = scheduler.GetDurations();
+
+	// All workers ended without getting to these:
+	if (unsigned remaining = scheduler.Remaining())
+	{
+		merger.SetFailed();
+		m_pObserver->test_message(Severity::Error, (stringbuilder() << remaining << " test cases were not run").str());
+	}
+}
+
+FileHandle ExeRunner::GetTestOutput() const
+{
+	return m_pProcess->GetStdOut();
+}
+
+bool ExeRunner::HasTestProcess()
+{
+	boost::mutex::scoped_lock lock(m_processMutex);
+	return m_hProcess != NoProcessHandle;
+}
+
+bool ExeRunner::IsIdle() const
+{
+	return false;
+}
+
+// The watchdog checks the timeouts of the resident runner, that reports to the observer
+// of this runner.
+void ExeRunner::RunResident(const std::vector<unsigned>& testCases)
+{
+	Watchdog watchdog(*m_pResident);
+	m_pResident->RunTestCases(testCases);
 }
 
 } // namespace gj
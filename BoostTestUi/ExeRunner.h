@@ -16,11 +16,20 @@
 #include <boost/thread.hpp>
 #pragma warning(pop)
 #include <boost/noncopyable.hpp>
+#include <atomic>
+#include <ctime>
 #include "TestRunner.h"
 #include "Process.h"
+#include "EventChannel.h"
+#include "LineReader.h"
+#include "ShardObserver.h"
+#include "TestScheduler.h"
 
 namespace gj {
 
+class IoLoop;
+class ResidentRunner;
+
 struct UnitTestType
 {
 	enum type { Boost, Catch, Google, NUnit };
@@ -36,12 +45,45 @@ private:
 	UnitTestType::type m_testType;
 };
 
+class LoadCanceledError : public std::runtime_error
+{
+public:
+	LoadCanceledError();
+};
+
+// Cancels the loading of test trees from another thread. The running listing
+// processes are killed and the ExeRunner or Workspace that loads with it
+// throws LoadCanceledError.
+class LoadCancellation : boost::noncopyable
+{
+public:
+	LoadCancellation();
+
+	void Cancel();
+	bool IsCanceled() const;
+	// Throws LoadCanceledError when the load is canceled.
+	void Check() const;
+
+	// A listing process is killed when the load is canceled while it runs.
+	void AddListing(ProcessHandle hProcess);
+	void RemoveListing(ProcessHandle hProcess);
+
+private:
+	mutable boost::mutex m_mutex;
+	bool m_canceled;
+	std::vector<ProcessHandle> m_listings;
+};
+
+unsigned CountEnabledTestCases(const TestUnitNode& node);
+
 class ExeRunner :
 	boost::noncopyable,
 	public TestRunner
 {
 public:
-	ExeRunner(const std::wstring& fileName, TestObserver& observer);
+	// testType is the result of GetUnitTestType when the caller already knows it.
+	// pUnits receives the test units in tree order while the listing is parsed.
+	ExeRunner(const std::wstring& fileName, TestObserver& observer, const std::string& testType = std::string(), LoadCancellation* pCancellation = nullptr, TestTreeVisitor* pUnits = nullptr);
 	virtual ~ExeRunner();
 
 	virtual TestSuite& RootTestSuite() override;
@@ -59,11 +101,20 @@ public:
 	virtual void Abort() override;
 	virtual void Wait() override;
 
-	void OnWaiting();
+	void SetShardCount(unsigned count);
+	void SetIterations(unsigned count);
+	// A test case that runs longer than testCaseTimeout seconds is killed with its test
+	// process, a run that takes longer than runTimeout seconds is aborted. 0: no limit.
+	void SetTimeouts(unsigned testCaseTimeout, unsigned runTimeout);
+	// Limits the address space of each test process, POSIX only. 0: no limit.
+	void SetMemoryLimit(unsigned megabytes);
+
+	virtual void OnWaiting();
 	void OnTestIterationStart(unsigned count);
 	void OnTestSuiteStart(unsigned id);
-	void OnTestCaseStart(unsigned id);
+	virtual void OnTestCaseStart(unsigned id);
 	void OnTestAssertion(bool result);
+	void OnTestAssertions(unsigned passed);
 	void OnTestExceptionCaught(const std::string& what);
 	void OnTestCaseFinish(unsigned id, unsigned elapsed);
 	void OnTestCaseFinish(unsigned id, unsigned elapsed, TestCaseState::type state);
@@ -75,27 +126,120 @@ public:
 	virtual TestUnit& GetTestUnit(unsigned id);
 	virtual TestUnit* GetTestUnitPtr(unsigned id);
 
-private:
-	TestUnitNode& RootTestUnitNode();
-	TestUnitNode& GetTestUnitNode(unsigned id);
-	void Load();
-	void HandleClientNotification(const std::string& line);
-	void RunTest();
+protected:
+	// The runners of a part of the test run of parent, they report to observer.
+	ExeRunner(ExeRunner& parent, TestObserver& observer);
+
 	void RunTestIteration();
+#ifndef _WIN32
+	void ReadTestEvents();
+	void StartReading();
+	virtual void AbortTestProcess();
+	virtual void OnTestProcessExit();
+#endif
+	std::unique_ptr<Process> CreateTestProcess(const std::wstring& arguments) const;
 	void StartTestProcess();
-	void WaitForTestProcess();
+	void StartTestProcess(std::unique_ptr<Process> pProcess);
+	virtual void WaitForTestProcess();
+	void WaitForObserver();
+	virtual FileHandle GetTestOutput() const;
+	virtual bool HasTestProcess();
+	virtual void KillTestProcess();
+	void EndCrashedTestCase();
+	void ReportTimeout();
+	// A resident test process that waits for its next batch is idle.
+	virtual bool IsIdle() const;
+	virtual void SetTestCaseDuration(unsigned id, unsigned elapsed);
 
-	std::wstring m_fileName;
 	std::wstring m_testArgs;
-	bool m_repeat;
+	std::atomic<bool> m_repeat{false};
+	std::atomic<bool> m_aborted{false};
 	TestObserver* m_pObserver;
 	TestUnitNode m_tree;
 	std::unique_ptr<ArgumentBuilder> m_pArgBuilder;
 	std::unique_ptr<Process> m_pProcess;
-	bool m_testFinished;
+	FileHandle m_hEvents = NoFileHandle;
+	bool m_eventsOpen = false;
+	EventDecoder m_eventDecoder;
+	std::unique_ptr<LineReader> m_pOutputReader;
+	std::unique_ptr<LineReader> m_pErrorReader;
+	bool m_testFinished = false;
+	bool m_continuing = false;
+	std::vector<unsigned> m_startedTestCases;
+	std::size_t m_processStartedTestCases = 0;
 	std::unique_ptr<boost::thread> m_pThread;
-	HANDLE m_hStdin;
-	HANDLE m_hProcess;
+	IoLoop* m_pLoop = nullptr;
+	// Guards m_hProcess, the watchdog thread reads it.
+	boost::mutex m_processMutex;
+	ProcessHandle m_hProcess = NoProcessHandle;
+	unsigned m_testCaseTimeout = 0;
+	unsigned m_runTimeout = 0;
+	Environment m_environment;
+
+private:
+	struct Shard;
+	struct Watchdog;
+
+	static const unsigned MaxQueuedEvents = 1000;
+	static const unsigned WatchdogInterval = 100;
+
+	TestUnitNode& RootTestUnitNode();
+	TestUnitNode& GetTestUnitNode(unsigned id);
+	void Load(LoadCancellation* pCancellation, TestTreeVisitor* pUnits);
+	void HandleClientNotification(const std::string& line);
+	void HandleClientEvent(const ClientEvent& event);
+	void HandleTestUnitEvent(const ClientEvent& event);
+	void RunTest();
+#ifndef _WIN32
+	bool ReadTestOutput(LineReader& reader, OutputStream::type stream);
+	bool ReadEventChannel();
+	void OpenTestStreams();
+	void ReadTestStreams(bool output, bool error, bool events);
+	void OnTestStreamReady(bool output, bool error, bool events);
+	void WaitForTestExit();
+#endif
+	std::wstring BuildTestArgs(int logLevel, unsigned options, const std::wstring& arguments);
+	void RunShards(int logLevel, unsigned options, const std::wstring& arguments);
+	void StartShards(ShardMerger& merger, int logLevel, unsigned options, const std::wstring& arguments);
+	void WaitForShards();
+	void RunWorkers(ShardMerger& merger, int logLevel, unsigned options, const std::wstring& arguments);
+	void RunResident(const std::vector<unsigned>& testCases);
+	void EndTestCase(unsigned id);
+	void AbortTestCase(unsigned id);
+	bool ContinueAfterCrash();
+	bool CheckTimeouts(double runTime);
+	bool CheckTestCaseTimeout(unsigned testCaseTimeout, unsigned runTimeout);
+
+	std::wstring m_fileName;
+	std::wstring m_waitingTestArgs;
+	int m_logLevel = 0;
+	unsigned m_options = 0;
+	std::wstring m_arguments;
+	unsigned m_outputSequence = 0;
+	bool m_readingOutput = false;
+	bool m_readingError = false;
+	bool m_readingEvents = false;
+	bool m_continued = false;
+	std::vector<unsigned> m_openSuites;
+	FileHandle m_hStdin = NoFileHandle;
+	unsigned m_shardCount = std::max(1u, boost::thread::hardware_concurrency());
+	unsigned m_iterations = 1;
+	boost::mutex m_shardMutex;
+	std::vector<std::unique_ptr<Shard>> m_shards;
+	// The scheduler of the workers of a parallel run and the zygote that forks them.
+	TestScheduler* m_pScheduler = nullptr;
+	std::unique_ptr<Process> m_pZygote;
+	TestDurations m_durations;
+	std::unique_ptr<ResidentRunner> m_pResident;
+	unsigned m_assertionsPassed = 0;
+	unsigned m_assertionsFailed = 0;
+	unsigned m_memoryLimit = 0;
+	std::atomic<unsigned> m_runningTestCase{0};
+	std::atomic<long long> m_testCaseStartTime{0};
+	// Guards the timeout report and the test tree that the watchdog thread reads.
+	boost::mutex m_timeoutMutex;
+	unsigned m_timedOutTestCase = 0;
+	std::string m_timeoutMessage;
 };
 
 } // namespace gj
@@ -6,11 +6,33 @@
 // See http://boosttestui.wordpress.com/ for the boosttestui home page.
 
 #include "stdafx.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <stdexcept>
+#include <deque>
+#include <vector>
+#ifndef _WIN32
+#include <cstring>
+#include <elf.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BOOST_TESTUI_SSE2
+#include <emmintrin.h>
+#endif
+#include <boost/filesystem.hpp>
 #include <boost/iostreams/device/mapped_file.hpp>
+#pragma warning(push, 3) // conversion from 'int' to 'unsigned short', possible loss of data
+#include <boost/thread.hpp>
+#pragma warning(pop)
 #include "GetUnitTestType.h"
 
 namespace gj {
 
+static const std::string unit_test_type_("unit_test_type_");
+
+#ifdef _WIN32
+
 template <typename T>
 const T* GetPtr(const void* base, ptrdiff_t offset = 0)
 {
@@ -33,8 +55,6 @@ const IMAGE_SECTION_HEADER* GetEnclosingSectionHeader(DWORD rva, const ImageNtHe
 	return nullptr;
 }
 
-static const std::string unit_test_type_("unit_test_type_");
-
 template <typename ImageNtHeaders>
 std::string GetNUnitTestType(const void* base, const ImageNtHeaders* pNTHeader)
 {
@@ -95,33 +115,414 @@ std::string GetUnitTestType(const IMAGE_DOS_HEADER* pDosHeader, size_t size)
 	return "";
 }
 
+#else // !_WIN32
+
+bool IsUnitTestType(const std::string& type)
+{
+	return type == "boost" || type == "boost2" || type == "google" || type == "catch";
+}
+
+// The gui headers export an extern "C" unit_test_type_<type>() marker function,
+// find its name in the executable's symbol string tables.
+std::string GetUnitTestType(const char* begin, const char* end)
+{
+	const char* it = begin;
+	for (;;)
+	{
+		it = std::search(it, end, unit_test_type_.begin(), unit_test_type_.end());
+		if (it == end)
+			return "";
+
+		it += unit_test_type_.size();
+		std::string type(it, std::find(it, end, '\0'));
+		if (IsUnitTestType(type))
+			return type;
+	}
+}
+
+struct Elf32
+{
+	typedef Elf32_Ehdr Ehdr;
+	typedef Elf32_Shdr Shdr;
+	typedef Elf32_Sym Sym;
+	typedef Elf32_Nhdr Nhdr;
+
+	static unsigned char Type(unsigned char info) { return ELF32_ST_TYPE(info); }
+};
+
+struct Elf64
+{
+	typedef Elf64_Ehdr Ehdr;
+	typedef Elf64_Shdr Shdr;
+	typedef Elf64_Sym Sym;
+	typedef Elf64_Nhdr Nhdr;
+
+	static unsigned char Type(unsigned char info) { return ELF64_ST_TYPE(info); }
+};
+
+// Looks for the marker function among the global function symbols of one symbol table.
+// The local symbols come first, sh_info is the index of the first global one.
+template <typename Elf>
+std::string GetUnitTestType(const char* base, std::size_t size, const typename Elf::Shdr& symbols, const typename Elf::Shdr& strings)
+{
+	if (symbols.sh_entsize != sizeof(typename Elf::Sym) ||
+		symbols.sh_offset > size || symbols.sh_size > size - symbols.sh_offset ||
+		strings.sh_offset > size || strings.sh_size > size - strings.sh_offset)
+		return "";
+
+	auto sym = reinterpret_cast<const typename Elf::Sym*>(base + symbols.sh_offset);
+	auto count = symbols.sh_size / sizeof(typename Elf::Sym);
+	const char* names = base + strings.sh_offset;
+	for (auto i = std::min<std::size_t>(symbols.sh_info, count); i < count; ++i)
+	{
+		if (Elf::Type(sym[i].st_info) != STT_FUNC || sym[i].st_name >= strings.sh_size)
+			continue;
+
+		const char* name = names + sym[i].st_name;
+		std::size_t length = strnlen(name, strings.sh_size - sym[i].st_name);
+		if (length <= unit_test_type_.size() || unit_test_type_.compare(0, std::string::npos, name, unit_test_type_.size()) != 0)
+			continue;
+
+		std::string type(name + unit_test_type_.size(), name + length);
+		if (IsUnitTestType(type))
+			return type;
+	}
+	return "";
+}
+
+// Returns the section headers, or nullptr when they are not within the file.
+template <typename Elf>
+const typename Elf::Shdr* GetSections(const char* base, std::size_t size, unsigned& count)
+{
+	if (size < sizeof(typename Elf::Ehdr))
+		return nullptr;
+
+	auto pHeader = reinterpret_cast<const typename Elf::Ehdr*>(base);
+	if (pHeader->e_shentsize != sizeof(typename Elf::Shdr) || pHeader->e_shoff > size ||
+		pHeader->e_shnum > (size - pHeader->e_shoff) / sizeof(typename Elf::Shdr))
+		return nullptr;
+
+	count = pHeader->e_shnum;
+	return reinterpret_cast<const typename Elf::Shdr*>(base + pHeader->e_shoff);
+}
+
+// Reads the section headers to find .dynsym and .symtab, so only the symbol tables
+// are read, not all of a large executable with debug information.
+template <typename Elf>
+std::string GetElfUnitTestType(const char* base, std::size_t size)
+{
+	unsigned count = 0;
+	auto sections = GetSections<Elf>(base, size, count);
+	const unsigned types[] = { SHT_DYNSYM, SHT_SYMTAB };
+	for (auto type = std::begin(types); type != std::end(types); ++type)
+	{
+		for (unsigned i = 0; i < count; ++i)
+		{
+			if (sections[i].sh_type != *type || sections[i].sh_link >= count)
+				continue;
+
+			auto testType = GetUnitTestType<Elf>(base, size, sections[i], sections[sections[i].sh_link]);
+			if (!testType.empty())
+				return testType;
+		}
+	}
+	return "";
+}
+
+// Finds the NT_GNU_BUILD_ID note that the linker writes into .note.gnu.build-id.
+template <typename Elf>
+std::string GetElfBuildId(const char* base, std::size_t size)
+{
+	unsigned count = 0;
+	auto sections = GetSections<Elf>(base, size, count);
+	for (unsigned i = 0; i < count; ++i)
+	{
+		if (sections[i].sh_type != SHT_NOTE || sections[i].sh_offset > size || sections[i].sh_size > size - sections[i].sh_offset)
+			continue;
+
+		const char* p = base + sections[i].sh_offset;
+		const char* end = p + sections[i].sh_size;
+		while (static_cast<std::size_t>(end - p) >= sizeof(typename Elf::Nhdr))
+		{
+			auto pNote = reinterpret_cast<const typename Elf::Nhdr*>(p);
+			std::size_t nameSize = (pNote->n_namesz + 3) & ~3u;
+			std::size_t descSize = (pNote->n_descsz + 3) & ~3u;
+			p += sizeof(typename Elf::Nhdr);
+			if (nameSize + descSize > static_cast<std::size_t>(end - p))
+				break;
+
+			if (pNote->n_type == NT_GNU_BUILD_ID && pNote->n_namesz == 4 && std::memcmp(p, "GNU", 4) == 0)
+				return std::string(p + nameSize, pNote->n_descsz);
+			p += nameSize + descSize;
+		}
+	}
+	return "";
+}
+
+// Returns the ELF class of an ELF file in the byte order of the runner, ELFCLASSNONE for other files.
+unsigned char GetElfClass(const char* base, std::size_t size)
+{
+	if (size < EI_NIDENT || std::memcmp(base, ELFMAG, SELFMAG) != 0)
+		return ELFCLASSNONE;
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	const unsigned char byteOrder = ELFDATA2LSB;
+#else
+	const unsigned char byteOrder = ELFDATA2MSB;
+#endif
+	const unsigned char* ident = reinterpret_cast<const unsigned char*>(base);
+	return ident[EI_DATA] == byteOrder ? ident[EI_CLASS] : ELFCLASSNONE;
+}
+
+// Only an ELF file in the byte order of the runner is read, other files are searched.
+std::string GetUnitTestType(const char* base, std::size_t size)
+{
+	switch (GetElfClass(base, size))
+	{
+	case ELFCLASS32: return GetElfUnitTestType<Elf32>(base, size);
+	case ELFCLASS64: return GetElfUnitTestType<Elf64>(base, size);
+	}
+	return GetUnitTestType(base, base + size);
+}
+
+#endif // _WIN32
+
+const unsigned NoMatch = ~0u;
+
+// Finds any of a set of patterns in one pass over the data with an Aho-Corasick automaton.
+// The patterns are ordered by priority, the first one that is found anywhere wins.
+class MultiPatternSearch
+{
+public:
+	static const std::size_t MaxFirstBytes = 8;
+
+	explicit MultiPatternSearch(const std::vector<std::string>& patterns) :
+		m_next(1),
+		m_match(1, NoMatch),
+		m_maxLength(0)
+	{
+		std::vector<std::array<unsigned, 256>> trie(1);
+		trie[0].fill(0);
+		m_first.fill(false);
+		for (unsigned i = 0; i < patterns.size(); ++i)
+		{
+			if (patterns[i].empty())
+				throw std::invalid_argument("empty search pattern");
+			auto first = static_cast<unsigned char>(patterns[i][0]);
+			if (!m_first[first])
+			{
+				if (m_firstBytes.size() == MaxFirstBytes)
+					throw std::invalid_argument("too many search patterns");
+				m_first[first] = true;
+#ifdef BOOST_TESTUI_SSE2
+				m_firstVectors[m_firstBytes.size()] = _mm_set1_epi8(patterns[i][0]);
+#endif
+				m_firstBytes += patterns[i][0];
+			}
+			unsigned state = 0;
+			for (auto it = patterns[i].begin(); it != patterns[i].end(); ++it)
+			{
+				auto c = static_cast<unsigned char>(*it);
+				if (trie[state][c] == 0)
+				{
+					trie[state][c] = static_cast<unsigned>(trie.size());
+					trie.push_back(std::array<unsigned, 256>());
+					trie.back().fill(0);
+					m_match.push_back(NoMatch);
+				}
+				state = trie[state][c];
+			}
+			m_match[state] = std::min(m_match[state], i);
+			m_maxLength = std::max(m_maxLength, patterns[i].size());
+		}
+
+		// Turn the trie into a state machine, breadth first so the failure state
+		// of a state is complete before it is used:
+		m_next.resize(trie.size());
+		std::vector<unsigned> failure(trie.size(), 0);
+		std::deque<unsigned> queue;
+		for (unsigned c = 0; c < 256; ++c)
+		{
+			m_next[0][c] = trie[0][c];
+			if (trie[0][c] != 0)
+				queue.push_back(trie[0][c]);
+		}
+		while (!queue.empty())
+		{
+			unsigned state = queue.front();
+			queue.pop_front();
+			m_match[state] = std::min(m_match[state], m_match[failure[state]]);
+			for (unsigned c = 0; c < 256; ++c)
+			{
+				unsigned next = trie[state][c];
+				if (next == 0)
+				{
+					m_next[state][c] = m_next[failure[state]][c];
+					continue;
+				}
+				failure[next] = m_next[failure[state]][c];
+				m_next[state][c] = next;
+				queue.push_back(next);
+			}
+		}
+	}
+
+	std::size_t MaxLength() const
+	{
+		return m_maxLength;
+	}
+
+	// Lowers best to the index of a pattern in [begin, end) when it is lower. Stops when
+	// best drops to 0, also when another thread found the first pattern.
+	void Search(const char* begin, const char* end, std::atomic<unsigned>& best) const
+	{
+		const std::size_t blockSize = 1 << 20;
+		unsigned state = 0;
+		if (m_firstBytes.empty())
+			return;
+
+		while (begin != end)
+		{
+			unsigned limit = best;
+			if (limit == 0)
+				return;
+
+			const char* blockEnd = begin + std::min<std::size_t>(blockSize, end - begin);
+			for (; begin != blockEnd; ++begin)
+			{
+				// Most of the data does not even start a pattern:
+				if (state == 0)
+				{
+					begin = FindFirstByte(begin, blockEnd);
+					if (begin == blockEnd)
+						break;
+				}
+				state = m_next[state][static_cast<unsigned char>(*begin)];
+				if (m_match[state] >= limit)
+					continue;
+
+				limit = m_match[state];
+				unsigned current = best;
+				while (limit < current && !best.compare_exchange_weak(current, limit))
+				{
+				}
+				if (limit == 0)
+					return;
+			}
+		}
+	}
+
+private:
+	// Skips to the next byte that starts a pattern. With SSE2, 16 bytes at a time are
+	// compared to these bytes, much faster than running the state machine on all data.
+	const char* FindFirstByte(const char* begin, const char* end) const
+	{
+#ifdef BOOST_TESTUI_SSE2
+		for (; end - begin >= 16; begin += 16)
+		{
+			__m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+			__m128i found = _mm_cmpeq_epi8(data, m_firstVectors[0]);
+			for (std::size_t i = 1; i < m_firstBytes.size(); ++i)
+				found = _mm_or_si128(found, _mm_cmpeq_epi8(data, m_firstVectors[i]));
+			if (_mm_movemask_epi8(found) != 0)
+				break;
+		}
+#endif
+		while (begin != end && !m_first[static_cast<unsigned char>(*begin)])
+			++begin;
+		return begin;
+	}
+
+	std::vector<std::array<unsigned, 256>> m_next;
+	std::vector<unsigned> m_match;
+	std::string m_firstBytes;
+	std::array<bool, 256> m_first;
+#ifdef BOOST_TESTUI_SSE2
+	__m128i m_firstVectors[MaxFirstBytes];
+#endif
+	std::size_t m_maxLength;
+};
+
+// Returns the index of the first of the patterns that occurs in the data, or the number
+// of patterns. Large files are split in chunks that are searched in parallel, the chunks
+// overlap so a pattern that crosses a chunk boundary is still found.
+unsigned FindFirstPattern(const char* begin, const char* end, const std::vector<std::string>& patterns)
+{
+	MultiPatternSearch search(patterns);
+	std::atomic<unsigned> best(static_cast<unsigned>(patterns.size()));
+
+	const std::size_t minChunkSize = 32 << 20;
+	std::size_t size = end - begin;
+	std::size_t chunks = std::min<std::size_t>(std::max(1u, boost::thread::hardware_concurrency()), size / minChunkSize);
+	if (chunks <= 1)
+	{
+		search.Search(begin, end, best);
+		return best;
+	}
+
+	std::size_t chunkSize = size / chunks;
+	boost::thread_group threads;
+	for (std::size_t i = 0; i < chunks; ++i)
+	{
+		const char* chunkBegin = begin + i * chunkSize;
+		const char* chunkEnd = i + 1 == chunks ? end : chunkBegin + chunkSize + search.MaxLength() - 1;
+		threads.create_thread([&search, &best, chunkBegin, chunkEnd]() { search.Search(chunkBegin, chunkEnd, best); });
+	}
+	threads.join_all();
+	return best;
+}
+
 std::string GetUnitTestType(const std::string& path)
 {
+	// An empty file cannot be mapped, nor is it a unit test.
+	if (boost::filesystem::file_size(path) == 0)
+		return "";
+
 	boost::iostreams::mapped_file_source file(path);
 
+#ifdef _WIN32
 	auto pDosHeader = GetPtr<IMAGE_DOS_HEADER>(file.data());
 	if (pDosHeader->e_magic != IMAGE_DOS_SIGNATURE)
 		return "";
 
 	auto testType = GetUnitTestType(pDosHeader, file.size());
+#else
+	auto testType = GetUnitTestType(file.data(), file.size());
+#endif
 	if (!testType.empty())
 		return testType;
 
 	// do a strings like search to try and identify boost or google test executables without our header.
 	// Build magic string at run time to not identify our own executable as a boost or google test :-)
-	std::string BOOST_TESTS_TO_RUN("BOOST_"); BOOST_TESTS_TO_RUN.append("TESTS_TO_RUN");
-	if (std::search(file.begin(), file.end(), BOOST_TESTS_TO_RUN.begin(), BOOST_TESTS_TO_RUN.end()) != file.end())
-		return "boost/noheader";
+	std::vector<std::string> patterns;
+	patterns.push_back(std::string("BOOST_") + "TESTS_TO_RUN");
+	patterns.push_back(std::string("Catch::") + "Session");
+	patterns.push_back(std::string("GTEST_") + "COLOR");
+	static const char* const types[] = { "boost/noheader", "catch/noheader", "google/noheader", "" };
+
+	return types[FindFirstPattern(file.data(), file.data() + file.size(), patterns)];
+}
 
-	std::string CatchSession("Catch::"); CatchSession.append("Session");
-	if (std::search(file.begin(), file.end(), CatchSession.begin(), CatchSession.end()) != file.end())
-		return "catch/noheader";
+#ifdef _WIN32
+
+std::string GetBuildId(const std::string& /*path*/)
+{
+	return "";
+}
 
-	std::string GTEST_COLOR("GTEST_"); GTEST_COLOR.append("COLOR");
-	if (std::search(file.begin(), file.end(), GTEST_COLOR.begin(), GTEST_COLOR.end()) != file.end())
-		return "google/noheader";
+#else // !_WIN32
 
+std::string GetBuildId(const std::string& path)
+{
+	boost::iostreams::mapped_file_source file(path);
+	switch (GetElfClass(file.data(), file.size()))
+	{
+	case ELFCLASS32: return GetElfBuildId<Elf32>(file.data(), file.size());
+	case ELFCLASS64: return GetElfBuildId<Elf64>(file.data(), file.size());
+	}
 	return "";
 }
 
+#endif // _WIN32
+
 } // namespace gj
@@ -16,6 +16,9 @@ namespace gj {
 
 std::string GetUnitTestType(const std::string& path);
 
+// Returns the GNU build id of an ELF file, empty when it has none.
+std::string GetBuildId(const std::string& path);
+
 } // namespace gj
 
 #endif // BOOST_TESTUI_GETUNITTESTTYPE_H
@@ -83,6 +83,14 @@ ArgumentBuilder::ArgumentBuilder(const std::wstring& fileName, ExeRunner& runner
 {
 }
 
+std::unique_ptr<gj::ArgumentBuilder> ArgumentBuilder::Clone(ExeRunner& runner, TestObserver& observer) const
+{
+	auto p = new ArgumentBuilder(*this);
+	p->m_pRunner = &runner;
+	p->m_pObserver = &observer;
+	return std::unique_ptr<gj::ArgumentBuilder>(p);
+}
+
 std::wstring ArgumentBuilder::GetExePathName()
 {
 	return m_fileName;
@@ -128,9 +136,26 @@ void ArgumentBuilder::LoadTestUnits(TestUnitNode& tree, std::istream& is, const
 	}
 }
 
+void ArgumentBuilder::LoadCachedTestUnits(const TestUnitNode& tree)
+{
+	const TestUnitNode& node = tree.children.front();
+	m_rootId = node.data.id;
+	m_ids[node.data.name] = node.data.id;
+	for (auto suite = node.children.begin(); suite != node.children.end(); ++suite)
+	{
+		m_ids[suite->data.name] = suite->data.id;
+		for (auto test = suite->children.begin(); test != suite->children.end(); ++test)
+			m_ids[FullName(suite->data.name, test->data.name)] = test->data.id;
+	}
+}
+
 unsigned ArgumentBuilder::GetEnabledOptions(unsigned /*options*/) const
 {
+#ifdef _WIN32
 	return ExeRunner::Randomize | ExeRunner::WaitForDebugger;
+#else // !_WIN32
+	return ExeRunner::Randomize | ExeRunner::WaitForDebugger | ExeRunner::Isolate;
+#endif // _WIN32
 }
 
 std::wstring ArgumentBuilder::BuildArgs(TestRunner& runner, int /*logLevel*/, unsigned& options)
@@ -144,6 +169,9 @@ std::wstring ArgumentBuilder::BuildArgs(TestRunner& runner, int /*logLevel*/, un
 	if (options & ExeRunner::WaitForDebugger)
 		args << L" --gui_wait";
 
+	if (options & ExeRunner::Isolate)
+		args << L" --gui_isolate";
+
 	GetEnableArg getArg;
 	runner.TraverseTestTree(getArg);
 	if (!getArg.AllCases())
@@ -152,6 +180,42 @@ std::wstring ArgumentBuilder::BuildArgs(TestRunner& runner, int /*logLevel*/, un
 	return args.str();
 }
 
+bool ArgumentBuilder::GetShardEnvironment(unsigned shard, unsigned shardCount, std::map<std::wstring, std::wstring>& environment) const
+{
+	environment[L"GTEST_SHARD_INDEX"] = (wstringbuilder() << shard).str();
+	environment[L"GTEST_TOTAL_SHARDS"] = (wstringbuilder() << shardCount).str();
+	return true;
+}
+
+bool ArgumentBuilder::BuildWorkerArgs(int /*logLevel*/, unsigned options, std::wstring& args)
+{
+	args = L"--gtest_also_run_disabled_tests";
+	if (options & ExeRunner::Randomize)
+		args += L" --gtest_shuffle";
+	if (options & ExeRunner::Isolate)
+		args += L" --gui_isolate";
+	args += L" --gui_worker";
+	return true;
+}
+
+bool ArgumentBuilder::GetRepeatArg(unsigned iterations, std::wstring& arg) const
+{
+	arg = L"--gui_repeat=" + std::to_wstring(iterations);
+	return true;
+}
+
+std::string ArgumentBuilder::GetWorkerBatch(const std::vector<unsigned>& ids)
+{
+	std::string batch;
+	for (auto it = ids.begin(); it != ids.end(); ++it)
+	{
+		// Strip the root suite, the executable name, from the full name:
+		const std::string& fullName = m_pRunner->GetTestUnit(*it).fullName;
+		batch += fullName.substr(m_pRunner->RootTestSuite().fullName.size() + 1) + '\n';
+	}
+	return batch + '\n';
+}
+
 template <typename T>
 T get_arg(const std::string& s)
 {
@@ -173,61 +237,84 @@ unsigned ArgumentBuilder::GetId(const std::string& name)
 	return id;
 }
 
-void ArgumentBuilder::FilterMessage(const std::string& msg)
+void ArgumentBuilder::FilterMessage(std::string_view msg)
 {
 	static const std::regex reWaiting("^#waiting");
-	static const std::regex reStart("^\\[==========\\] Running (\\d+) tests? from \\d+ test cases?.");
+	static const std::regex reAborted("^#unit_aborted ([\\w\\._/]+)");
+	static const std::regex reStart("^\\[==========\\] Running (\\d+) tests? from \\d+ test (?:case|suite)s?.");
 	static const std::regex reTest("^\\[----------\\] \\d+ tests? from ([\\w_/]+)( \\((\\d+) ms total\\))?");
 	static const std::regex reBegin("^\\[ RUN      \\] ([\\w\\._/]+)");
-	static const std::regex reError("\\(\\d+\\): error: ");
 //	static const std::regex reEnd("^\\[(       OK )|(  FAILED  )\\] ([\\w\\._/]+) \\((\\d+) ms\\)"); // VC regex bug??
 	static const std::regex reEnd("^\\[(       OK |  FAILED  )\\] ([\\w\\._/]+).*\\((\\d+) ms\\)");
-	static const std::regex reFinish("^\\[==========\\] \\d+ tests? from \\d+ test cases? ran. \\((\\d+) ms total\\)");
-	static const std::regex reAssertion("Assertion failed:");
-
-	Severity::type severity = Severity::Info;
-	std::smatch sm;
-	if (std::regex_search(msg, sm, reWaiting))
+	static const std::regex reFinish("^\\[==========\\] \\d+ tests? from \\d+ test (?:case|suite)s? ran. \\((\\d+) ms total\\)");
+
+	// The patterns match at the start of the line only, don't let std::regex try every position.
+	const char* begin = msg.data();
+	const char* end = begin + msg.size();
+	const auto start = std::regex_constants::match_continuous;
+	Severity::type severity = GetSeverity(msg);
+	std::cmatch sm;
+	if (std::regex_search(begin, end, sm, reWaiting, start))
 		return m_pRunner->OnWaiting();
-	else if (std::regex_search(msg, sm, reStart))
+	else if (std::regex_search(begin, end, sm, reAborted, start))
+		return m_pRunner->OnTestUnitAborted(GetId(sm[1]));
+	else if (std::regex_search(begin, end, sm, reStart, start))
 	{
 		m_pRunner->OnTestIterationStart(get_arg<unsigned>(sm[1]));
 		m_pRunner->OnTestSuiteStart(m_rootId);
 	}
-	else if (std::regex_search(msg, sm, reTest) && !sm[2].matched)
+	else if (std::regex_search(begin, end, sm, reTest, start) && !sm[2].matched)
 	{
 		m_pRunner->OnTestSuiteStart(GetId(sm[1]));
 	}
-	else if (std::regex_search(msg, sm, reBegin))
+	else if (std::regex_search(begin, end, sm, reBegin, start))
 	{
 		m_pRunner->OnTestCaseStart(GetId(sm[1]));
 	}
-	else if (std::regex_search(msg, reError))
+	else if (severity == Severity::Error)
 	{
-		severity = Severity::Error;
 		m_pRunner->OnTestAssertion(false);
 	}
-	else if (std::regex_search(msg, reAssertion))
-	{
-		severity = Severity::Assertion;
-	}
 
 	m_pObserver->test_message(severity, msg);
 
-	if (std::regex_search(msg, sm, reEnd))
+	if (std::regex_search(begin, end, sm, reEnd, start))
 	{
 		m_pRunner->OnTestCaseFinish(GetId(sm[2]), get_arg<unsigned>(sm[3]), sm[1].str().find("OK") != std::string::npos ? TestCaseState::Success : TestCaseState::Failed);
 	}
-	else if (std::regex_search(msg, sm, reTest) && sm[2].matched)
+	else if (std::regex_search(begin, end, sm, reTest, start) && sm[2].matched)
 	{
 		m_pRunner->OnTestSuiteFinish(GetId(sm[1]), get_arg<unsigned>(sm[3]));
 	}
-	else if (std::regex_search(msg, sm, reFinish))
+	else if (std::regex_search(begin, end, sm, reFinish, start))
 	{
 		m_pRunner->OnTestSuiteFinish(m_rootId, get_arg<unsigned>(sm[1]));
 		m_pRunner->OnTestIterationFinish();
 	}
 }
 
+Severity::type ArgumentBuilder::GetSeverity(std::string_view msg) const
+{
+	static const std::regex reError("\\(\\d+\\): error: ");
+
+	// Every line of test output passes here, std::regex only runs on the candidates.
+	if (msg.find("): error: ") != std::string_view::npos && std::regex_search(msg.data(), msg.data() + msg.size(), reError))
+		return Severity::Error;
+	if (msg.find("Assertion failed:") != std::string_view::npos)
+		return Severity::Assertion;
+	return Severity::Info;
+}
+
+bool ArgumentBuilder::HasEventChannel() const
+{
+	return true;
+}
+
+// The events name the test units, the root suite has no name.
+unsigned ArgumentBuilder::GetEventUnitId(const ClientEvent& event)
+{
+	return event.text.empty() ? m_rootId : GetId(event.text);
+}
+
 } // namespace GoogleTest
 } // namespace gj
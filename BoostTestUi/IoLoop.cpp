@@ -0,0 +1,160 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#include "stdafx.h"
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <cerrno>
+#include "Utilities.h"
+#include "IoLoop.h"
+
+namespace gj {
+
+namespace {
+
+// The time between the exit checks of processes that have no pidfd, in milliseconds.
+const int PollInterval = 50;
+
+// Returns -1 when the kernel has no pidfd_open(), Linux 5.3 added it.
+int OpenPidFd(ProcessHandle process)
+{
+#ifdef SYS_pidfd_open
+	return static_cast<int>(syscall(SYS_pidfd_open, process, 0));
+#else
+	(void)process;
+	return -1;
+#endif
+}
+
+} // namespace
+
+IoLoop::IoLoop() :
+	m_epoll(epoll_create1(EPOLL_CLOEXEC)),
+	m_serial(0)
+{
+	if (m_epoll < 0)
+		ThrowLastError("epoll_create1");
+}
+
+IoLoop::~IoLoop()
+{
+	for (auto it = m_sources.begin(); it != m_sources.end(); ++it)
+	{
+		if (it->second.process)
+			close(it->first);
+	}
+}
+
+void IoLoop::AddReader(FileHandle handle, const Handler& onReadable)
+{
+	Add(handle, false, onReadable);
+}
+
+void IoLoop::Remove(FileHandle handle)
+{
+	auto it = m_sources.find(handle);
+	if (it != m_sources.end() && !it->second.process)
+		Erase(handle);
+}
+
+void IoLoop::AddProcess(ProcessHandle process, const Handler& onExit)
+{
+	int fd = OpenPidFd(process);
+	if (fd < 0)
+	{
+		m_polled.push_back(std::make_pair(process, onExit));
+		return;
+	}
+
+	try
+	{
+		Add(fd, true, onExit);
+	}
+	catch (...)
+	{
+		close(fd);
+		throw;
+	}
+}
+
+// The serial in the event data tells a stale event of a removed source
+// from an event of a new source that got the same file descriptor.
+void IoLoop::Add(int fd, bool process, const Handler& handler)
+{
+	std::uint32_t serial = ++m_serial;
+	epoll_event event = {};
+	event.events = EPOLLIN;
+	event.data.u64 = (static_cast<std::uint64_t>(serial) << 32) | static_cast<std::uint32_t>(fd);
+	if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) < 0)
+		ThrowLastError("epoll_ctl");
+
+	Source& source = m_sources[fd];
+	source.serial = serial;
+	source.process = process;
+	source.handler = handler;
+}
+
+void IoLoop::Erase(int fd)
+{
+	epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+	if (m_sources[fd].process)
+		close(fd);
+	m_sources.erase(fd);
+}
+
+// WNOWAIT leaves the process to be reaped by its handler. A process that cannot
+// be waited for is taken as exited, so the loop does not wait for it forever.
+void IoLoop::PollProcesses()
+{
+	for (std::size_t i = 0; i < m_polled.size(); )
+	{
+		siginfo_t info = {};
+		if (waitid(P_PID, m_polled[i].first, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == 0)
+		{
+			++i;
+			continue;
+		}
+
+		Handler handler = m_polled[i].second;
+		m_polled.erase(m_polled.begin() + i);
+		handler();
+	}
+}
+
+void IoLoop::Run()
+{
+	epoll_event events[64];
+	while (!m_sources.empty() || !m_polled.empty())
+	{
+		int count = epoll_wait(m_epoll, events, sizeof(events) / sizeof(events[0]), m_polled.empty() ? -1 : PollInterval);
+		if (count < 0)
+		{
+			if (errno != EINTR)
+				ThrowLastError("epoll_wait");
+			count = 0;
+		}
+
+		for (int i = 0; i < count; ++i)
+		{
+			int fd = static_cast<int>(events[i].data.u64 & 0xffffffff);
+			auto it = m_sources.find(fd);
+			if (it == m_sources.end() || it->second.serial != static_cast<std::uint32_t>(events[i].data.u64 >> 32))
+				continue;
+
+			// The handler stays valid when it removes its own source.
+			Handler handler = it->second.handler;
+			if (it->second.process)
+				Erase(fd);
+			handler();
+		}
+		PollProcesses();
+	}
+}
+
+} // namespace gj
@@ -0,0 +1,64 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#ifndef BOOST_TESTUI_IOLOOP_H
+#define BOOST_TESTUI_IOLOOP_H
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <vector>
+#include <boost/noncopyable.hpp>
+#include "Process.h"
+
+namespace gj {
+
+// Waits on one epoll set for the pipes and the exit of any number of test processes
+// and calls the handler of each one that is ready, all on the thread that calls Run().
+// A process exit is watched with a pidfd, without it the process is polled.
+// Handlers may add and remove sources, also their own.
+class IoLoop : boost::noncopyable
+{
+public:
+	typedef std::function<void ()> Handler;
+
+	IoLoop();
+	~IoLoop();
+
+	// Calls onReadable each time handle has data or is closed, until it is removed.
+	void AddReader(FileHandle handle, const Handler& onReadable);
+	void Remove(FileHandle handle);
+
+	// Calls onExit once when the process has terminated, it is not reaped yet.
+	void AddProcess(ProcessHandle process, const Handler& onExit);
+
+	// Runs until no readers and processes are left.
+	void Run();
+
+private:
+	struct Source
+	{
+		std::uint32_t serial;
+		bool process;
+		Handler handler;
+	};
+
+	void Add(int fd, bool process, const Handler& handler);
+	void Erase(int fd);
+	void PollProcesses();
+
+	FileDescriptor m_epoll;
+	std::uint32_t m_serial;
+	std::map<int, Source> m_sources;
+	std::vector<std::pair<ProcessHandle, Handler>> m_polled;
+};
+
+} // namespace gj
+
+#endif // BOOST_TESTUI_IOLOOP_H
@@ -0,0 +1,85 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#include "stdafx.h"
+#include <algorithm>
+#include <cstring>
+#include "LineReader.h"
+
+namespace gj {
+
+LineReader::LineReader(FileHandle handle, std::size_t bufferSize) :
+	m_handle(handle),
+	m_buffer(std::max<std::size_t>(bufferSize, 1)),
+	m_begin(0),
+	m_end(0),
+	m_eof(false)
+{
+}
+
+bool LineReader::GetLine(std::string_view& line)
+{
+	while (!NextLine(line))
+	{
+		if (!Read())
+			return NextLine(line);
+	}
+	return true;
+}
+
+// Moves the remaining partial line to the front of the buffer and reads after it.
+// The buffer only grows for a line that does not fit.
+bool LineReader::Read()
+{
+	if (m_eof)
+		return false;
+
+	if (m_begin > 0)
+	{
+		std::memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+		m_end -= m_begin;
+		m_begin = 0;
+	}
+	if (m_end == m_buffer.size())
+		m_buffer.resize(2 * m_buffer.size());
+
+	std::size_t read;
+	if (!ReadHandle(m_handle, m_buffer.data() + m_end, m_buffer.size() - m_end, read) || read == 0)
+	{
+		m_eof = true;
+		return false;
+	}
+	m_end += read;
+	return true;
+}
+
+// Like Chomp(), a line ends before its trailing control characters.
+bool LineReader::NextLine(std::string_view& line)
+{
+	const char* begin = m_buffer.data() + m_begin;
+	auto end = static_cast<const char*>(std::memchr(begin, '\n', m_end - m_begin));
+	if (end)
+	{
+		m_begin = end + 1 - m_buffer.data();
+	}
+	else if (m_eof && m_begin < m_end)
+	{
+		end = m_buffer.data() + m_end;
+		m_begin = m_end;
+	}
+	else
+	{
+		return false;
+	}
+
+	while (end > begin && static_cast<unsigned char>(end[-1]) < ' ')
+		--end;
+	line = std::string_view(begin, end - begin);
+	return true;
+}
+
+} // namespace gj
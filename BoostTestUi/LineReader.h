@@ -0,0 +1,51 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#ifndef BOOST_TESTUI_LINEREADER_H
+#define BOOST_TESTUI_LINEREADER_H
+
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+#include "hstream.h"
+
+namespace gj {
+
+// Splits the output of a test process into lines. It reads the pipe in large
+// chunks and returns the lines as views into its buffer, without the line end.
+// A line is valid until the next Read() or GetLine().
+class LineReader
+{
+public:
+	static const std::size_t DefaultBufferSize = 64 * 1024;
+
+	explicit LineReader(FileHandle handle, std::size_t bufferSize = DefaultBufferSize);
+
+	// Reads the next line, waits for more output when it is not complete.
+	// Returns false at the end of the output.
+	bool GetLine(std::string_view& line);
+
+	// Reads once from the pipe, returns false at the end of the output.
+	bool Read();
+
+	// Returns the next complete line that was read. At the end of
+	// the output this includes an unterminated last line.
+	bool NextLine(std::string_view& line);
+
+private:
+	FileHandle m_handle;
+	std::vector<char> m_buffer;
+	std::size_t m_begin;
+	std::size_t m_end;
+	bool m_eof;
+};
+
+} // namespace gj
+
+#endif // BOOST_TESTUI_LINEREADER_H
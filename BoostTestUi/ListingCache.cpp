@@ -0,0 +1,351 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#include "stdafx.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iterator>
+#include <sstream>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#pragma warning(push, 3) // conversion from 'int' to 'unsigned short', possible loss of data
+#include <boost/thread.hpp>
+#pragma warning(pop)
+#include "Utilities.h"
+#include "GetUnitTestType.h"
+#include "ListingCache.h"
+
+namespace gj {
+
+namespace fs = boost::filesystem;
+
+// Changes with the format. The byte order mark keeps a cache on a shared
+// home directory from being read by a machine of the other byte order.
+static const char CacheHeader[] = "BoostTestUi test tree 2";
+static const std::uint32_t ByteOrderMark = 0x01020304;
+
+// FNV-1a over 64 bit words.
+std::uint64_t Hash(const char* p, std::size_t size)
+{
+	const std::uint64_t prime = 1099511628211ull;
+	std::uint64_t hash = 14695981039346656037ull;
+	std::size_t words = size / sizeof(std::uint64_t);
+	for (std::size_t i = 0; i < words; ++i)
+	{
+		std::uint64_t word;
+		std::memcpy(&word, p + i * sizeof(word), sizeof(word));
+		hash = (hash ^ word) * prime;
+	}
+	for (std::size_t i = words * sizeof(std::uint64_t); i < size; ++i)
+		hash = (hash ^ static_cast<unsigned char>(p[i])) * prime;
+	return hash;
+}
+
+std::uint64_t Hash(const std::string& s)
+{
+	return Hash(s.data(), s.size());
+}
+
+void Put(std::string& data, std::uint64_t value)
+{
+	data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void Put(std::string& data, std::uint32_t value)
+{
+	data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+void Put(std::string& data, const std::string& s)
+{
+	Put(data, static_cast<std::uint32_t>(s.size()));
+	data += s;
+}
+
+void PutNodes(std::string& data, const std::vector<TestUnitNode>& nodes);
+
+void PutNode(std::string& data, const TestUnitNode& node)
+{
+	Put(data, static_cast<std::uint32_t>(node.data.id));
+	data += static_cast<char>(node.data.type);
+	data += static_cast<char>(node.data.enabled ? 1 : 0);
+	Put(data, node.data.name);
+	Put(data, static_cast<std::uint32_t>(node.data.categories.size()));
+	for (auto it = node.data.categories.begin(); it != node.data.categories.end(); ++it)
+		Put(data, *it);
+	PutNodes(data, node.children);
+}
+
+void PutNodes(std::string& data, const std::vector<TestUnitNode>& nodes)
+{
+	Put(data, static_cast<std::uint32_t>(nodes.size()));
+	for (auto it = nodes.begin(); it != nodes.end(); ++it)
+		PutNode(data, *it);
+}
+
+// Reads what Put() wrote. A truncated or damaged entry makes the reader fail
+// instead of reading past the end.
+class CacheReader
+{
+public:
+	CacheReader(const std::string& data, std::size_t pos) :
+		m_data(&data),
+		m_pos(pos),
+		m_ok(true)
+	{
+	}
+
+	bool Ok() const
+	{
+		return m_ok;
+	}
+
+	bool AtEnd() const
+	{
+		return m_ok && m_pos == m_data->size();
+	}
+
+	std::size_t Remaining() const
+	{
+		return m_data->size() - m_pos;
+	}
+
+	std::uint64_t GetUInt64()
+	{
+		std::uint64_t value = 0;
+		if (Check(sizeof(value)))
+			std::memcpy(&value, m_data->data() + m_pos, sizeof(value));
+		m_pos += m_ok ? sizeof(value) : 0;
+		return value;
+	}
+
+	std::uint32_t GetUInt32()
+	{
+		std::uint32_t value = 0;
+		if (Check(sizeof(value)))
+			std::memcpy(&value, m_data->data() + m_pos, sizeof(value));
+		m_pos += m_ok ? sizeof(value) : 0;
+		return value;
+	}
+
+	char GetChar()
+	{
+		return Check(1) ? (*m_data)[m_pos++] : 0;
+	}
+
+	std::string GetString()
+	{
+		std::uint32_t size = GetUInt32();
+		if (!Check(size))
+			return std::string();
+		m_pos += size;
+		return m_data->substr(m_pos - size, size);
+	}
+
+private:
+	bool Check(std::size_t size)
+	{
+		if (size > Remaining())
+			m_ok = false;
+		return m_ok;
+	}
+
+	const std::string* m_data;
+	std::size_t m_pos;
+	bool m_ok;
+};
+
+void GetNodes(CacheReader& reader, std::vector<TestUnitNode>& nodes)
+{
+	std::uint32_t count = reader.GetUInt32();
+	// Each node takes more than one byte, a larger count is damage.
+	if (count > reader.Remaining())
+		count = 0;
+	nodes.reserve(count);
+	for (std::uint32_t i = 0; i < count && reader.Ok(); ++i)
+	{
+		unsigned id = reader.GetUInt32();
+		auto type = reader.GetChar() == TestUnit::TestCase ? TestUnit::TestCase : TestUnit::TestSuite;
+		bool enabled = reader.GetChar() != 0;
+		std::string name = reader.GetString();
+		nodes.push_back(TestUnitNode(TestUnit(id, type, name, enabled)));
+
+		std::uint32_t categories = reader.GetUInt32();
+		for (std::uint32_t j = 0; j < categories && reader.Ok(); ++j)
+			nodes.back().data.categories.push_back(reader.GetString());
+		GetNodes(reader, nodes.back().children);
+	}
+}
+
+std::wstring GetEnvironmentDirectory(const char* name)
+{
+	const char* value = std::getenv(name);
+	return value && *value ? MultiByteToWideChar(value) : std::wstring();
+}
+
+std::wstring ListingCache::GetDefaultDirectory()
+{
+#ifdef _WIN32
+	std::wstring base = GetEnvironmentDirectory("LOCALAPPDATA");
+#else // !_WIN32
+	std::wstring base = GetEnvironmentDirectory("XDG_CACHE_HOME");
+	if (base.empty() && !GetEnvironmentDirectory("HOME").empty())
+		base = (fs::path(GetEnvironmentDirectory("HOME")) / ".cache").wstring();
+#endif
+	return base.empty() ? base : (fs::path(base) / "BoostTestUi").wstring();
+}
+
+boost::mutex g_cacheDirectoryMutex;
+
+std::wstring& CacheDirectory()
+{
+	static std::wstring directory = ListingCache::GetDefaultDirectory();
+	return directory;
+}
+
+std::wstring ListingCache::GetDirectory()
+{
+	boost::mutex::scoped_lock lock(g_cacheDirectoryMutex);
+	return CacheDirectory();
+}
+
+void ListingCache::SetDirectory(const std::wstring& directory)
+{
+	boost::mutex::scoped_lock lock(g_cacheDirectoryMutex);
+	CacheDirectory() = directory;
+}
+
+// A file that cannot be identified is not cached.
+ListingCache::ListingCache(const std::wstring& fileName, const std::wstring& listCommand) :
+	m_size(0),
+	m_time(0)
+{
+	std::wstring directory = GetDirectory();
+	if (directory.empty())
+		return;
+
+	try
+	{
+		fs::path path = fs::system_complete(fileName);
+		m_pathName = WideCharToMultiByte(path.wstring());
+		m_size = fs::file_size(path);
+		m_time = fs::last_write_time(path);
+
+		std::string key(CacheHeader, sizeof(CacheHeader));
+		Put(key, ByteOrderMark);
+		Put(key, m_pathName);
+		Put(key, WideCharToMultiByte(listCommand));
+
+		std::ostringstream name;
+		name << std::hex << std::setfill('0') << std::setw(16) << Hash(m_pathName) << ".tree";
+		m_cacheFileName = (fs::path(directory) / name.str()).wstring();
+		m_key = key;
+	}
+	catch (std::exception&)
+	{
+	}
+}
+
+// A build id changes with every link that changes the executable, without
+// one the contents are hashed. It is only read when the time stamp changed.
+const std::string& ListingCache::GetIdentity() const
+{
+	if (m_identity.empty())
+	{
+		std::string identity = GetBuildId(m_pathName);
+		if (identity.empty())
+		{
+			boost::iostreams::mapped_file_source file(m_pathName);
+			identity = "hash:";
+			Put(identity, Hash(file.data(), file.size()));
+		}
+		m_identity = identity;
+	}
+	return m_identity;
+}
+
+// An entry of a file that was touched or copied but did not change is stored
+// again with the new size and time stamp, so the file is not read next time.
+bool ListingCache::Load(TestUnitNode& tree) const
+try
+{
+	if (m_key.empty())
+		return false;
+
+	fs::ifstream file(fs::path(m_cacheFileName), std::ios::binary);
+	std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (data.size() < m_key.size() || data.compare(0, m_key.size(), m_key) != 0)
+		return false;
+
+	CacheReader reader(data, m_key.size());
+	std::uint64_t size = reader.GetUInt64();
+	std::uint64_t time = reader.GetUInt64();
+	std::string identity = reader.GetString();
+	std::vector<TestUnitNode> nodes;
+	GetNodes(reader, nodes);
+	if (!reader.AtEnd() || nodes.empty())
+		return false;
+
+	bool changed = size != m_size || time != m_time;
+	if (changed && identity != GetIdentity())
+		return false;
+
+	tree.children.swap(nodes);
+	if (changed)
+		Store(tree);
+	return true;
+}
+catch (std::exception&)
+{
+	return false;
+}
+
+// The entry is written to a temporary file and renamed, so a concurrent Load()
+// in another process reads either the old or the new entry.
+void ListingCache::Store(const TestUnitNode& tree) const
+{
+	if (m_key.empty())
+		return;
+
+	fs::path tempName;
+	try
+	{
+		// The file must not have changed since its size and time stamp were read,
+		// or the entry would pair them with the identity of the new file.
+		std::string identity = GetIdentity();
+		fs::path path(m_pathName);
+		if (fs::file_size(path) != m_size || static_cast<std::uint64_t>(fs::last_write_time(path)) != m_time)
+			return;
+
+		std::string data(m_key);
+		Put(data, m_size);
+		Put(data, m_time);
+		Put(data, identity);
+		PutNodes(data, tree.children);
+
+		fs::path fileName(m_cacheFileName);
+		fs::create_directories(fileName.parent_path());
+		tempName = fileName.parent_path() / fs::unique_path("%%%%%%%%%%%%%%%%.tmp");
+		{
+			fs::ofstream file(tempName, std::ios::binary);
+			if (!file.write(data.data(), data.size()) || !file.flush())
+				throw std::runtime_error("Cannot write " + tempName.string());
+		}
+		fs::rename(tempName, fileName);
+	}
+	catch (std::exception&)
+	{
+		boost::system::error_code ec;
+		if (!tempName.empty())
+			fs::remove(tempName, ec);
+	}
+}
+
+} // namespace gj
@@ -0,0 +1,54 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#ifndef BOOST_TESTUI_LISTINGCACHE_H
+#define BOOST_TESTUI_LISTINGCACHE_H
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include "TestRunner.h"
+
+namespace gj {
+
+// Keeps the test trees of unit test executables on disk, so an executable that
+// did not change is not started to list its test units again. The gui and
+// BoostTestCmd share the cache directory.
+// An entry is keyed by the path and the list command. It is valid when the file
+// size and time stamp match, or else when the ELF build id, or when there is none,
+// a hash of the file contents matches: only a changed file is read.
+class ListingCache
+{
+public:
+	// %LOCALAPPDATA%\BoostTestUi, or $XDG_CACHE_HOME/BoostTestUi or ~/.cache/BoostTestUi on POSIX.
+	static std::wstring GetDefaultDirectory();
+	static std::wstring GetDirectory();
+	// An empty directory disables the cache.
+	static void SetDirectory(const std::wstring& directory);
+
+	ListingCache(const std::wstring& fileName, const std::wstring& listCommand);
+
+	// Returns false when there is no valid entry for the file.
+	bool Load(TestUnitNode& tree) const;
+	// The cache is best effort, errors are ignored.
+	void Store(const TestUnitNode& tree) const;
+
+private:
+	const std::string& GetIdentity() const;
+
+	std::wstring m_cacheFileName;
+	std::string m_pathName;
+	std::string m_key;
+	std::uint64_t m_size;
+	std::uint64_t m_time;
+	mutable std::string m_identity;
+};
+
+} // namespace gj
+
+#endif // BOOST_TESTUI_LISTINGCACHE_H
@@ -0,0 +1,89 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#include "stdafx.h"
+#include <cstring>
+#include "LogArena.h"
+
+namespace gj {
+
+LogText::LogText() :
+	m_data(""),
+	m_size(0)
+{
+}
+
+LogText::LogText(const char* text) :
+	m_data(text),
+	m_size(std::strlen(text))
+{
+}
+
+LogText::LogText(const std::string& text) :
+	m_data(text.data()),
+	m_size(text.size())
+{
+}
+
+LogText::LogText(std::string_view text) :
+	m_data(text.data()),
+	m_size(text.size())
+{
+}
+
+std::string_view LogText::View() const
+{
+	return std::string_view(m_data, m_size);
+}
+
+bool LogText::Stored() const
+{
+	return m_block != nullptr;
+}
+
+LogArena::LogArena(std::size_t blockSize) :
+	m_blockSize(blockSize),
+	m_used(blockSize)
+{
+}
+
+// A text that doesn't fit in the rest of the current block starts a new block.
+// A text longer than a block gets a block of its own.
+LogText LogArena::Store(const LogText& text)
+{
+	if (text.Stored())
+		return text;
+
+	LogText stored;
+	char* data;
+	if (text.m_size > m_blockSize)
+	{
+		std::shared_ptr<char> block(new char[text.m_size], std::default_delete<char[]>());
+		data = block.get();
+		stored.m_block = block;
+	}
+	else
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+		if (!m_block || text.m_size > m_blockSize - m_used)
+		{
+			m_block.reset(new char[m_blockSize], std::default_delete<char[]>());
+			m_used = 0;
+		}
+		data = m_block.get() + m_used;
+		m_used += text.m_size;
+		stored.m_block = m_block;
+	}
+
+	// The space is reserved, the copy needs no lock.
+	std::memcpy(data, text.m_data, text.m_size);
+	stored.m_data = data;
+	stored.m_size = text.m_size;
+	return stored;
+}
+
+} // namespace gj
@@ -0,0 +1,65 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#ifndef BOOST_TESTUI_LOGARENA_H
+#define BOOST_TESTUI_LOGARENA_H
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <boost/thread/mutex.hpp>
+
+namespace gj {
+
+// A line of log text. It is either a view of transient text, like a line in the
+// output read buffer, or a handle to the text stored in a LogArena. A stored text
+// keeps its arena block alive, copying the handle doesn't copy the text.
+class LogText
+{
+public:
+	LogText();
+	LogText(const char* text);
+	LogText(const std::string& text);
+	LogText(std::string_view text);
+
+	std::string_view View() const;
+	bool Stored() const;
+
+private:
+	friend class LogArena;
+
+	std::shared_ptr<const char> m_block;
+	const char* m_data;
+	std::size_t m_size;
+};
+
+// Append-only storage for log text. The text is copied into large blocks that
+// are freed when the last LogText in them is gone.
+class LogArena
+{
+public:
+	static const std::size_t DefaultBlockSize = 64 * 1024;
+
+	explicit LogArena(std::size_t blockSize = DefaultBlockSize);
+
+	// Returns the text stored in the arena. Text that is already stored, here
+	// or in another arena, is not copied again.
+	LogText Store(const LogText& text);
+
+private:
+	boost::mutex m_mutex;
+	std::size_t m_blockSize;
+	std::shared_ptr<char> m_block;
+	std::size_t m_used;
+};
+
+} // namespace gj
+
+#endif // BOOST_TESTUI_LOGARENA_H
@@ -6,6 +6,7 @@
 // See http://boosttestui.wordpress.com/ for the boosttestui home page.
 
 #include "stdafx.h"
+#include <algorithm>
 #include <iomanip>
 #include <regex>
 #include <fstream>
@@ -31,6 +32,7 @@ END_MSG_MAP()
 
 CLogView::CLogView(CMainFrame& mainFrame) :
 	m_pMainFrame(&mainFrame),
+	m_hiddenStreams(0),
 	m_clockTime(false),
 	m_logHighLightBegin(0),
 	m_logHighLightEnd(0),
@@ -101,6 +103,7 @@ void CLogView::Clear()
 {
 	DeleteAllItems();
 	m_logLines.clear();
+	m_visibleLines.clear();
 	m_items.clear();
 	SetHighLight(0, 0);
 }
@@ -132,8 +135,8 @@ void CLogView::SetHighLight(unsigned id)
 	if (it == m_items.end())
 		return;
 
-	int begin = it->second.beginLine;
-	int end = it->second.endLine;
+	int begin = GetItem(it->second.beginLine);
+	int end = GetItem(it->second.endLine);
 	SetHighLight(begin, end);
 
 	EnsureVisible(end, true);
@@ -160,11 +163,11 @@ bool CLogView::Find(const std::string& text, int direction)
 	while (line != begin)
 	{
 		if (line < 0)
-			line += m_logLines.size();
-		if (static_cast<size_t>(line) == m_logLines.size())
+			line += GetItemCount();
+		if (line == GetItemCount())
 			line = 0;
 
-		if (m_logLines[line].message.find(text) != std::string::npos)
+		if (GetLine(line).message.View().find(text) != std::string_view::npos)
 		{
 			EnsureVisible(line, true);
 			SetItemState(line, LVIS_FOCUSED, LVIS_FOCUSED);
@@ -186,14 +189,18 @@ bool CLogView::FindPrevious(const std::wstring& text)
 	return Find(Str(text).str(), -1);
 }
 
-void CLogView::Add(unsigned id, const SYSTEMTIME& localTime, double t, Severity::type severity, const std::string& msg)
+void CLogView::Add(unsigned id, const SYSTEMTIME& localTime, double t, OutputStream::type stream, unsigned sequence, Severity::type severity, const LogText& msg)
 {
+	m_logLines.push_back(LogLine(id, localTime, t, stream, sequence, severity, msg));
+	if (!IsVisible(m_logLines.back()))
+		return;
+
 	int focus = GetNextItem(-1, LVNI_FOCUSED);
 	bool selectLast = focus < 0 || focus == GetItemCount() - 1;
 
-	int item = m_logLines.size();
-	m_logLines.push_back(LogLine(id, localTime, t, severity, msg));
-	SetItemCount(m_logLines.size());
+	int item = m_visibleLines.size();
+	m_visibleLines.push_back(m_logLines.size() - 1);
+	SetItemCount(m_visibleLines.size());
 
 	if (selectLast)
 	{
@@ -213,6 +220,51 @@ void CLogView::SetClockTime(bool clockTime)
 	Invalidate(false);
 }
 
+bool CLogView::GetShowStream(OutputStream::type stream) const
+{
+	return (m_hiddenStreams & (1 << stream)) == 0;
+}
+
+// The messages of the runner itself are always shown.
+void CLogView::SetShowStream(OutputStream::type stream, bool show)
+{
+	if (show == GetShowStream(stream))
+		return;
+
+	if (show)
+		m_hiddenStreams &= ~(1 << stream);
+	else
+		m_hiddenStreams |= 1 << stream;
+
+	m_visibleLines.clear();
+	for (size_t line = 0; line < m_logLines.size(); ++line)
+	{
+		if (IsVisible(m_logLines[line]))
+			m_visibleLines.push_back(line);
+	}
+	SetItemCount(m_visibleLines.size());
+	SetHighLight(0, 0);
+	Invalidate(false);
+}
+
+bool CLogView::IsVisible(const LogLine& log) const
+{
+	return log.stream == OutputStream::Runner || GetShowStream(log.stream);
+}
+
+const CLogView::LogLine& CLogView::GetLine(int item) const
+{
+	return m_logLines[m_visibleLines[item]];
+}
+
+// Returns the item of the first visible line from line on.
+int CLogView::GetItem(int line) const
+{
+	if (line == std::numeric_limits<int>::max())
+		return line;
+	return std::lower_bound(m_visibleLines.begin(), m_visibleLines.end(), line) - m_visibleLines.begin();
+}
+
 void CLogView::Save(const std::wstring& fileName)
 {
 	std::ofstream file(fileName);
@@ -253,15 +305,33 @@ void CLogView::SaveSettings(CRegKey& reg)
 
 void CLogView::BeginTestUnit(unsigned id)
 {
-	m_items[id].beginLine = GetItemCount();
+	m_items[id].beginLine = m_logLines.size();
 	m_items[id].endLine = std::numeric_limits<int>::max();
 }
 
 void CLogView::EndTestUnit(unsigned id)
 {
-	m_items[id].endLine = GetItemCount();
+	m_items[id].endLine = m_logLines.size();
 	if (m_logHighLightEnd > GetItemCount())
-		SetHighLight(m_items[id].beginLine, m_items[id].endLine);
+		SetHighLight(GetItem(m_items[id].beginLine), GetItem(m_items[id].endLine));
+}
+
+void CLogView::RemapTestUnits(const std::map<unsigned, unsigned>& ids, unsigned rootId)
+{
+	for (auto it = m_logLines.begin(); it != m_logLines.end(); ++it)
+	{
+		auto id = ids.find(it->id);
+		it->id = id == ids.end() ? rootId : id->second;
+	}
+
+	std::map<unsigned, TestItem> items;
+	for (auto it = m_items.begin(); it != m_items.end(); ++it)
+	{
+		auto id = ids.find(it->first);
+		if (id != ids.end())
+			items[id->second] = it->second;
+	}
+	m_items.swap(items);
 }
 
 void CLogView::SelectAll()
@@ -392,7 +462,7 @@ void CLogView::DrawItem(CDCHandle dc, int iItem, unsigned /*iItemState*/) const
 
 	bool selected = GetItemState(iItem, LVIS_SELECTED) == LVIS_SELECTED;
 	bool focused = GetItemState(iItem, LVIS_FOCUSED) == LVIS_FOCUSED;
-	auto bkColor = selected ? GetSysColor(COLOR_HIGHLIGHT) : GetHighLightBkColor(m_logLines[iItem].severity, iItem);
+	auto bkColor = selected ? GetSysColor(COLOR_HIGHLIGHT) : GetHighLightBkColor(GetLine(iItem).severity, iItem);
 	auto txColor = selected ? GetSysColor(COLOR_HIGHLIGHTTEXT) : GetSysColor(COLOR_WINDOWTEXT);
 	dc.FillSolidRect(rect.left, rect.top, rect.right - rect.left, rect.bottom - rect.top, bkColor);
 	ScopedBkColor bcol(dc, bkColor);
@@ -450,18 +520,28 @@ LRESULT CLogView::OnItemChanged(NMHDR* pnmh)
 
 	if ((nmhdr.uNewState & LVIS_FOCUSED) == 0 ||
 		nmhdr.iItem < 0  ||
-		static_cast<size_t>(nmhdr.iItem) >= m_logLines.size())
+		static_cast<size_t>(nmhdr.iItem) >= m_visibleLines.size())
 		return 0;
 
-	m_pMainFrame->SelectItem(m_logLines[nmhdr.iItem].id);
+	m_pMainFrame->SelectItem(GetLine(nmhdr.iItem).id);
 
 	return 0;
 }
 
-LRESULT CLogView::OnGetInfoTip(NMHDR* /*pnmh*/)
+// Shows the stream and the sequence number of a line of test output.
+LRESULT CLogView::OnGetInfoTip(NMHDR* pnmh)
 {
-//	auto& nmhdr = *reinterpret_cast<NMLVGETINFOTIP*>(pnmh);
+	auto& nmhdr = *reinterpret_cast<NMLVGETINFOTIP*>(pnmh);
+	if (nmhdr.iItem < 0 || static_cast<size_t>(nmhdr.iItem) >= m_visibleLines.size())
+		return 0;
+
+	const LogLine& log = GetLine(nmhdr.iItem);
+	if (log.stream == OutputStream::Runner || nmhdr.cchTextMax <= 0)
+		return 0;
 
+	std::wstring tooltip = (wstringbuilder() << (log.stream == OutputStream::StdErr ? L"stderr" : L"stdout") << L", line " << log.sequence).str();
+	wcsncpy(nmhdr.pszText, tooltip.c_str(), nmhdr.cchTextMax - 1);
+	nmhdr.pszText[nmhdr.cchTextMax - 1] = L'\0';
 	return 0;
 }
 
@@ -493,8 +573,8 @@ std::string CLogView::GetSubItemText(int iItem, int iSubItem) const
 {
 	switch (iSubItem)
 	{
-	case 0: return GetTimeText(m_logLines[iItem]);
-	case 1: return m_logLines[iItem].message;
+	case 0: return GetTimeText(GetLine(iItem));
+	case 1: return std::string(GetLine(iItem).message.View());
 	}
 	return std::string();
 }
@@ -503,7 +583,7 @@ LRESULT CLogView::OnGetDispInfo(NMHDR* pnmh)
 {
 	auto& nmhdr = *reinterpret_cast<NMLVDISPINFO*>(pnmh);
 	LVITEM& item = nmhdr.item;
-	if ((item.mask & LVIF_TEXT) == 0 || item.iItem >= static_cast<int>(m_logLines.size()))
+	if ((item.mask & LVIF_TEXT) == 0 || item.iItem >= static_cast<int>(m_visibleLines.size()))
 		return 0;
 
 	m_dispInfoText = WStr(GetSubItemText(item.iItem, item.iSubItem)).str();
@@ -11,6 +11,8 @@
 #include <map>
 #include "AtlWinExt.h"
 #include "Severity.h"
+#include "LogArena.h"
+#include "OutputStream.h"
 
 namespace gj {
 
@@ -30,9 +32,11 @@ public:
 	void Copy();
 	bool Empty() const;
 	void Clear();
-	void Add(unsigned id, const SYSTEMTIME& localTime, double t, Severity::type severity, const std::string& msg);
+	void Add(unsigned id, const SYSTEMTIME& localTime, double t, OutputStream::type stream, unsigned sequence, Severity::type severity, const LogText& msg);
 	bool GetClockTime() const;
 	void SetClockTime(bool clockTime);
+	bool GetShowStream(OutputStream::type stream) const;
+	void SetShowStream(OutputStream::type stream, bool show);
 	void SetHighLight(unsigned id);
 	void SetHighLight(int begin, int end);
 	bool FindNext(const std::wstring& text);
@@ -42,6 +46,9 @@ public:
 	void SaveSettings(CRegKey& reg);
 	void BeginTestUnit(unsigned id);
 	void EndTestUnit(unsigned id);
+	// Maps the old ids of the kept test units to their new ids, the log lines
+	// of the other test units go to the rootId test suite.
+	void RemapTestUnits(const std::map<unsigned, unsigned>& ids, unsigned rootId);
 
 	using CListViewCtrl::GetItemText;
 	std::string GetItemText(int item, int subItem) const;
@@ -54,18 +61,21 @@ public:
 private:
 	struct LogLine
 	{
-		LogLine(unsigned id, const SYSTEMTIME& localTime, double time, Severity::type severity, const std::string& message) :
-			id(id), localTime(localTime), time(time), severity(severity), message(message)
+		LogLine(unsigned id, const SYSTEMTIME& localTime, double time, OutputStream::type stream, unsigned sequence, Severity::type severity, const LogText& message) :
+			id(id), localTime(localTime), time(time), stream(stream), sequence(sequence), severity(severity), message(message)
 		{
 		}
 
 		unsigned id;
 		SYSTEMTIME localTime;
 		double time;
+		OutputStream::type stream;
+		unsigned sequence;
 		Severity::type severity;
-		std::string message;
+		LogText message;
 	};
 
+	// The lines of a test unit, as indexes in m_logLines.
 	struct TestItem
 	{
 		int beginLine;
@@ -95,9 +105,14 @@ private:
 	static std::string GetTimeText(double t);
 	static std::string GetTimeText(const SYSTEMTIME& t);
 	std::string GetTimeText(const LogLine& log) const;
+	const LogLine& GetLine(int item) const;
+	int GetItem(int line) const;
+	bool IsVisible(const LogLine& log) const;
 
 	CMainFrame* m_pMainFrame;
 	std::vector<LogLine> m_logLines;
+	std::vector<int> m_visibleLines;
+	unsigned m_hiddenStreams;
 	std::map<unsigned, TestItem> m_items;
 	bool m_clockTime;
 	int m_logHighLightBegin;
@@ -20,6 +20,7 @@
 #include "AboutDlg.h"
 #include "ArgumentsDlg.h"
 #include "ExeRunner.h"
+#include "TestTreeDiff.h"
 #include "MainFrm.h"
 
 // ComCtrl.h
@@ -42,6 +43,8 @@ struct Options
 		LogAutoClear = 1 << 16,
 		AutoRun = 1 << 17,
 		ClockTime = 1 << 18,
+		HideStdOut = 1 << 19,
+		HideStdErr = 1 << 20,
 	};
 };
 
@@ -65,10 +68,14 @@ BEGIN_MSG_MAP2(CMainFrame)
 	COMMAND_ID_HANDLER_EX(ID_LOG_SELECTALL, OnLogSelectAll)
 	COMMAND_ID_HANDLER_EX(ID_LOG_CLEAR, OnLogClear)
 	COMMAND_ID_HANDLER_EX(ID_LOG_TIME, OnLogTime)
+	COMMAND_ID_HANDLER_EX(ID_LOG_STDOUT, OnLogStream)
+	COMMAND_ID_HANDLER_EX(ID_LOG_STDERR, OnLogStream)
 	COMMAND_ID_HANDLER_EX(ID_LOG_COPY, OnLogCopy)
 	COMMAND_ID_HANDLER_EX(ID_LOG_FIND, OnLogFind)
 	COMMAND_ID_HANDLER_EX(ID_TEST_RANDOMIZE, OnTestRandomize)
 	COMMAND_ID_HANDLER_EX(ID_TEST_REPEAT, OnTestRepeat)
+	COMMAND_ID_HANDLER_EX(ID_TEST_PARALLEL, OnTestParallel)
+	COMMAND_ID_HANDLER_EX(ID_TEST_RESIDENT, OnTestResident)
 	COMMAND_ID_HANDLER_EX(ID_TEST_DEBUGGER, OnTestDebugger)
 	COMMAND_ID_HANDLER_EX(ID_TEST_RUNNERARGS, OnTestRunnerArgs)
 	COMMAND_ID_HANDLER_EX(ID_TEST_ABORT, OnTestAbort)
@@ -99,11 +106,16 @@ CMainFrame::CMainFrame(const std::wstring& fileName, const std::wstring& argumen
 	m_treeView(*this),
 	m_logView(*this),
 	m_findDlg(*this),
+	m_refresh(false),
+	m_loadSequence(0),
 	m_autoRun(false),
 	m_logAutoClear(true),
 	m_randomize(false),
 	m_repeat(false),
-	m_debugger(false)
+	m_parallel(false),
+	m_resident(false),
+	m_debugger(false),
+	m_queued(0)
 {
 }
 
@@ -146,19 +158,25 @@ void CMainFrame::UpdateUI()
 	UIEnable(ID_FILE_SAVE_AS, isLoaded);
 	UIEnable(ID_TEST_RANDOMIZE, (enabled & TestRunner::Randomize) != 0);
 	UIEnable(ID_TEST_REPEAT, isLoaded);
+	UIEnable(ID_TEST_PARALLEL, (enabled & TestRunner::Parallel) != 0);
+	UIEnable(ID_TEST_RESIDENT, (enabled & TestRunner::Resident) != 0);
 	UIEnable(ID_TEST_DEBUGGER, (enabled & TestRunner::WaitForDebugger) != 0);
 	UIEnable(ID_TEST_RUNNERARGS, isLoaded);
 	UIEnable(ID_TREE_RUN, isRunnable);
 	UIEnable(ID_TREE_RUN_CHECKED, isRunnable);
 	UIEnable(ID_TREE_RUN_ALL, isRunnable);
-	UIEnable(ID_TEST_ABORT, isRunning);
-	UIEnable(ID_TEST_CATEGORIES, !m_categories.IsEmpty());
+	UIEnable(ID_TEST_ABORT, isRunning || IsLoading());
+	UIEnable(ID_TEST_CATEGORIES, isLoaded && !m_categories.IsEmpty());
 	UIEnable(ID_LOGLEVEL, !isRunning);
 	UISetCheck(ID_FILE_AUTO_RUN, m_autoRun);
 	UISetCheck(ID_LOG_AUTO_CLEAR, m_logAutoClear);
 	UISetCheck(ID_LOG_TIME, m_logView.GetClockTime());
+	UISetCheck(ID_LOG_STDOUT, m_logView.GetShowStream(OutputStream::StdOut));
+	UISetCheck(ID_LOG_STDERR, m_logView.GetShowStream(OutputStream::StdErr));
 	UISetCheck(ID_TEST_RANDOMIZE, m_randomize);
 	UISetCheck(ID_TEST_REPEAT, m_repeat);
+	UISetCheck(ID_TEST_PARALLEL, m_parallel);
+	UISetCheck(ID_TEST_RESIDENT, m_resident);
 	UISetCheck(ID_TEST_DEBUGGER, m_debugger);
 	UpdateStatusBar();
 }
@@ -238,7 +256,7 @@ LRESULT CMainFrame::OnCreate(const CREATESTRUCT* /*pCreate*/)
 	if (!m_pathName.empty())
 		Load(m_pathName);
 
-	SetTimer(1, 1000);
+	SetTimer(FileTimer, 1000);
 	DragAcceptFiles(true);
 	return 0;
 }
@@ -338,6 +356,36 @@ private:
 	int m_testCaseCount;
 };
 
+class CategoryCollector :
+	boost::noncopyable,
+	public TestTreeVisitor
+{
+public:
+	explicit CategoryCollector(CategoryList& categories) :
+		m_categories(categories)
+	{
+	}
+
+	virtual void VisitTestCase(TestCase& tc) override
+	{
+		Add(tc);
+	}
+
+	virtual void EnterTestSuite(TestSuite& ts) override
+	{
+		Add(ts);
+	}
+
+private:
+	void Add(const TestUnit& tu)
+	{
+		for (auto it = tu.categories.begin(); it != tu.categories.end(); ++it)
+			m_categories.Add(*it);
+	}
+
+	CategoryList& m_categories;
+};
+
 class CategoryFilter :
 	boost::noncopyable,
 	public TestTreeVisitor
@@ -389,65 +437,6 @@ private:
 	std::vector<bool> m_suites;
 };
 
-class TestCaseStateSaveVisitor :
-	boost::noncopyable,
-	public TestTreeVisitor
-{
-public:
-	TestCaseStateSaveVisitor(TreeViewStateStorage& testState, const CTreeView& treeView) :
-		m_testState(testState),
-		m_treeView(treeView)
-	{
-	}
-
-	void VisitTestCase(TestCase& tc)
-	{
-		m_testState.SaveState(tc, m_treeView.GetTestItemState(tc.id));
-	}
-
-	void EnterTestSuite(TestSuite& ts)
-	{
-		m_testState.SaveState(ts, m_treeView.GetTestItemState(ts.id));
-	}
-
-private:
-	TreeViewStateStorage& m_testState;
-	const CTreeView& m_treeView;
-};
-
-class TestCaseStateRestoreVisitor :
-	boost::noncopyable,
-	public TestTreeVisitor
-{
-public:
-	TestCaseStateRestoreVisitor(const TreeViewStateStorage& testState, CTreeView& treeView) :
-		m_testState(testState),
-		m_treeView(treeView)
-	{
-	}
-
-	virtual void VisitTestCase(TestCase& tc)
-	{
-		EnterTestUnit(tc);
-	}
-
-	virtual void EnterTestSuite(TestSuite& ts)
-	{
-		EnterTestUnit(ts);
-	}
-
-	void EnterTestUnit(TestUnit& tu)
-	{
-		TreeViewItemState state(false, false);
-		if (m_testState.RestoreState(tu, state))
-			m_treeView.SetTestItemState(tu.id, state);
-	}
-
-private:
-	const TreeViewStateStorage& m_testState;
-	CTreeView& m_treeView;
-};
-
 class SingleTestCaseSelector : public TestTreeVisitor
 {
 public:
@@ -506,6 +495,7 @@ void CMainFrame::EnQueue(const std::function<void ()>& fn)
 	boost::mutex::scoped_lock lock(m_mtx);
 	bool notify = m_q.empty();
 	m_q.push(fn);
+	++m_queued;
 	if (notify)
 		PostMessage(UM_DEQUEUE);
 }
@@ -517,11 +507,15 @@ LRESULT CMainFrame::OnDeQueue(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*
 		boost::mutex::scoped_lock lock(m_mtx);
 		std::swap(m_q, fnq);
 	}
+	unsigned count = fnq.size();
 	while (!fnq.empty())
 	{
 		fnq.front()();
 		fnq.pop();
 	}
+
+	boost::mutex::scoped_lock lock(m_mtx);
+	m_queued -= count;
 	return 0;
 }
 
@@ -534,9 +528,10 @@ FILETIME GetLastWriteTime(HANDLE hFile, const std::wstring& fileName)
 	return ftWrite;
 }
 
+// FILE_FLAG_BACKUP_SEMANTICS opens a workspace directory too.
 FILETIME GetLastWriteTime(const std::wstring& fileName)
 {
-	CHandle hFile(CreateFile(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr));
+	CHandle hFile(CreateFile(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr));
 	if (hFile == INVALID_HANDLE_VALUE)
 	{
 		hFile.Detach();
@@ -558,32 +553,6 @@ bool operator!=(const FILETIME& ft1, const FILETIME& ft2)
 	return !(ft1 == ft2);
 }
 
-void CMainFrame::ClearTestSelection()
-{
-	m_testStateStorage.Clear();
-}
-
-void CMainFrame::SaveTestSelection()
-{
-	if (!m_pRunner)
-		return;
-
-	ClearTestSelection();
-	TestCaseStateSaveVisitor vis(m_testStateStorage, m_treeView);
-	m_pRunner->TraverseTestTree(vis);
-	m_testStateStorage.SaveScrollPos(m_treeView);
-}
-
-void CMainFrame::RestoreTestSelection()
-{
-	if (!m_pRunner)
-		return;
-
-	TestCaseStateRestoreVisitor vis(m_testStateStorage, m_treeView);
-	m_pRunner->TraverseTestTree(vis);
-	m_testStateStorage.RestoreScrollPos(m_treeView);
-}
-
 void CMainFrame::LoadNew(const std::wstring& fileName)
 {
 	m_progressBar.SetPos(0);
@@ -597,14 +566,21 @@ void CMainFrame::Reload()
 	Load(m_pathName);
 }
 
-void CMainFrame::OnTimer(UINT_PTR /*nIDEvent*/)
+void CMainFrame::OnTimer(UINT_PTR nIDEvent)
 {
+	if (nIDEvent == FillTimer)
+	{
+		if (m_pTreeFill)
+			FillTreeView();
+		return;
+	}
+
 	UpdateProgressBar();
 
-	if (!m_pRunner || m_pRunner->IsRunning())
+	if (!m_pRunner || m_pRunner->IsRunning() || IsLoading())
 		return;
 
-	CHandle hFile(CreateFile(m_pathName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr));
+	CHandle hFile(CreateFile(m_pathName.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr));
 	if (hFile == INVALID_HANDLE_VALUE)
 	{
 		hFile.Detach();
@@ -615,10 +591,7 @@ void CMainFrame::OnTimer(UINT_PTR /*nIDEvent*/)
 	if (fileTime == m_fileTime)
 		return;
 
-	SaveTestSelection();
-	Reload();
-	if (m_autoRun)
-		RunChecked();
+	Refresh();
 }
 
 void CMainFrame::OnDropFiles(HDROP hDropInfo)
@@ -654,45 +627,203 @@ private:
 	FILETIME m_fileTime;
 };
 
+// The test tree is listed on a background thread and added to the tree view
+// while it is listed. The tests can run when the listing is complete.
 void CMainFrame::Load(const std::wstring& fileName)
-try
 {
-	// Store the time stamp of this file so that we don't retry Load()-ing it until it changes:
-	m_fileTime = GetLastWriteTime(fileName);
-
-	ScopedCursor cursor(::LoadCursor(nullptr, IDC_WAIT));
-	UISetText(0, WStr(wstringbuilder() << "Loading " << fileName));
-
 	namespace fs = boost::filesystem;
 	fs::wpath fullPath = fs::system_complete(fs::wpath(fileName));
-	m_pRunner.reset(new ExeRunner(fullPath.wstring(), *this));
+	StartLoad(fullPath.wstring(), false);
+}
 
-	m_testIterationCount = 0;
+// Reloads a rebuilt test executable in the background.
+void CMainFrame::Refresh()
+{
+	// Store the time stamp of this file so that we don't retry Refresh()-ing it until it changes:
+	m_fileTime = GetLastWriteTime(m_pathName);
+	StartLoad(m_pathName, true);
+}
+
+void CMainFrame::StartLoad(const std::wstring& pathName, bool refresh)
+{
+	FILETIME fileTime = GetLastWriteTime(pathName);
+	CancelLoad();
+	unsigned sequence = m_loadSequence;
+	// A refreshed test tree is diffed with the loaded one when it is complete.
+	TestTreeRecording* pUnits = nullptr;
+	if (!refresh)
+	{
+		DropTestTree();
+		m_pTreeFill.reset(new TestTreeRecording());
+		pUnits = m_pTreeFill.get();
+		SetTimer(FillTimer, USER_TIMER_MINIMUM);
+	}
+	m_pLoader.reset(new TestLoader(pathName, *this, [this, sequence]() { EnQueue([this, sequence]() { OnLoaded(sequence); }); }, pUnits));
+	m_loadFileTime = fileTime;
+	m_refresh = refresh;
+}
+
+// A canceled refresh keeps the current test tree, a test tree that is
+// partly listed or added to the tree view is dropped.
+void CMainFrame::CancelLoad()
+{
+	++m_loadSequence;
+	m_pLoader.reset();
+	if (m_pTreeFill)
+		DropTestTree();
+}
+
+void CMainFrame::DropTestTree()
+{
+	KillTimer(FillTimer);
+	m_pTreeFill.reset();
+	m_pRunner.reset();
+	m_treeView.Clear();
+	m_categories.Clear();
 	m_testCaseCount = 0;
+	SetWindowText(L"Boost Test Runner");
+}
+
+bool CMainFrame::IsLoading() const
+{
+	return m_pLoader || m_pTreeFill;
+}
+
+// The sequence number tells apart the result of the current load from
+// that of a canceled load that was already queued.
+void CMainFrame::OnLoaded(unsigned sequence)
+{
+	if (sequence != m_loadSequence || !m_pLoader)
+		return;
+
+	std::unique_ptr<TestLoader> pLoader(std::move(m_pLoader));
+	std::unique_ptr<TestRunner> pRunner;
+	try
+	{
+		pRunner = pLoader->GetRunner();
+	}
+	catch (NoHeaderError& e)
+	{
+		if (m_pTreeFill)
+			DropTestTree();
+		m_helpType = e.GetUnitTestType();
+		MessageBox(WStr(e.what()), LoadString(IDR_APPNAME).c_str(), MB_ICONERROR | MB_HELP | MB_OK);
+		return;
+	}
+	catch (...)
+	{
+		if (m_pTreeFill)
+			DropTestTree();
+		throw;
+	}
+
+	m_fileTime = m_loadFileTime;
+	if (m_refresh)
+		UpdateTestTree(std::move(pRunner));
+	else
+		SetTestTree(pLoader->GetPathName(), std::move(pRunner));
+}
+
+// The tree view already shows the test units that were listed so far, they
+// were drawn inactive until now.
+void CMainFrame::SetTestTree(const std::wstring& pathName, std::unique_ptr<TestRunner> pRunner)
+{
+	m_pRunner = std::move(pRunner);
+
+	m_testIterationCount = 0;
 	m_testsRunCount = 0;
 	m_ignoredTestCount = 0;
 	m_failedTestCount = 0;
-	m_treeView.Clear();
 	m_logView.Clear();
-	m_categories.Clear();
-	TestCaseLoader loadTestCases(m_treeView, m_categories);
-	m_pRunner->TraverseTestTree(loadTestCases);
-	m_testCaseCount = loadTestCases.TestCaseCount();
-	m_treeView.ExpandToView();
-	RestoreTestSelection();
-	ClearTestSelection();
+	m_treeView.RedrawWindow();
 
 	m_progressBar.SetPos(0);
 
-	SetWindowText(WStr(wstringbuilder() << fullPath.filename().wstring() << L" - Boost Test Runner"));
-	m_pathName = fullPath.wstring();
+	namespace fs = boost::filesystem;
+	SetWindowText(WStr(wstringbuilder() << fs::wpath(pathName).filename().wstring() << L" - Boost Test Runner"));
+	m_pathName = pathName;
 
 	m_mru.AddToList(m_pathName.c_str());
 }
-catch (NoHeaderError& e)
+
+// A large test tree is added to the tree view in steps, as it is listed. The
+// fill timer only fires when there is no user input to handle.
+void CMainFrame::FillTreeView()
+{
+	TestCaseLoader loadTestCases(m_treeView, m_categories);
+	bool complete = m_pTreeFill->Replay(loadTestCases, TreeFillStep);
+	m_testCaseCount += loadTestCases.TestCaseCount();
+	if (!complete)
+	{
+		SetTimer(FillTimer, USER_TIMER_MINIMUM);
+		return;
+	}
+
+	KillTimer(FillTimer);
+	m_pTreeFill.reset();
+	m_treeView.ExpandToView();
+}
+
+// The new test tree of a rebuilt test executable is diffed with the loaded
+// one and only the added, removed and renamed test units are updated, so the
+// unchanged test units keep their selection, results and log lines. The
+// categories are those of the new test tree, with the selection they had.
+void CMainFrame::UpdateTestTree(std::unique_ptr<TestRunner> pRunner)
 {
-	m_helpType = e.GetUnitTestType();
-	MessageBox(WStr(e.what()), LoadString(IDR_APPNAME).c_str(), MB_ICONERROR | MB_HELP | MB_OK);
+	TestUnitNode tree = GetTestTree(*pRunner);
+	TestTreeDiff diff = DiffTestTrees(GetTestTree(*m_pRunner), tree);
+	std::unique_ptr<TestRunner> pOldRunner(std::move(m_pRunner));
+	m_pRunner = std::move(pRunner);
+
+	CategoryList categories;
+	CategoryCollector collectCategories(categories);
+	m_pRunner->TraverseTestTree(collectCategories);
+	for (auto it = m_categories.begin(); it != m_categories.end(); ++it)
+	{
+		if (categories.Contains(it->first))
+			categories.SetSelection(it->first, it->second);
+	}
+	m_categories = categories;
+
+	for (auto it = diff.removed.begin(); it != diff.removed.end(); ++it)
+		m_treeView.RemoveTestItem(*it);
+
+	std::map<unsigned, unsigned> ids(diff.unchanged);
+	ids.insert(diff.renamed.begin(), diff.renamed.end());
+	m_treeView.RemapTestItems(ids);
+	m_logView.RemapTestUnits(diff.unchanged, tree.data.id);
+
+	// A test unit that got enabled or disabled in the source is checked accordingly.
+	for (auto it = diff.unchanged.begin(); it != diff.unchanged.end(); ++it)
+	{
+		bool enabled = m_pRunner->GetTestUnit(it->second).enabled;
+		if (pOldRunner->GetTestUnit(it->first).enabled != enabled)
+			m_treeView.Check(it->second, enabled);
+	}
+
+	for (auto it = diff.renamed.begin(); it != diff.renamed.end(); ++it)
+	{
+		const TestUnit& tu = m_pRunner->GetTestUnit(it->second);
+		m_treeView.RenameTestItem(it->second, tu.name);
+		m_treeView.Check(it->second, tu.enabled);
+	}
+
+	TestCaseLoader loadTestCases(m_treeView, m_categories);
+	for (auto it = diff.added.begin(); it != diff.added.end(); ++it)
+	{
+		m_treeView.BeginInsert(it->parentId, it->previousId, it->first);
+		m_pRunner->TraverseTestTree(it->id, loadTestCases);
+	}
+	CountTestCases counter;
+	m_pRunner->TraverseTestTree(counter);
+	m_testCaseCount = counter.count();
+
+	CategoryFilter filter(m_treeView, m_categories);
+	m_pRunner->TraverseTestTree(filter);
+	m_treeView.RedrawWindow();
+
+	if (m_autoRun)
+		RunChecked();
 }
 
 std::string GetListViewText(const CListViewCtrl& listView, int item, int subItem)
@@ -702,7 +833,7 @@ std::string GetListViewText(const CListViewCtrl& listView, int item, int subItem
 	return std::string(bstr.m_str, bstr.m_str + bstr.Length());
 }
 
-void CMainFrame::CreateHpp(int resourceId, const std::wstring& fileName)
+void WriteResourceFile(int resourceId, const std::wstring& fileName)
 {
 	CResource resource;
 	if (!resource.Load(RT_RCDATA, MAKEINTRESOURCE(resourceId)))
@@ -715,6 +846,16 @@ void CMainFrame::CreateHpp(int resourceId, const std::wstring& fileName)
 		ThrowLastError(fileName);
 }
 
+void CMainFrame::CreateHpp(int resourceId, const std::wstring& fileName)
+{
+	namespace fs = boost::filesystem;
+
+	WriteResourceFile(resourceId, fileName);
+
+	// The gui headers include boosttestui-gui.hpp from their own directory.
+	WriteResourceFile(IDR_BOOSTTESTUI_GUI_HPP, (fs::wpath(fileName).parent_path() / L"boosttestui-gui.hpp").wstring());
+}
+
 void CMainFrame::OnFileOpen(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/)
 {
 	CFileDialog dlg(TRUE, L"*.exe;*.dll", L"", OFN_FILEMUSTEXIST | OFN_HIDEREADONLY,
@@ -811,7 +952,6 @@ void CMainFrame::OnLogAutoClear(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wnd
 
 void CMainFrame::OnResetSelection(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/)
 {
-	ClearTestSelection();
 	Reload();
 }
 
@@ -830,6 +970,12 @@ void CMainFrame::OnLogTime(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/
 	m_logView.SetClockTime(!m_logView.GetClockTime());
 }
 
+void CMainFrame::OnLogStream(UINT /*uNotifyCode*/, int nID, CWindow /*wndCtl*/)
+{
+	auto stream = nID == ID_LOG_STDERR ? OutputStream::StdErr : OutputStream::StdOut;
+	m_logView.SetShowStream(stream, !m_logView.GetShowStream(stream));
+}
+
 void CMainFrame::OnLogCopy(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/)
 {
 	ScopedCursor cursor(::LoadCursor(nullptr, IDC_WAIT));
@@ -841,22 +987,27 @@ void CMainFrame::OnLogFind(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/
 	m_findDlg.SetFocus();
 }
 
-void CMainFrame::test_message(Severity::type severity, const std::string& msg)
+void CMainFrame::test_message(Severity::type severity, const LogText& msg)
+{
+	test_output(OutputStream::Runner, 0, severity, msg);
+}
+
+void CMainFrame::test_output(OutputStream::type stream, unsigned sequence, Severity::type severity, const LogText& msg)
 {
 	SYSTEMTIME localTime;
 	GetLocalTime(&localTime);
 	double t = m_resetTimer? (m_timer.Reset(), 0): m_timer.Get();
 	m_resetTimer = false;
-	std::string text = msg;
-	EnQueue([this, localTime, t, severity, text]()
+	LogText text = m_logArena.Store(msg);
+	EnQueue([this, localTime, t, stream, sequence, severity, text]()
 	{
-		AddLogMessage(localTime, t, severity, text);
+		AddLogMessage(localTime, t, stream, sequence, severity, text);
 	});
 }
 
-void CMainFrame::AddLogMessage(const SYSTEMTIME& localTime, double t, Severity::type severity, const std::string& msg)
+void CMainFrame::AddLogMessage(const SYSTEMTIME& localTime, double t, OutputStream::type stream, unsigned sequence, Severity::type severity, const LogText& msg)
 {
-	m_logView.Add(m_currentId, localTime, t, severity, msg);
+	m_logView.Add(m_currentId, localTime, t, stream, sequence, severity, msg);
 }
 
 void CMainFrame::SelectItem(unsigned id)
@@ -869,8 +1020,11 @@ bool CMainFrame::IsActiveItem(unsigned id) const
 	return m_pRunner && m_pRunner->GetTestUnit(id).active;
 }
 
+// The full names of a test tree that is still being listed are not known yet.
 TestUnit CMainFrame::GetTestItem(unsigned id) const
 {
+	if (!m_pRunner)
+		return TestUnit(id, TestUnit::TestCase, std::string());
 	return m_pRunner->GetTestUnit(id);
 }
 
@@ -1026,8 +1180,12 @@ void CMainFrame::UpdateStatusBar()
 	bool isLoaded = m_pRunner.get() != nullptr;
 	bool isRunning = isLoaded && m_pRunner->IsRunning();
 
-	UISetText(ID_DEFAULT_PANE, isRunning ? L"Running..." : L"Ready");
-	UISetText(ID_ITERATIONS_PANE, isLoaded ? WStr(wstringbuilder() << L"Test iterations: " << m_testIterationCount) : L"");
+	UISetText(ID_DEFAULT_PANE, isRunning ? L"Running..." : IsLoading() ? L"Loading..." : L"Ready");
+	wstringbuilder iterations;
+	iterations << L"Test iterations: " << m_testIterationCount;
+	if (m_testIterationCount > 1)
+		iterations << L" (" << std::fixed << std::setprecision(1) << m_testIterationCount / m_runTimer.Get() << L"/s)";
+	UISetText(ID_ITERATIONS_PANE, isLoaded ? WStr(iterations) : L"");
 	UISetText(ID_TOTAL_PANE, isLoaded ? WStr(wstringbuilder() << L"Test cases: " << m_testCaseCount) : L"");
 	UISetText(ID_RUN_PANE, isLoaded ? WStr(wstringbuilder() << L"Tests run: " << m_testsRunCount) : L"");
 	UISetText(ID_FAILED_PANE, isLoaded ? WStr(wstringbuilder() << L"Failed tests: " << m_failedTestCount) : L"");
@@ -1054,6 +1212,14 @@ void CMainFrame::assertion_result(bool passed)
 	});
 }
 
+void CMainFrame::test_case_assertions(unsigned id, unsigned passed, unsigned failed)
+{
+	EnQueue([this, id, passed, failed]()
+	{
+		m_treeView.SetAssertionCount(id, AssertionCount(passed, failed));
+	});
+}
+
 void CMainFrame::exception_caught(const std::string& /*what*/)
 {
 	EnQueue([this]()
@@ -1081,6 +1247,12 @@ void CMainFrame::TestFinished()
 	});
 }
 
+unsigned CMainFrame::QueuedEvents()
+{
+	boost::mutex::scoped_lock lock(m_mtx);
+	return m_queued;
+}
+
 void CMainFrame::OnTestRandomize(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/)
 {
 	m_randomize = !m_randomize;
@@ -1092,6 +1264,16 @@ void CMainFrame::OnTestRepeat(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCt
 	m_pRunner->SetRepeat(m_repeat);
 }
 
+void CMainFrame::OnTestParallel(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/)
+{
+	m_parallel = !m_parallel;
+}
+
+void CMainFrame::OnTestResident(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/)
+{
+	m_resident = !m_resident;
+}
+
 void CMainFrame::OnTestDebugger(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/)
 {
 	m_debugger = !m_debugger;
@@ -1109,6 +1291,10 @@ unsigned CMainFrame::GetOptions() const
 	unsigned options = 0;
 	if (m_logView.GetClockTime())
 		options |= Options::ClockTime;
+	if (!m_logView.GetShowStream(OutputStream::StdOut))
+		options |= Options::HideStdOut;
+	if (!m_logView.GetShowStream(OutputStream::StdErr))
+		options |= Options::HideStdErr;
 	if (m_autoRun)
 		options |= Options::AutoRun;
 	if (m_logAutoClear)
@@ -1119,11 +1305,18 @@ unsigned CMainFrame::GetOptions() const
 		options |= TestRunner::Randomize;
 	if (m_repeat)
 		options |= TestRunner::Repeat;
+	if (m_parallel)
+		options |= TestRunner::Parallel;
+	if (m_resident)
+		options |= TestRunner::Resident;
 	return options;
 }
 
 void CMainFrame::OnTestAbort(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/)
 {
+	if (IsLoading())
+		return CancelLoad();
+
 	m_pRunner->Abort();
 }
 
@@ -1221,6 +1414,9 @@ void CMainFrame::OnTreeCopyName(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wnd
 
 void CMainFrame::OnTreeCopyCommand(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/)
 {
+	if (!m_pRunner)
+		return;
+
 	SingleTestCaseSelector selector(m_treeView, m_treeView.GetSelectedTestItem());
 	m_pRunner->TraverseTestTree(selector);
 	CopyToClipboard(m_pRunner->GetCommand(m_combo.GetCurSel(), GetOptions(), m_arguments), *this);
@@ -1255,6 +1451,7 @@ void CMainFrame::FindPrevious(const std::wstring& text)
 
 void CMainFrame::OnClose()
 {
+	CancelLoad();
 	m_pRunner.reset();
 	SaveSettings();
 	DestroyWindow();
@@ -1285,8 +1482,12 @@ bool CMainFrame::LoadSettings()
 		m_autoRun = (options & Options::AutoRun) != 0;
 		m_logAutoClear = (options & Options::LogAutoClear) != 0;
 		m_logView.SetClockTime((options & Options::ClockTime) != 0);
+		m_logView.SetShowStream(OutputStream::StdOut, (options & Options::HideStdOut) == 0);
+		m_logView.SetShowStream(OutputStream::StdErr, (options & Options::HideStdErr) == 0);
 		m_randomize = (options & TestRunner::Randomize) != 0;
 		m_repeat = (options & TestRunner::Repeat) != 0;
+		m_parallel = (options & TestRunner::Parallel) != 0;
+		m_resident = (options & TestRunner::Resident) != 0;
 		m_debugger = (options & TestRunner::WaitForDebugger) != 0;
 	}
 
@@ -1355,7 +1556,7 @@ private:
 
 bool CMainFrame::IsRunnable() const
 {
-	return m_pRunner && !m_pRunner->IsRunning();
+	return m_pRunner && !m_pRunner->IsRunning() && !IsLoading();
 }
 
 void CMainFrame::RunChecked()
@@ -1405,6 +1606,7 @@ void CMainFrame::Run()
 	m_testsRunCount = 0;
 	m_ignoredTestCount = 0;
 	m_failedTestCount = 0;
+	m_runTimer.Reset();
 	m_progressBar.SetRange(0, counter.count());
 	m_progressBar.SetPos(0);
 	if (m_logAutoClear)
@@ -1413,34 +1615,4 @@ void CMainFrame::Run()
 	m_pRunner->Run(m_combo.GetCurSel(), GetOptions(), m_arguments);
 }
 
-void TreeViewStateStorage::Clear()
-{
-	m_tests.clear();
-}
-
-void TreeViewStateStorage::SaveScrollPos(const CWindow& treeView)
-{
-	m_scrollPos = treeView.GetScrollPos(SB_VERT);
-}
-
-void TreeViewStateStorage::RestoreScrollPos(CWindow& treeView)
-{
-	 treeView.SetScrollPos(SB_VERT, m_scrollPos);
-}
-
-void TreeViewStateStorage::SaveState(const TestUnit& tu, const TreeViewItemState& state)
-{
-	m_tests.insert(std::make_pair(tu.fullName, state));
-}
-
-bool TreeViewStateStorage::RestoreState(TestUnit& tu, TreeViewItemState& state) const
-{
-	auto it = m_tests.find(tu.fullName);
-	if (it == m_tests.end())
-		return false;
-
-	state = it->second;
-	return true;
-}
-
 } // namespace gj
@@ -26,24 +26,11 @@
 #include "FindDlg.h"
 #include "CategoryList.h"
 #include "ExeRunner.h"
+#include "TestLoader.h"
 #include "DevEnv.h"
 
 namespace gj {
 
-class TreeViewStateStorage
-{
-public:
-	void Clear();
-	void SaveScrollPos(const CWindow& treeView);
-	void SaveState(const TestUnit& tu, const TreeViewItemState& state);
-	bool RestoreState(TestUnit& tu, TreeViewItemState& state) const;
-	void RestoreScrollPos(CWindow& treeView);
-
-private:
-	std::map<std::string, TreeViewItemState> m_tests;
-	int m_scrollPos;
-};
-
 class CMainFrame :
 	public CFrameWindowImpl<CMainFrame>,
 	public CUpdateUI<CMainFrame>,
@@ -61,7 +48,7 @@ public:
 	void FindNext(const std::wstring& text);
 	void FindPrevious(const std::wstring& text);
 
-	void AddLogMessage(const SYSTEMTIME& localTime, double t, Severity::type severity, const std::string& msg);
+	void AddLogMessage(const SYSTEMTIME& localTime, double t, OutputStream::type stream, unsigned sequence, Severity::type severity, const LogText& msg);
 	void SelectItem(unsigned id);
 	bool IsActiveItem(unsigned id) const;
 	TestUnit GetTestItem(unsigned id) const;
@@ -74,8 +61,12 @@ public:
 	    UPDATE_ELEMENT(ID_FILE_AUTO_RUN, UPDUI_MENUPOPUP)
 	    UPDATE_ELEMENT(ID_LOG_AUTO_CLEAR, UPDUI_MENUPOPUP | UPDUI_TOOLBAR)
 	    UPDATE_ELEMENT(ID_LOG_TIME, UPDUI_MENUPOPUP | UPDUI_TOOLBAR)
+	    UPDATE_ELEMENT(ID_LOG_STDOUT, UPDUI_MENUPOPUP)
+	    UPDATE_ELEMENT(ID_LOG_STDERR, UPDUI_MENUPOPUP)
 	    UPDATE_ELEMENT(ID_TEST_RANDOMIZE, UPDUI_MENUPOPUP | UPDUI_TOOLBAR)
 	    UPDATE_ELEMENT(ID_TEST_REPEAT, UPDUI_MENUPOPUP | UPDUI_TOOLBAR)
+	    UPDATE_ELEMENT(ID_TEST_PARALLEL, UPDUI_MENUPOPUP)
+	    UPDATE_ELEMENT(ID_TEST_RESIDENT, UPDUI_MENUPOPUP)
 	    UPDATE_ELEMENT(ID_TEST_DEBUGGER, UPDUI_MENUPOPUP | UPDUI_TOOLBAR)
 		UPDATE_ELEMENT(ID_TEST_RUNNERARGS, UPDUI_MENUPOPUP)
 	    UPDATE_ELEMENT(ID_TREE_RUN, UPDUI_MENUPOPUP)
@@ -96,6 +87,10 @@ public:
 	enum { UM_DEQUEUE = WM_APP + 100 };
 
 private:
+	enum { FileTimer = 1, FillTimer = 2 };
+	// The number of test units that are added to the tree view on each fill timer.
+	static const std::size_t TreeFillStep = 1000;
+
 	DECLARE_MSG_MAP()
 
 	void OnException();
@@ -104,7 +99,8 @@ private:
 	virtual BOOL PreTranslateMessage(MSG* pMsg);
 	virtual BOOL OnIdle();
 
-	virtual void test_message(Severity::type, const std::string& msg) override;
+	virtual void test_message(Severity::type, const LogText& msg) override;
+	virtual void test_output(OutputStream::type stream, unsigned sequence, Severity::type severity, const LogText& msg) override;
 
 	virtual void test_waiting(const std::wstring& processName, unsigned processId) override;
 	virtual void test_start() override;
@@ -122,10 +118,12 @@ private:
 
 	virtual void test_unit_ignored(const std::string& msg) override;
 	virtual void assertion_result(bool passed) override;
+	virtual void test_case_assertions(unsigned id, unsigned passed, unsigned failed) override;
 	virtual void exception_caught(const std::string& what) override;
 
 	virtual void TestStarted() override;
 	virtual void TestFinished() override;
+	virtual unsigned QueuedEvents() override;
 
 	LRESULT OnCreate(const CREATESTRUCT* pCreate);
 	LRESULT OnDeQueue(UINT /*uMsg*/, WPARAM /*wParam*/, LPARAM /*lParam*/);
@@ -145,10 +143,13 @@ private:
 	void OnLogSelectAll(UINT uNotifyCode, int nID, CWindow wndCtl);
 	void OnLogClear(UINT uNotifyCode, int nID, CWindow wndCtl);
 	void OnLogTime(UINT uNotifyCode, int nID, CWindow wndCtl);
+	void OnLogStream(UINT uNotifyCode, int nID, CWindow wndCtl);
 	void OnLogCopy(UINT uNotifyCode, int nID, CWindow wndCtl);
 	void OnLogFind(UINT uNotifyCode, int nID, CWindow wndCtl);
 	void OnTestRandomize(UINT uNotifyCode, int nID, CWindow wndCtl);
 	void OnTestRepeat(UINT uNotifyCode, int nID, CWindow wndCtl);
+	void OnTestParallel(UINT uNotifyCode, int nID, CWindow wndCtl);
+	void OnTestResident(UINT uNotifyCode, int nID, CWindow wndCtl);
 	void OnTestDebugger(UINT uNotifyCode, int nID, CWindow wndCtl);
 	void OnTestRunnerArgs(UINT uNotifyCode, int nID, CWindow wndCtl);
 	void OnTestAbort(UINT uNotifyCode, int nID, CWindow wndCtl);
@@ -173,12 +174,18 @@ private:
 	void UpdateUI();
 	void UpdateStatusBar();
 	void UpdateProgressBar();
-	void ClearTestSelection();
-	void SaveTestSelection();
-	void RestoreTestSelection();
 	void LoadNew(const std::wstring& fileName);
 	void Reload();
 	void Load(const std::wstring& fileName);
+	void Refresh();
+	void StartLoad(const std::wstring& pathName, bool refresh);
+	void CancelLoad();
+	void DropTestTree();
+	bool IsLoading() const;
+	void OnLoaded(unsigned sequence);
+	void SetTestTree(const std::wstring& pathName, std::unique_ptr<TestRunner> pRunner);
+	void FillTreeView();
+	void UpdateTestTree(std::unique_ptr<TestRunner> pRunner);
 	void CreateHpp(int resourceId, const std::wstring& fileName);
 	std::wstring GetLogFileName(const std::wstring& fileName) const;
 	void SaveLogFile(const std::wstring& fileName);
@@ -205,20 +212,28 @@ private:
 	CHorSplitterWindow m_hSplit;
 	CProgressBarCtrl m_progressBar;
 	CLogView m_logView;
+	LogArena m_logArena;
 	CRecentDocumentList m_mru;
 	CFindDlg m_findDlg;
 	std::unique_ptr<TestRunner> m_pRunner;
+	std::unique_ptr<TestLoader> m_pLoader;
+	FILETIME m_loadFileTime;
+	bool m_refresh;
+	unsigned m_loadSequence;
+	std::unique_ptr<TestTreeRecording> m_pTreeFill;
 	CategoryList m_categories;
 	UnitTestType::type m_helpType;
-	TreeViewStateStorage m_testStateStorage;
 	unsigned m_currentId;
 	bool m_autoRun;
 	bool m_logAutoClear;
 	bool m_randomize;
 	bool m_repeat;
+	bool m_parallel;
+	bool m_resident;
 	bool m_debugger;
 	bool m_resetTimer;
 	Timer m_timer;
+	Timer m_runTimer;
 	int m_testIterationCount;
 	int m_testCaseCount;
 	int m_testsRunCount;
@@ -229,6 +244,7 @@ private:
 
 	boost::mutex m_mtx;
 	std::queue<std::function<void ()>> m_q;
+	unsigned m_queued;
 };
 
 } // namespace gj
@@ -158,6 +158,8 @@ fs::wpath GetParentPath(const std::wstring& fileName)
 	return fs::wpath(fileName).parent_path();
 }
 
+#ifdef _WIN32
+
 fs::wpath GetTestUiPath()
 {
 	std::array<wchar_t, MAX_PATH> buf;
@@ -178,6 +180,27 @@ fs::wpath GetNUnitPath()
 	return fs::wpath();
 }
 
+#else // !_WIN32
+
+fs::wpath GetTestUiPath()
+{
+	std::array<char, 4096> buf;
+	ssize_t size = readlink("/proc/self/exe", buf.data(), buf.size() - 1);
+	if (size <= 0)
+		ThrowLastError("readlink");
+	return GetParentPath(MultiByteToWideChar(std::string(buf.data(), size)));
+}
+
+#endif // _WIN32
+
+std::unique_ptr<gj::ArgumentBuilder> ArgumentBuilder::Clone(ExeRunner& runner, TestObserver& observer) const
+{
+	auto p = new ArgumentBuilder(*this);
+	p->m_pRunner = &runner;
+	p->m_pObserver = &observer;
+	return std::unique_ptr<gj::ArgumentBuilder>(p);
+}
+
 std::wstring ArgumentBuilder::GetExePathName()
 {
 	fs::wpath runner(m_exeName);
@@ -381,10 +404,10 @@ void ArgumentBuilder::HandleClientNotification(const std::string& line)
 	}
 }
 
-void ArgumentBuilder::FilterMessage(const std::string& msg)
+void ArgumentBuilder::FilterMessage(std::string_view msg)
 {
-	if (msg[0] == '#')
-		return HandleClientNotification(msg);
+	if (!msg.empty() && msg[0] == '#')
+		return HandleClientNotification(std::string(msg));
 
 	Severity::type severity = m_exception ? Severity::Fatal : Severity::Info;
 
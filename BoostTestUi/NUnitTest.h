@@ -22,13 +22,14 @@ class ArgumentBuilder : public gj::ArgumentBuilder
 public:
 	ArgumentBuilder(const std::wstring& exeName, const std::wstring& fileName, ExeRunner& runner, TestObserver& observer);
 
+	virtual std::unique_ptr<gj::ArgumentBuilder> Clone(ExeRunner& runner, TestObserver& observer) const override;
 	virtual std::wstring GetExePathName() override;
 	virtual std::wstring GetListArg() override;
 	virtual void LoadTestUnits(TestUnitNode& node, std::istream& is, const std::string& testName) override;
 
 	virtual unsigned GetEnabledOptions(unsigned options) const override;
 	virtual std::wstring BuildArgs(TestRunner& runner, int logLevel, unsigned& options) override;
-	virtual void FilterMessage(const std::string& msg) override;
+	virtual void FilterMessage(std::string_view msg) override;
 
 private:
 	void HandleClientNotification(const std::string& line);
@@ -0,0 +1,29 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#ifndef BOOST_TESTUI_OUTPUTSTREAM_H
+#define BOOST_TESTUI_OUTPUTSTREAM_H
+
+#pragma once
+
+namespace gj {
+
+// The stream of the test process that a line of output was read from,
+// Runner for the messages of the test runner itself.
+struct OutputStream
+{
+	enum type
+	{
+		Runner = 0,
+		StdOut,
+		StdErr
+	};
+};
+
+} // namespace gj
+
+#endif // BOOST_TESTUI_OUTPUTSTREAM_H
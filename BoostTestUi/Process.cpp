@@ -9,77 +9,21 @@
 #include <string>
 #include <iostream>
 #include <vector>
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <spawn.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#endif
 #include <boost/filesystem.hpp>
 #include "Utilities.h"
 #include "Process.h"
 
 namespace gj {
 
-template <class Elem, class Tr = std::char_traits<Elem>, class Alloc = std::allocator<Elem> >
-class basic_handlebuf : public std::basic_streambuf<Elem, Tr>
-{
-public:
-	basic_handlebuf(HANDLE handle, std::size_t buff_sz = 256, std::size_t put_back = 8) :
-		m_handle(handle),
-		m_put_back(std::max<std::size_t>(put_back, 1)),
-		m_buffer(std::max(buff_sz, m_put_back) + m_put_back)
-	{
-		Elem* end = &m_buffer.front() + m_buffer.size();
-		setg(end, end, end);
-	}
-
-protected:
-	int_type underflow()
-	{
-		if (gptr() < egptr()) // buffer not exhausted
-			return traits_type::to_int_type(*gptr());
-
-		Elem* base = &m_buffer.front();
-		Elem* start = base;
-
-		if (eback() == base) // true when this isn't the first fill
-		{
-			// Make arrangements for putback characters
-			std::memmove(base, egptr() - m_put_back, m_put_back);
-			start += m_put_back;
-		}
-
-		// start is now the start of the buffer, proper.
-		// Read from fptr_ in to the provided buffer
-		DWORD read;
-		if (!ReadFile(m_handle, start, (m_buffer.size() - (start - base))*sizeof(Elem), &read, nullptr) || read == 0)
-			return traits_type::eof();
-
-		// Set buffer pointers
-		setg(base, start, start + read/sizeof(Elem));
-
-		return traits_type::to_int_type(*gptr());
-	}
-
-private:
-	std::basic_string<Elem, Tr, Alloc> m_buf;
-
-	HANDLE m_handle;
-	const std::size_t m_put_back;
-	std::vector<Elem> m_buffer;
-};
-
-template <class Elem, class Tr = std::char_traits<Elem> >
-class basic_handlestream : public std::basic_istream<Elem, Tr>
-{
-public:
-	basic_handlestream(HANDLE handle) :
-		std::basic_istream<Elem, Tr>(&m_buf),
-		m_buf(handle)
-	{
-	}
-
-private:
-	basic_handlebuf<Elem, Tr> m_buf;
-};
-
-typedef basic_handlestream<char> hstream;
-typedef basic_handlestream<wchar_t> whstream;
+#ifdef _WIN32
 
 Process::Process(const std::wstring& pathName, const std::vector<std::wstring>& args)
 {
@@ -93,15 +37,44 @@ Process::Process(const std::wstring& pathName, const std::vector<std::wstring>&
 		++it;
 	}
 
-	Run(pathName, commandLine);
+	Run(pathName, commandLine, Environment());
 }
 
 Process::Process(const std::wstring& pathName, const std::wstring& args)
 {
-	Run(pathName, args);
+	Run(pathName, args, Environment());
+}
+
+Process::Process(const std::wstring& pathName, const std::wstring& args, const Environment& environment)
+{
+	Run(pathName, args, environment);
+}
+
+std::vector<wchar_t> GetEnvironmentBlock(const Environment& environment)
+{
+	std::vector<wchar_t> block;
+	if (environment.empty())
+		return block;
+
+	auto strings = GetEnvironmentStringsW();
+	for (auto p = strings; *p; p += wcslen(p) + 1)
+	{
+		std::wstring var(p);
+		if (environment.find(var.substr(0, var.find(L'=', 1))) == environment.end())
+			block.insert(block.end(), var.c_str(), var.c_str() + var.size() + 1);
+	}
+	FreeEnvironmentStringsW(strings);
+
+	for (auto it = environment.begin(); it != environment.end(); ++it)
+	{
+		std::wstring var = it->first + L"=" + it->second;
+		block.insert(block.end(), var.c_str(), var.c_str() + var.size() + 1);
+	}
+	block.push_back(L'\0');
+	return block;
 }
 
-void Process::Run(const std::wstring& pathName, const std::wstring& args)
+void Process::Run(const std::wstring& pathName, const std::wstring& args, const Environment& environment)
 {
 	m_name = boost::filesystem::wpath(pathName).filename().wstring();
 
@@ -158,6 +131,7 @@ void Process::Run(const std::wstring& pathName, const std::wstring& args)
 	startupInfo.hStdError = stdOutWr2;
 
 	PROCESS_INFORMATION processInformation;
+	auto environmentBlock = GetEnvironmentBlock(environment);
 
 	if (!CreateProcess(
 		nullptr,
@@ -165,8 +139,8 @@ void Process::Run(const std::wstring& pathName, const std::wstring& args)
 		nullptr,
 		nullptr,
 		true,
-		0,
-		nullptr,
+		CREATE_UNICODE_ENVIRONMENT,
+		environmentBlock.empty() ? nullptr : environmentBlock.data(),
 		nullptr,
 		&startupInfo,
 		&processInformation))
@@ -183,12 +157,12 @@ std::wstring Process::GetName() const
 	return m_name;
 }
 
-HANDLE Process::GetStdIn() const
+FileHandle Process::GetStdIn() const
 {
 	return m_stdIn;
 }
 
-HANDLE Process::GetStdOut() const
+FileHandle Process::GetStdOut() const
 {
 	return m_stdOut;
 }
@@ -228,4 +202,381 @@ void Process::Wait() const
 		ThrowLastError("process exit");
 }
 
+void KillProcess(ProcessHandle hProcess)
+{
+	TerminateProcess(hProcess, static_cast<unsigned>(-1));
+}
+
+#else // !_WIN32
+
+extern "C" char** environ;
+
+// Split a command line the way CommandLineToArgvW() does for the common cases:
+// white space separates arguments, double quotes group and \" is a literal quote.
+std::vector<std::string> SplitCommandLine(const std::string& commandLine)
+{
+	std::vector<std::string> args;
+	std::string arg;
+	bool inArg = false;
+	bool inQuotes = false;
+	for (auto it = commandLine.begin(); it != commandLine.end(); ++it)
+	{
+		if (*it == '\\' && it + 1 != commandLine.end() && it[1] == '"')
+		{
+			arg += '"';
+			++it;
+			inArg = true;
+		}
+		else if (*it == '"')
+		{
+			inQuotes = !inQuotes;
+			inArg = true;
+		}
+		else if (!inQuotes && std::isspace(static_cast<unsigned char>(*it)))
+		{
+			if (inArg)
+				args.push_back(arg);
+			arg.clear();
+			inArg = false;
+		}
+		else
+		{
+			arg += *it;
+			inArg = true;
+		}
+	}
+	if (inArg)
+		args.push_back(arg);
+	return args;
+}
+
+Process::Process(const std::wstring& pathName, const std::vector<std::wstring>& args) :
+	m_pid(0),
+	m_exited(false),
+	m_status(0)
+{
+	Run(pathName, args, Environment(), false, 0, false, 0);
+}
+
+Process::Process(const std::wstring& pathName, const std::wstring& args) :
+	m_pid(0),
+	m_exited(false),
+	m_status(0)
+{
+	Run(pathName, args, Environment());
+}
+
+Process::Process(const std::wstring& pathName, const std::wstring& args, const Environment& environment) :
+	m_pid(0),
+	m_exited(false),
+	m_status(0)
+{
+	Run(pathName, args, environment);
+}
+
+Process::Process(const std::wstring& pathName, const std::wstring& args, const Environment& environment, unsigned channels, bool separateStdErr, std::size_t memoryLimit) :
+	m_pid(0),
+	m_exited(false),
+	m_status(0)
+{
+	std::vector<std::wstring> argv;
+	auto split = SplitCommandLine(WideCharToMultiByte(args));
+	for (auto it = split.begin(); it != split.end(); ++it)
+		argv.push_back(MultiByteToWideChar(*it));
+	Run(pathName, argv, environment, true, channels, separateStdErr, memoryLimit);
+}
+
+Process::~Process()
+{
+	// Collect the exit status of a child that already terminated, never block or throw here:
+	if (m_pid > 0 && !m_exited)
+	{
+		try
+		{
+			Reap(WNOHANG);
+		}
+		catch (std::exception&)
+		{
+		}
+	}
+}
+
+void Process::Run(const std::wstring& pathName, const std::wstring& args, const Environment& environment)
+{
+	std::vector<std::wstring> argv;
+	auto split = SplitCommandLine(WideCharToMultiByte(args));
+	for (auto it = split.begin(); it != split.end(); ++it)
+		argv.push_back(MultiByteToWideChar(*it));
+	Run(pathName, argv, environment, false, 0, false, 0);
+}
+
+std::vector<std::string> GetEnvironmentStrings(const Environment& environment)
+{
+	std::vector<std::string> strings;
+	for (auto p = environ; *p; ++p)
+	{
+		std::string var(*p);
+		if (environment.find(MultiByteToWideChar(var.substr(0, var.find('=')))) == environment.end())
+			strings.push_back(var);
+	}
+
+	for (auto it = environment.begin(); it != environment.end(); ++it)
+		strings.push_back(WideCharToMultiByte(it->first + L"=" + it->second));
+	return strings;
+}
+
+typedef std::vector<std::pair<int, int>> FileDescriptorMap;
+
+// posix_spawn() has no attribute for resource limits: a test process with a memory limit
+// is forked and sets the limit before the exec, so the test code never runs without it.
+// The forked child of a threaded process only makes async-signal-safe calls. An exec
+// that fails sends its errno over a pipe that the exec closes.
+pid_t ForkWithMemoryLimit(const char* path, char* const argv[], char* const envp[], const FileDescriptorMap& fds, bool processGroup, std::size_t memoryLimit)
+{
+	int errorPipe[2];
+	if (pipe2(errorPipe, O_CLOEXEC) != 0)
+		ThrowLastError("pipe");
+	FileDescriptor errorRd(errorPipe[0]);
+	FileDescriptor errorWr(errorPipe[1]);
+
+	rlimit limit = { memoryLimit, memoryLimit };
+	pid_t pid = fork();
+	if (pid < 0)
+		ThrowLastError("fork");
+
+	if (pid == 0)
+	{
+		bool ok = !processGroup || setpgid(0, 0) == 0;
+		for (auto it = fds.begin(); ok && it != fds.end(); ++it)
+			ok = it->first == it->second ? fcntl(it->first, F_SETFD, 0) == 0 : dup2(it->first, it->second) >= 0;
+		if (ok && setrlimit(RLIMIT_AS, &limit) == 0)
+			execve(path, argv, envp);
+		int error = errno;
+		while (write(errorWr, &error, sizeof(error)) < 0 && errno == EINTR)
+		{
+		}
+		_exit(127);
+	}
+
+	// Both sides set the process group, so it exists before either one uses it.
+	if (processGroup)
+		setpgid(pid, pid);
+	errorWr.Close();
+	int error = 0;
+	ssize_t n;
+	while ((n = read(errorRd, &error, sizeof(error))) < 0 && errno == EINTR)
+	{
+	}
+	if (n > 0)
+	{
+		while (waitpid(pid, nullptr, 0) < 0 && errno == EINTR)
+		{
+		}
+		errno = error;
+		ThrowLastError(std::string(path));
+	}
+	return pid;
+}
+
+// Creates a pipe and moves the child end out of the range of the channel file descriptors,
+// so the dup2() of one channel cannot overwrite the pipe of another.
+int CreateChannelPipe(FileDescriptor& parentEnd, bool parentReads, int minFd)
+{
+	int fds[2];
+	if (pipe2(fds, O_CLOEXEC) != 0)
+		ThrowLastError("pipe");
+	parentEnd.Attach(parentReads ? fds[0] : fds[1]);
+	FileDescriptor childEnd(parentReads ? fds[1] : fds[0]);
+	int fd = fcntl(childEnd, F_DUPFD_CLOEXEC, minFd);
+	if (fd < 0)
+		ThrowLastError("fcntl");
+	return fd;
+}
+
+void Process::Run(const std::wstring& pathName, const std::vector<std::wstring>& args, const Environment& environment, bool processGroup, unsigned channels, bool separateStdErr, std::size_t memoryLimit)
+{
+	m_name = boost::filesystem::path(pathName).filename().wstring();
+
+	std::string path = WideCharToMultiByte(pathName);
+	std::vector<std::string> strArgs(1, path);
+	for (auto it = args.begin(); it != args.end(); ++it)
+		strArgs.push_back(WideCharToMultiByte(*it));
+
+	std::vector<char*> argv;
+	for (auto it = strArgs.begin(); it != strArgs.end(); ++it)
+		argv.push_back(&(*it)[0]);
+	argv.push_back(nullptr);
+
+	auto envStrings = GetEnvironmentStrings(environment);
+	std::vector<char*> envp;
+	for (auto it = envStrings.begin(); it != envStrings.end(); ++it)
+		envp.push_back(&(*it)[0]);
+	envp.push_back(nullptr);
+
+	int stdInPipe[2];
+	if (pipe2(stdInPipe, O_CLOEXEC) != 0)
+		ThrowLastError("pipe");
+	FileDescriptor stdInRd(stdInPipe[0]);
+	m_stdIn.Attach(stdInPipe[1]);
+
+	int stdOutPipe[2];
+	if (pipe2(stdOutPipe, O_CLOEXEC) != 0)
+		ThrowLastError("pipe");
+	FileDescriptor stdOutWr(stdOutPipe[1]);
+	m_stdOut.Attach(stdOutPipe[0]);
+
+	FileDescriptor stdErrWr;
+	if (separateStdErr)
+	{
+		int stdErrPipe[2];
+		if (pipe2(stdErrPipe, O_CLOEXEC) != 0)
+			ThrowLastError("pipe");
+		stdErrWr.Attach(stdErrPipe[1]);
+		m_stdErr.Attach(stdErrPipe[0]);
+	}
+
+	FileDescriptorMap fds;
+	fds.push_back(std::make_pair(static_cast<int>(stdInRd), STDIN_FILENO));
+	fds.push_back(std::make_pair(static_cast<int>(stdOutWr), STDOUT_FILENO));
+	fds.push_back(std::make_pair(static_cast<int>(separateStdErr ? stdErrWr : stdOutWr), STDERR_FILENO));
+
+	std::vector<std::unique_ptr<FileDescriptor>> childEnds;
+	int minFd = 3 + 2 * channels;
+	for (unsigned channel = 0; channel < channels; ++channel)
+	{
+		m_channelIn.push_back(std::unique_ptr<FileDescriptor>(new FileDescriptor));
+		childEnds.push_back(std::unique_ptr<FileDescriptor>(new FileDescriptor(CreateChannelPipe(*m_channelIn.back(), false, minFd))));
+		fds.push_back(std::make_pair(static_cast<int>(*childEnds.back()), static_cast<int>(3 + 2 * channel)));
+
+		m_channelOut.push_back(std::unique_ptr<FileDescriptor>(new FileDescriptor));
+		childEnds.push_back(std::unique_ptr<FileDescriptor>(new FileDescriptor(CreateChannelPipe(*m_channelOut.back(), true, minFd))));
+		fds.push_back(std::make_pair(static_cast<int>(*childEnds.back()), static_cast<int>(4 + 2 * channel)));
+	}
+
+	if (memoryLimit > 0)
+	{
+		m_pid = ForkWithMemoryLimit(path.c_str(), argv.data(), envp.data(), fds, processGroup, memoryLimit);
+		return;
+	}
+
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	auto guard = make_guard([&actions]() { posix_spawn_file_actions_destroy(&actions); });
+	for (auto it = fds.begin(); it != fds.end(); ++it)
+		posix_spawn_file_actions_adddup2(&actions, it->first, it->second);
+
+	// A test process may fork its own children, they are killed together with it.
+	posix_spawnattr_t attr;
+	posix_spawnattr_init(&attr);
+	auto attrGuard = make_guard([&attr]() { posix_spawnattr_destroy(&attr); });
+	if (processGroup)
+	{
+		posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP);
+		posix_spawnattr_setpgroup(&attr, 0);
+	}
+
+	int rc = posix_spawn(&m_pid, path.c_str(), &actions, &attr, argv.data(), envp.data());
+	if (rc != 0)
+	{
+		errno = rc;
+		ThrowLastError(pathName);
+	}
+}
+
+std::wstring Process::GetName() const
+{
+	return m_name;
+}
+
+FileHandle Process::GetStdIn() const
+{
+	return m_stdIn;
+}
+
+FileHandle Process::GetStdOut() const
+{
+	return m_stdOut;
+}
+
+FileHandle Process::GetStdErr() const
+{
+	return m_stdErr;
+}
+
+ProcessHandle Process::GetProcessHandle() const
+{
+	return m_pid;
+}
+
+unsigned Process::GetProcessId() const
+{
+	return static_cast<unsigned>(m_pid);
+}
+
+FileHandle Process::GetChannelIn(unsigned channel) const
+{
+	return *m_channelIn.at(channel);
+}
+
+FileHandle Process::GetChannelOut(unsigned channel) const
+{
+	return *m_channelOut.at(channel);
+}
+
+bool Process::Reap(int options) const
+{
+	int status;
+	pid_t rc;
+	do
+		rc = waitpid(m_pid, &status, options);
+	while (rc < 0 && errno == EINTR);
+
+	if (rc < 0)
+		ThrowLastError("process exit");
+	if (rc == 0)
+		return false;
+
+	m_exited = true;
+	m_status = status;
+	return true;
+}
+
+bool Process::IsRunning() const
+{
+	return !m_exited && !Reap(WNOHANG);
+}
+
+void Process::WaitForExit() const
+{
+	if (m_exited)
+		return;
+
+	siginfo_t info;
+	while (waitid(P_PID, m_pid, &info, WEXITED | WNOWAIT) < 0)
+	{
+		if (errno != EINTR)
+			ThrowLastError("process exit");
+	}
+}
+
+void Process::Wait() const
+{
+	if (!m_exited)
+		Reap(0);
+}
+
+void KillProcess(ProcessHandle hProcess)
+{
+	if (hProcess > 0)
+		kill(hProcess, SIGKILL);
+}
+
+void KillProcessGroup(ProcessHandle hProcess)
+{
+	if (hProcess > 0)
+		kill(-hProcess, SIGKILL);
+}
+
+#endif // _WIN32
+
 } // namespace gj
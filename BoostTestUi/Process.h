@@ -10,40 +10,98 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
+#include "hstream.h"
+#ifndef _WIN32
+#include "Utilities.h"
+#endif
 
 namespace gj {
 
+#ifdef _WIN32
+typedef HANDLE ProcessHandle;
+const ProcessHandle NoProcessHandle = nullptr;
+#else
+typedef pid_t ProcessHandle;
+const ProcessHandle NoProcessHandle = 0;
+#endif
+
+// Variables that are added to or replace the inherited environment of the child process
+typedef std::map<std::wstring, std::wstring> Environment;
+
 class Process
 {
 public:
 	Process(const std::wstring& pathName, const std::vector<std::wstring>& args);
 	Process(const std::wstring& pathName, const std::wstring& args);
+	Process(const std::wstring& pathName, const std::wstring& args, const Environment& environment);
+#ifndef _WIN32
+	// Starts the process in a process group of its own with extra pipes: the child reads
+	// channel i from file descriptor 3 + 2 * i and writes channel i to file descriptor 4 + 2 * i.
+	// With separateStdErr, stderr gets a pipe of its own instead of sharing the stdout pipe.
+	// A memoryLimit in bytes limits the address space of the process and its children.
+	Process(const std::wstring& pathName, const std::wstring& args, const Environment& environment, unsigned channels, bool separateStdErr = false, std::size_t memoryLimit = 0);
+	~Process();
+#endif
 
 	std::wstring GetName() const;
-	HANDLE GetStdIn() const;
-	HANDLE GetStdOut() const;
-	HANDLE GetProcessHandle() const;
+	FileHandle GetStdIn() const;
+	FileHandle GetStdOut() const;
+	ProcessHandle GetProcessHandle() const;
+#ifdef _WIN32
 	HANDLE GetThreadHandle() const;
-	unsigned GetProcessId() const;
 	unsigned GetThreadId() const;
+#endif
+	unsigned GetProcessId() const;
+#ifndef _WIN32
+	FileHandle GetChannelIn(unsigned channel) const;
+	FileHandle GetChannelOut(unsigned channel) const;
+	// Returns NoFileHandle when stderr shares the stdout pipe.
+	FileHandle GetStdErr() const;
+#endif
 
 	bool IsRunning() const;
+#ifndef _WIN32
+	// Waits for the process to end without collecting its exit status,
+	// its process id is not reused before Wait() collects it.
+	void WaitForExit() const;
+#endif
 	void Wait() const;
 
 private:
-	void Run(const std::wstring& pathName, const std::wstring& args);
+	void Run(const std::wstring& pathName, const std::wstring& args, const Environment& environment);
 
 	std::wstring m_name;
+#ifdef _WIN32
 	CHandle m_stdIn;
 	CHandle m_stdOut;
 	CHandle m_hProcess;
 	CHandle m_hThread;
 	unsigned m_processId;
 	unsigned m_threadId;
+#else
+	void Run(const std::wstring& pathName, const std::vector<std::wstring>& args, const Environment& environment, bool processGroup, unsigned channels, bool separateStdErr, std::size_t memoryLimit);
+	bool Reap(int options) const;
+
+	FileDescriptor m_stdIn;
+	FileDescriptor m_stdOut;
+	FileDescriptor m_stdErr;
+	std::vector<std::unique_ptr<FileDescriptor>> m_channelIn;
+	std::vector<std::unique_ptr<FileDescriptor>> m_channelOut;
+	pid_t m_pid;
+	mutable bool m_exited;
+	mutable int m_status;
+#endif
 };
 
+void KillProcess(ProcessHandle hProcess);
+#ifndef _WIN32
+void KillProcessGroup(ProcessHandle hProcess);
+#endif
+
 } // namespace gj
 
 #endif // BOOST_TESTUI_PROCESS_H
@@ -0,0 +1,217 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#include "stdafx.h"
+#include "ShardObserver.h"
+
+namespace gj {
+
+ShardMerger::ShardMerger(TestObserver& observer) :
+	m_pObserver(&observer),
+	m_failed(false)
+{
+}
+
+bool ShardMerger::Failed() const
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	return m_failed;
+}
+
+void ShardMerger::SetFailed()
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_failed = true;
+}
+
+void ShardMerger::Post(const TestEvent& event)
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	event(*m_pObserver);
+}
+
+void ShardMerger::Post(const std::vector<TestEvent>& events)
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	for (auto it = events.begin(); it != events.end(); ++it)
+		(*it)(*m_pObserver);
+}
+
+unsigned ShardMerger::QueuedEvents()
+{
+	return m_pObserver->QueuedEvents();
+}
+
+void ShardMerger::SuiteStart(unsigned id)
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	if (m_suites[id]++ == 0)
+		m_pObserver->test_suite_start(id);
+}
+
+void ShardMerger::SuiteFinish(unsigned id, unsigned long elapsed)
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	auto it = m_suites.find(id);
+	if (it == m_suites.end() || --it->second > 0)
+		return;
+
+	m_suites.erase(it);
+	m_pObserver->test_suite_finish(id, elapsed);
+}
+
+ShardObserver::ShardObserver(ShardMerger& merger) :
+	m_pMerger(&merger),
+	m_inTestCase(false),
+	m_testCaseId(0)
+{
+}
+
+void ShardObserver::Post(const TestEvent& event)
+{
+	if (m_inTestCase)
+		m_events.push_back(event);
+	else
+		m_pMerger->Post(event);
+}
+
+void ShardObserver::EndTestCase()
+{
+	m_inTestCase = false;
+	m_pMerger->Post(m_events);
+	m_events.clear();
+}
+
+void ShardObserver::test_message(Severity::type severity, const LogText& msg)
+{
+	LogText text = m_logArena.Store(msg);
+	Post([severity, text](TestObserver& observer) { observer.test_message(severity, text); });
+}
+
+void ShardObserver::test_output(OutputStream::type stream, unsigned sequence, Severity::type severity, const LogText& msg)
+{
+	LogText text = m_logArena.Store(msg);
+	Post([stream, sequence, severity, text](TestObserver& observer) { observer.test_output(stream, sequence, severity, text); });
+}
+
+void ShardObserver::test_waiting(const std::wstring& processName, unsigned processId)
+{
+	Post([processName, processId](TestObserver& observer) { observer.test_waiting(processName, processId); });
+}
+
+void ShardObserver::test_start()
+{
+	Post([](TestObserver& observer) { observer.test_start(); });
+}
+
+// A shard process that ended in the middle of a test case is followed by the
+// ExeRunner ending that test case as crashed.
+void ShardObserver::test_finish()
+{
+	Post([](TestObserver& observer) { observer.test_finish(); });
+}
+
+void ShardObserver::test_aborted()
+{
+	m_pMerger->SetFailed();
+	Post([](TestObserver& observer) { observer.test_aborted(); });
+}
+
+void ShardObserver::test_iteration_start(unsigned /*test_cases_amount*/)
+{
+	// The ExeRunner that runs the shards reports the iterations.
+}
+
+void ShardObserver::test_iteration_finish()
+{
+}
+
+void ShardObserver::test_suite_start(unsigned id)
+{
+	m_pMerger->SuiteStart(id);
+}
+
+void ShardObserver::test_case_start(unsigned id)
+{
+	m_inTestCase = true;
+	m_testCaseId = id;
+	m_events.push_back([id](TestObserver& observer) { observer.test_case_start(id); });
+}
+
+void ShardObserver::test_case_finish(unsigned id, unsigned long elapsed)
+{
+	Post([id, elapsed](TestObserver& observer) { observer.test_case_finish(id, elapsed); });
+	EndTestCase();
+}
+
+void ShardObserver::test_case_finish(unsigned id, unsigned long elapsed, TestCaseState::type state)
+{
+	Post([id, elapsed, state](TestObserver& observer) { observer.test_case_finish(id, elapsed, state); });
+	EndTestCase();
+}
+
+void ShardObserver::test_suite_finish(unsigned id, unsigned long elapsed)
+{
+	m_pMerger->SuiteFinish(id, elapsed);
+}
+
+void ShardObserver::test_unit_skipped(unsigned id)
+{
+	Post([id](TestObserver& observer) { observer.test_unit_skipped(id); });
+}
+
+void ShardObserver::test_unit_aborted(unsigned id)
+{
+	m_pMerger->SetFailed();
+	Post([id](TestObserver& observer) { observer.test_unit_aborted(id); });
+}
+
+void ShardObserver::test_unit_ignored(const std::string& msg)
+{
+	Post([msg](TestObserver& observer) { observer.test_unit_ignored(msg); });
+}
+
+void ShardObserver::assertion_result(bool passed)
+{
+	if (!passed)
+		m_pMerger->SetFailed();
+	Post([passed](TestObserver& observer) { observer.assertion_result(passed); });
+}
+
+void ShardObserver::test_case_assertions(unsigned id, unsigned passed, unsigned failed)
+{
+	Post([id, passed, failed](TestObserver& observer) { observer.test_case_assertions(id, passed, failed); });
+}
+
+void ShardObserver::exception_caught(const std::string& what)
+{
+	m_pMerger->SetFailed();
+	Post([what](TestObserver& observer) { observer.exception_caught(what); });
+}
+
+void ShardObserver::TestStarted()
+{
+}
+
+// The shard ended in the middle of a test case, report it as failed.
+void ShardObserver::TestFinished()
+{
+	if (!m_inTestCase)
+		return;
+
+	unsigned id = m_testCaseId;
+	m_events.push_back([id](TestObserver& observer) { observer.test_case_finish(id, 0, TestCaseState::Failed); });
+	m_pMerger->SetFailed();
+	EndTestCase();
+}
+
+unsigned ShardObserver::QueuedEvents()
+{
+	return m_pMerger->QueuedEvents();
+}
+
+} // namespace gj
@@ -0,0 +1,99 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#ifndef BOOST_TESTUI_SHARDOBSERVER_H
+#define BOOST_TESTUI_SHARDOBSERVER_H
+
+#pragma once
+
+#pragma warning(disable: 4481) // nonstandard extension used: override specifier 'override'
+
+#include <functional>
+#include <map>
+#include <vector>
+#pragma warning(push, 3) // conversion from 'int' to 'unsigned short', possible loss of data
+#include <boost/thread.hpp>
+#pragma warning(pop)
+#include <boost/noncopyable.hpp>
+#include "TestRunner.h"
+
+namespace gj {
+
+typedef std::function<void (TestObserver&)> TestEvent;
+
+// Merges the events of concurrently running shards into one TestObserver.
+// Test suites that run in several shards are reported as started by the
+// first shard and finished by the last one.
+class ShardMerger : boost::noncopyable
+{
+public:
+	explicit ShardMerger(TestObserver& observer);
+
+	bool Failed() const;
+	void SetFailed();
+
+	void Post(const TestEvent& event);
+	void Post(const std::vector<TestEvent>& events);
+	void SuiteStart(unsigned id);
+	void SuiteFinish(unsigned id, unsigned long elapsed);
+	unsigned QueuedEvents();
+
+private:
+	mutable boost::mutex m_mutex;
+	TestObserver* m_pObserver;
+	std::map<unsigned, unsigned> m_suites;
+	bool m_failed;
+};
+
+// Observes one shard. The events of a test case are collected and posted to the
+// ShardMerger as one block when the test case finishes, so the merged observer
+// sees the test cases of different shards one after the other.
+class ShardObserver : public TestObserver
+{
+public:
+	explicit ShardObserver(ShardMerger& merger);
+
+	virtual void test_message(Severity::type severity, const LogText& msg) override;
+	virtual void test_output(OutputStream::type stream, unsigned sequence, Severity::type severity, const LogText& msg) override;
+
+	virtual void test_waiting(const std::wstring& processName, unsigned processId) override;
+	virtual void test_start() override;
+	virtual void test_finish() override;
+	virtual void test_aborted() override;
+	virtual void test_iteration_start(unsigned test_cases_amount) override;
+	virtual void test_iteration_finish() override;
+	virtual void test_suite_start(unsigned id) override;
+	virtual void test_case_start(unsigned id) override;
+	virtual void test_case_finish(unsigned id, unsigned long elapsed) override;
+	virtual void test_case_finish(unsigned id, unsigned long elapsed, TestCaseState::type state) override;
+	virtual void test_suite_finish(unsigned id, unsigned long elapsed) override;
+	virtual void test_unit_skipped(unsigned id) override;
+	virtual void test_unit_aborted(unsigned id) override;
+
+	virtual void test_unit_ignored(const std::string& msg) override;
+	virtual void assertion_result(bool passed) override;
+	virtual void test_case_assertions(unsigned id, unsigned passed, unsigned failed) override;
+	virtual void exception_caught(const std::string& what) override;
+
+	virtual void TestStarted() override;
+	virtual void TestFinished() override;
+	virtual unsigned QueuedEvents() override;
+
+private:
+	void Post(const TestEvent& event);
+	void EndTestCase();
+
+	ShardMerger* m_pMerger;
+	bool m_inTestCase;
+	unsigned m_testCaseId;
+	std::vector<TestEvent> m_events;
+	LogArena m_logArena;
+};
+
+} // namespace gj
+
+#endif // BOOST_TESTUI_SHARDOBSERVER_H
@@ -0,0 +1,134 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#include "stdafx.h"
+#include <algorithm>
+#include <boost/filesystem.hpp>
+#include "Workspace.h"
+#include "TestLoader.h"
+
+namespace gj {
+
+std::unique_ptr<TestRunner> CreateTestRunner(const std::wstring& pathName, TestObserver& observer, LoadCancellation* pCancellation, TestTreeVisitor* pUnits)
+{
+	if (!boost::filesystem::is_directory(pathName))
+		return std::unique_ptr<TestRunner>(new ExeRunner(pathName, observer, std::string(), pCancellation, pUnits));
+
+	std::unique_ptr<TestRunner> pRunner(new Workspace(pathName, observer, 0, pCancellation));
+	if (pUnits)
+		pRunner->TraverseTestTree(*pUnits);
+	return pRunner;
+}
+
+TestLoader::TestLoader(const std::wstring& pathName, TestObserver& observer, const std::function<void ()>& loaded, TestTreeRecording* pUnits) :
+	m_pathName(pathName),
+	m_pUnits(pUnits),
+	m_thread([this, &observer, loaded]() { Load(observer, loaded); })
+{
+}
+
+TestLoader::~TestLoader()
+{
+	m_cancellation.Cancel();
+	m_thread.join();
+}
+
+void TestLoader::Load(TestObserver& observer, const std::function<void ()>& loaded)
+{
+	try
+	{
+		m_pRunner = CreateTestRunner(m_pathName, observer, &m_cancellation, m_pUnits);
+		if (m_pUnits)
+			m_pUnits->Close();
+	}
+	catch (...)
+	{
+		m_error = std::current_exception();
+	}
+	loaded();
+}
+
+const std::wstring& TestLoader::GetPathName() const
+{
+	return m_pathName;
+}
+
+std::unique_ptr<TestRunner> TestLoader::GetRunner()
+{
+	if (m_error)
+		std::rethrow_exception(m_error);
+	return std::move(m_pRunner);
+}
+
+TestTreeRecording::Step::Step() :
+	unit(0, TestUnit::TestSuite, std::string()),
+	leave(true)
+{
+}
+
+TestTreeRecording::Step::Step(const TestUnit& unit) :
+	unit(unit),
+	leave(false)
+{
+}
+
+TestTreeRecording::TestTreeRecording() :
+	m_closed(false),
+	m_next(0)
+{
+}
+
+void TestTreeRecording::VisitTestCase(TestCase& tc)
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_steps.push_back(Step(tc));
+}
+
+void TestTreeRecording::EnterTestSuite(TestSuite& ts)
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_steps.push_back(Step(ts));
+}
+
+void TestTreeRecording::LeaveTestSuite()
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_steps.push_back(Step());
+}
+
+void TestTreeRecording::Close()
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_closed = true;
+}
+
+// The steps are replayed from a copy, so the recording goes on while the view is updated.
+bool TestTreeRecording::Replay(TestTreeVisitor& v, std::size_t count)
+{
+	std::vector<Step> steps;
+	bool complete;
+	{
+		boost::mutex::scoped_lock lock(m_mutex);
+		std::size_t end = std::min(m_next + count, m_steps.size());
+		steps.assign(m_steps.begin() + m_next, m_steps.begin() + end);
+		m_next = end;
+		complete = m_closed && m_next == m_steps.size();
+	}
+
+	for (auto it = steps.begin(); it != steps.end(); ++it)
+	{
+		if (it->leave)
+			v.LeaveTestSuite();
+		else if (it->unit.type == TestUnit::TestCase)
+			v.VisitTestCase(static_cast<TestCase&>(it->unit));
+		else
+			v.EnterTestSuite(static_cast<TestSuite&>(it->unit));
+	}
+	return complete;
+}
+
+} // namespace gj
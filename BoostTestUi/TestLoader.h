@@ -0,0 +1,97 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#ifndef BOOST_TESTUI_TESTLOADER_H
+#define BOOST_TESTUI_TESTLOADER_H
+
+#pragma once
+
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#pragma warning(push, 3) // conversion from 'int' to 'unsigned short', possible loss of data
+#include <boost/thread.hpp>
+#pragma warning(pop)
+#include <boost/noncopyable.hpp>
+#include "TestRunner.h"
+#include "ExeRunner.h"
+
+namespace gj {
+
+// Creates the ExeRunner of a unit test executable or the Workspace of a directory.
+// pUnits receives the test units in tree order, those of an executable while its
+// listing is parsed and those of a workspace when all its executables are listed.
+std::unique_ptr<TestRunner> CreateTestRunner(const std::wstring& pathName, TestObserver& observer, LoadCancellation* pCancellation = nullptr, TestTreeVisitor* pUnits = nullptr);
+
+// Records a traversal of a test tree and replays it in steps, so that a large
+// test tree is added to a view in between the user input. A TestLoader records
+// on its own thread while the view replays what is recorded so far.
+class TestTreeRecording :
+	boost::noncopyable,
+	public TestTreeVisitor
+{
+public:
+	TestTreeRecording();
+
+	virtual void VisitTestCase(TestCase& tc) override;
+	virtual void EnterTestSuite(TestSuite& ts) override;
+	virtual void LeaveTestSuite() override;
+	// Ends the recording when the whole test tree is recorded.
+	void Close();
+
+	// Replays the next count steps that are recorded, returns true when the
+	// recording is closed and the replay is complete.
+	bool Replay(TestTreeVisitor& v, std::size_t count);
+
+private:
+	// A test case, a test suite that is entered or, without a test unit, a test suite that is left.
+	struct Step
+	{
+		Step();
+		explicit Step(const TestUnit& unit);
+
+		TestUnit unit;
+		bool leave;
+	};
+
+	boost::mutex m_mutex;
+	std::vector<Step> m_steps;
+	bool m_closed;
+	std::size_t m_next;
+};
+
+// Creates a test runner on a background thread, so that the listing of a large
+// test executable does not block the user interface. The test units are recorded
+// in pUnits while they are listed, it is closed when the test runner is created.
+// The loaded function is called on that thread when the test runner is created
+// or has failed. Destroying the TestLoader cancels the load.
+class TestLoader : boost::noncopyable
+{
+public:
+	TestLoader(const std::wstring& pathName, TestObserver& observer, const std::function<void ()>& loaded, TestTreeRecording* pUnits = nullptr);
+	~TestLoader();
+
+	const std::wstring& GetPathName() const;
+	// Returns the test runner after loaded() or throws the error of the load.
+	std::unique_ptr<TestRunner> GetRunner();
+
+private:
+	void Load(TestObserver& observer, const std::function<void ()>& loaded);
+
+	std::wstring m_pathName;
+	TestTreeRecording* m_pUnits;
+	LoadCancellation m_cancellation;
+	std::unique_ptr<TestRunner> m_pRunner;
+	std::exception_ptr m_error;
+	boost::thread m_thread;
+};
+
+} // namespace gj
+
+#endif // BOOST_TESTUI_TESTLOADER_H
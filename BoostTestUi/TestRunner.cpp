@@ -6,6 +6,8 @@
 // See http://boosttestui.wordpress.com/ for the boosttestui home page.
 
 #include "stdafx.h"
+#include <sstream>
+#include "EventChannel.h"
 #include "TestRunner.h"
 
 namespace gj {
@@ -43,9 +45,75 @@ std::wstring ArgumentBuilder::BuildPublicArgs(TestRunner& runner, int logLevel,
 	return BuildArgs(runner, logLevel, options);
 }
 
-void ArgumentBuilder::FilterMessage(const std::string& /*msg*/)
+// A test tree from the ListingCache replaces LoadTestUnits(). A builder that keeps
+// state about the test units besides the tree restores it from the tree.
+void ArgumentBuilder::LoadCachedTestUnits(const TestUnitNode& /*node*/)
 {
 }
 
+void ArgumentBuilder::FilterMessage(std::string_view /*msg*/)
+{
+}
+
+// The default shards by selecting a part of the enabled test cases in each shard.
+// A builder for a framework with built-in sharding provides its environment instead.
+bool ArgumentBuilder::GetShardEnvironment(unsigned /*shard*/, unsigned /*shardCount*/, std::map<std::wstring, std::wstring>& /*environment*/) const
+{
+	return false;
+}
+
+// A worker is a resident test process that runs the batches of test cases it
+// reads from stdin. A builder for a framework that has no worker mode returns false.
+bool ArgumentBuilder::BuildWorkerArgs(int /*logLevel*/, unsigned /*options*/, std::wstring& /*args*/)
+{
+	return false;
+}
+
+std::string ArgumentBuilder::GetWorkerBatch(const std::vector<unsigned>& ids)
+{
+	std::ostringstream batch;
+	for (auto it = ids.begin(); it != ids.end(); ++it)
+		batch << *it << '\n';
+	batch << '\n';
+	return batch.str();
+}
+
+// A zygote initializes the test process once and forks the workers from it.
+// The gui headers that support workers also support --gui_zygote.
+bool ArgumentBuilder::BuildZygoteArgs(int logLevel, unsigned options, unsigned workers, std::wstring& args)
+{
+	if (!BuildWorkerArgs(logLevel, options, args))
+		return false;
+
+	std::wostringstream zygoteArgs;
+	zygoteArgs << args << L" --gui_zygote=" << workers;
+	args = zygoteArgs.str();
+	return true;
+}
+
+// The gui headers that support workers also repeat the test run in the same process
+// with --gui_repeat, each run is a test iteration. 0 repeats until a test fails.
+bool ArgumentBuilder::GetRepeatArg(unsigned /*iterations*/, std::wstring& /*arg*/) const
+{
+	return false;
+}
+
+// A builder whose gui header writes the test events to an event channel returns true.
+// Once the header opened the channel, the test output goes to GetSeverity() instead of FilterMessage().
+bool ArgumentBuilder::HasEventChannel() const
+{
+	return false;
+}
+
+unsigned ArgumentBuilder::GetEventUnitId(const ClientEvent& event)
+{
+	return event.id;
+}
+
+Severity::type ArgumentBuilder::GetSeverity(std::string_view /*msg*/) const
+{
+	return Severity::Info;
+}
+
 } // namespace gj
 
@@ -10,10 +10,15 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 #include "TestCaseState.h"
 #include "Severity.h"
+#include "OutputStream.h"
+#include "LogArena.h"
 
 namespace gj {
 
@@ -75,7 +80,11 @@ public:
 class TestObserver
 {
 public:
-	virtual void test_message(Severity::type severity, const std::string& msg) = 0;
+	// The message may be a view of transient text, an observer that keeps it stores it in a LogArena.
+	virtual void test_message(Severity::type severity, const LogText& msg) = 0;
+	// A line of test output. The sequence numbers the lines of all streams of
+	// a test process in the order they were read.
+	virtual void test_output(OutputStream::type stream, unsigned sequence, Severity::type severity, const LogText& msg) = 0;
 
 	virtual void test_waiting(const std::wstring& processName, unsigned processId) = 0;
 	virtual void test_start() = 0;
@@ -93,10 +102,14 @@ public:
 
 	virtual void test_unit_ignored(const std::string& msg) = 0;
 	virtual void assertion_result(bool passed) = 0;
+	virtual void test_case_assertions(unsigned id, unsigned passed, unsigned failed) = 0;
 	virtual void exception_caught(const std::string& what) = 0;
 
 	virtual void TestStarted() = 0;
 	virtual void TestFinished() = 0;
+	// The number of events that are not handled yet. A repeated test run
+	// waits for the observer to catch up before it starts an iteration.
+	virtual unsigned QueuedEvents() = 0;
 
 protected:
 	~TestObserver();
@@ -109,6 +122,10 @@ struct TestRunner
 		Randomize = 1 << 0,
 		WaitForDebugger = 1 << 1,
 		Repeat = 1 << 2,
+		Parallel = 1 << 3,
+		Resident = 1 << 4,
+		Isolate = 1 << 5,
+		Zygote = 1 << 6,
 	};
 	virtual TestSuite& RootTestSuite() = 0;
 	virtual void TraverseTestTree(TestTreeVisitor& v) = 0;
@@ -130,16 +147,29 @@ struct TestRunner
 	virtual ~TestRunner();
 };
 
+class ExeRunner;
+struct ClientEvent;
+
 struct ArgumentBuilder
 {
+	virtual std::unique_ptr<ArgumentBuilder> Clone(ExeRunner& runner, TestObserver& observer) const = 0;
 	virtual std::wstring GetExePathName() = 0;
 	virtual std::wstring GetListArg() = 0;
 	virtual void LoadTestUnits(TestUnitNode& node, std::istream& is, const std::string& testName) = 0;
+	virtual void LoadCachedTestUnits(const TestUnitNode& node);
 
 	virtual unsigned GetEnabledOptions(unsigned options) const = 0;
 	virtual std::wstring BuildArgs(TestRunner& runner, int logLevel, unsigned& options) = 0;
 	virtual std::wstring BuildPublicArgs(TestRunner& runner, int logLevel, unsigned options);
-	virtual void FilterMessage(const std::string& msg);
+	virtual void FilterMessage(std::string_view msg);
+	virtual bool GetShardEnvironment(unsigned shard, unsigned shardCount, std::map<std::wstring, std::wstring>& environment) const;
+	virtual bool BuildWorkerArgs(int logLevel, unsigned options, std::wstring& args);
+	virtual std::string GetWorkerBatch(const std::vector<unsigned>& ids);
+	virtual bool BuildZygoteArgs(int logLevel, unsigned options, unsigned workers, std::wstring& args);
+	virtual bool GetRepeatArg(unsigned iterations, std::wstring& arg) const;
+	virtual bool HasEventChannel() const;
+	virtual unsigned GetEventUnitId(const ClientEvent& event);
+	virtual Severity::type GetSeverity(std::string_view msg) const;
 
 	virtual ~ArgumentBuilder();
 };
@@ -0,0 +1,111 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#include "stdafx.h"
+#include <algorithm>
+#include <random>
+#include "TestScheduler.h"
+
+namespace gj {
+
+TestScheduler::TestScheduler(const std::vector<unsigned>& testCases, const TestDurations& durations, unsigned workerCount, bool randomize) :
+	m_queue(testCases.begin(), testCases.end()),
+	m_durations(durations),
+	m_defaultDuration(0),
+	m_workerCount(std::max(1u, workerCount)),
+	m_canceled(false)
+{
+	// Test cases that did not run before are assumed to take the average time.
+	unsigned long total = 0;
+	unsigned count = 0;
+	for (auto it = testCases.begin(); it != testCases.end(); ++it)
+	{
+		auto d = m_durations.find(*it);
+		if (d != m_durations.end())
+		{
+			total += d->second;
+			++count;
+		}
+	}
+	if (count > 0)
+		m_defaultDuration = total / count;
+
+	if (randomize)
+		std::shuffle(m_queue.begin(), m_queue.end(), std::mt19937(std::random_device()()));
+	else
+		std::stable_sort(m_queue.begin(), m_queue.end(), [this](unsigned a, unsigned b) { return GetWeight(a) > GetWeight(b); });
+}
+
+bool TestScheduler::Empty() const
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	return m_queue.empty();
+}
+
+unsigned TestScheduler::Remaining() const
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	return m_queue.size();
+}
+
+// The weight of a test case is its expected duration plus one, so batches of
+// test cases that take no measurable time are sized by their count.
+unsigned long TestScheduler::GetWeight(unsigned id) const
+{
+	auto it = m_durations.find(id);
+	return (it == m_durations.end() ? m_defaultDuration : it->second) + 1;
+}
+
+// Guided self-scheduling: each batch takes about 1/(2 * workers) of the remaining work.
+std::vector<unsigned> TestScheduler::NextBatch()
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+
+	unsigned long remaining = 0;
+	for (auto it = m_queue.begin(); it != m_queue.end(); ++it)
+		remaining += GetWeight(*it);
+
+	unsigned long target = remaining / (2 * m_workerCount);
+	unsigned long weight = 0;
+	std::vector<unsigned> batch;
+	while (!m_queue.empty() && (batch.empty() || weight + GetWeight(m_queue.front()) <= target))
+	{
+		weight += GetWeight(m_queue.front());
+		batch.push_back(m_queue.front());
+		m_queue.pop_front();
+	}
+	return batch;
+}
+
+// Test cases of a batch that a worker did not get to go back to the front of the queue.
+void TestScheduler::Requeue(const std::vector<unsigned>& testCases)
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	if (!m_canceled)
+		m_queue.insert(m_queue.begin(), testCases.begin(), testCases.end());
+}
+
+void TestScheduler::TestCaseFinished(unsigned id, unsigned long elapsed)
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_durations[id] = elapsed;
+}
+
+void TestScheduler::Cancel()
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_canceled = true;
+	m_queue.clear();
+}
+
+TestDurations TestScheduler::GetDurations() const
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	return m_durations;
+}
+
+} // namespace gj
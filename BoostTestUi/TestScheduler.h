@@ -0,0 +1,56 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#ifndef BOOST_TESTUI_TESTSCHEDULER_H
+#define BOOST_TESTUI_TESTSCHEDULER_H
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <vector>
+#pragma warning(push, 3) // conversion from 'int' to 'unsigned short', possible loss of data
+#include <boost/thread.hpp>
+#pragma warning(pop)
+#include <boost/noncopyable.hpp>
+
+namespace gj {
+
+typedef std::map<unsigned, unsigned long> TestDurations;
+
+// Hands out the test cases of a parallel run in batches to the worker processes
+// that ask for more work. The test cases that took longest in earlier runs go
+// first and the batches get smaller as the queue runs empty, so the workers
+// finish at about the same time.
+class TestScheduler : boost::noncopyable
+{
+public:
+	TestScheduler(const std::vector<unsigned>& testCases, const TestDurations& durations, unsigned workerCount, bool randomize);
+
+	bool Empty() const;
+	unsigned Remaining() const;
+	std::vector<unsigned> NextBatch();
+	void Requeue(const std::vector<unsigned>& testCases);
+	void TestCaseFinished(unsigned id, unsigned long elapsed);
+	void Cancel();
+
+	TestDurations GetDurations() const;
+
+private:
+	unsigned long GetWeight(unsigned id) const;
+
+	mutable boost::mutex m_mutex;
+	std::deque<unsigned> m_queue;
+	TestDurations m_durations;
+	unsigned long m_defaultDuration;
+	unsigned m_workerCount;
+	bool m_canceled;
+};
+
+} // namespace gj
+
+#endif // BOOST_TESTUI_TESTSCHEDULER_H
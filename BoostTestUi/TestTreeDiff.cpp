@@ -0,0 +1,149 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#include "stdafx.h"
+#include <string>
+#include <boost/noncopyable.hpp>
+#include "TestTreeDiff.h"
+
+namespace gj {
+
+// A Workspace visits the test trees of its executables without its own root test suite.
+class TestTreeCopier :
+	boost::noncopyable,
+	public TestTreeVisitor
+{
+public:
+	explicit TestTreeCopier(TestUnitNode& tree) :
+		m_nodes(1, &tree)
+	{
+	}
+
+	virtual void VisitTestCase(TestCase& tc) override
+	{
+		m_nodes.back()->children.push_back(TestUnitNode(tc));
+	}
+
+	virtual void EnterTestSuite(TestSuite& ts) override
+	{
+		TestUnitNode& parent = *m_nodes.back();
+		if (m_nodes.size() == 1 && ts.id == parent.data.id)
+		{
+			parent.data = ts;
+			m_nodes.push_back(&parent);
+			return;
+		}
+
+		parent.children.push_back(TestUnitNode(ts));
+		m_nodes.push_back(&m_nodes.back()->children.back());
+	}
+
+	virtual void LeaveTestSuite() override
+	{
+		m_nodes.pop_back();
+	}
+
+private:
+	std::vector<TestUnitNode*> m_nodes;
+};
+
+TestUnitNode GetTestTree(TestRunner& runner)
+{
+	TestUnitNode tree(runner.RootTestSuite());
+	TestTreeCopier copier(tree);
+	runner.TraverseTestTree(copier);
+	return tree;
+}
+
+namespace {
+
+enum Match { Unmatched, Unchanged, Renamed };
+
+void DiffTestUnits(const TestUnitNode& oldNode, const TestUnitNode& newNode, TestTreeDiff& diff)
+{
+	const std::vector<TestUnitNode>& oldChildren = oldNode.children;
+	const std::vector<TestUnitNode>& newChildren = newNode.children;
+
+	// The first of equally named test units is matched, the others are new.
+	std::map<std::string, std::size_t> index;
+	for (std::size_t i = 0; i < newChildren.size(); ++i)
+		index.insert(std::make_pair(newChildren[i].data.name, i));
+
+	std::vector<const TestUnitNode*> matches(newChildren.size());
+	std::vector<Match> match(newChildren.size(), Unmatched);
+	std::vector<bool> oldMatched(oldChildren.size());
+	for (std::size_t i = 0; i < oldChildren.size(); ++i)
+	{
+		auto it = index.find(oldChildren[i].data.name);
+		if (it == index.end() || match[it->second] != Unmatched || newChildren[it->second].data.type != oldChildren[i].data.type)
+			continue;
+
+		matches[it->second] = &oldChildren[i];
+		match[it->second] = Unchanged;
+		oldMatched[i] = true;
+	}
+
+	// An unmatched new test unit in the place of an unmatched old test unit of
+	// the same type, after the same matched test unit, is the old one renamed.
+	std::size_t next = 0;
+	for (std::size_t i = 0; i < newChildren.size(); ++i)
+	{
+		if (match[i] == Unmatched && next < oldChildren.size() && !oldMatched[next] && newChildren[i].data.type == oldChildren[next].data.type)
+		{
+			matches[i] = &oldChildren[next];
+			match[i] = Renamed;
+			oldMatched[next] = true;
+		}
+		if (match[i] != Unmatched)
+			next = matches[i] - oldChildren.data() + 1;
+	}
+
+	for (std::size_t i = 0; i < oldChildren.size(); ++i)
+	{
+		if (!oldMatched[i])
+			diff.removed.push_back(oldChildren[i].data.id);
+	}
+
+	for (std::size_t i = 0; i < newChildren.size(); ++i)
+	{
+		const TestUnitNode& node = newChildren[i];
+		switch (match[i])
+		{
+		case Unmatched:
+		{
+			TestTreeDiff::Insertion insertion = { node.data.id, newNode.data.id, i > 0 ? newChildren[i - 1].data.id : 0, i == 0 };
+			diff.added.push_back(insertion);
+			break;
+		}
+
+		case Unchanged:
+			diff.unchanged[matches[i]->data.id] = node.data.id;
+			DiffTestUnits(*matches[i], node, diff);
+			break;
+
+		case Renamed:
+			diff.renamed[matches[i]->data.id] = node.data.id;
+			DiffTestUnits(*matches[i], node, diff);
+			break;
+		}
+	}
+}
+
+} // namespace
+
+TestTreeDiff DiffTestTrees(const TestUnitNode& oldTree, const TestUnitNode& newTree)
+{
+	TestTreeDiff diff;
+	if (oldTree.data.name == newTree.data.name)
+		diff.unchanged[oldTree.data.id] = newTree.data.id;
+	else
+		diff.renamed[oldTree.data.id] = newTree.data.id;
+	DiffTestUnits(oldTree, newTree, diff);
+	return diff;
+}
+
+} // namespace gj
@@ -0,0 +1,53 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#ifndef BOOST_TESTUI_TESTTREEDIFF_H
+#define BOOST_TESTUI_TESTTREEDIFF_H
+
+#pragma once
+
+#include <map>
+#include <vector>
+#include "TestRunner.h"
+
+namespace gj {
+
+// A copy of the test tree of runner, with the ids that the runner uses.
+TestUnitNode GetTestTree(TestRunner& runner);
+
+// The changes between two listings of a test tree, such as before and after
+// a rebuild of the test executable. The ids of a test unit may differ between
+// the listings, so the test units are matched by full name: the children of a
+// matched test suite by their name.
+struct TestTreeDiff
+{
+	// A new test unit whose parent is matched. Its test units are all new.
+	// It goes after the previousId test unit or it is the first child of parentId.
+	struct Insertion
+	{
+		unsigned id;
+		unsigned parentId;
+		unsigned previousId;
+		bool first;
+	};
+
+	// Maps the old id of an unchanged test unit to its new id.
+	std::map<unsigned, unsigned> unchanged;
+	// Maps the old id of a renamed test unit to its new id. A renamed test unit
+	// is a removed test unit of the same type at the same place as a new one.
+	std::map<unsigned, unsigned> renamed;
+	// The old ids of the removed test units, without their test units.
+	std::vector<unsigned> removed;
+	// The new test units, in test tree order.
+	std::vector<Insertion> added;
+};
+
+TestTreeDiff DiffTestTrees(const TestUnitNode& oldTree, const TestUnitNode& newTree);
+
+} // namespace gj
+
+#endif // BOOST_TESTUI_TESTTREEDIFF_H
@@ -33,7 +33,8 @@ END_MSG_MAP()
 CTreeView::CTreeView(CMainFrame& mainFrame) :
 	m_pMainFrame(&mainFrame),
 	m_hCurrentItem(nullptr),
-	m_runIndex(0)
+	m_runIndex(0),
+	m_hInsertAfter(TVI_LAST)
 {
 }
 
@@ -182,7 +183,11 @@ LRESULT CTreeView::OnCustomDraw(NMHDR* pnmh)
 LRESULT CTreeView::OnGetInfoTip(NMHDR* pnmh)
 {
 	NMTVGETINFOTIP* pNmGetInfoTip = reinterpret_cast<NMTVGETINFOTIP*>(pnmh);
-	std::wstring tooltip = WStr(m_pMainFrame->GetTestItem(GetItemData(pNmGetInfoTip->hItem)).fullName).str();
+	unsigned id = GetItemData(pNmGetInfoTip->hItem);
+	std::wstring tooltip = WStr(m_pMainFrame->GetTestItem(id).fullName).str();
+	auto it = m_assertions.find(id);
+	if (it != m_assertions.end())
+		tooltip += (wstringbuilder() << L": " << it->second.passed << L" assertions passed, " << it->second.failed << L" failed").str();
 	size_t maxSize = pNmGetInfoTip->cchTextMax;
 	if (tooltip.size() + 1 > maxSize)
 		tooltip = tooltip.substr(maxSize - 4) + L"...";
@@ -299,28 +304,35 @@ void CTreeView::ResetTreeImages()
 void CTreeView::Clear()
 {
 	DeleteAllItems();
+	m_items.clear();
+	m_assertions.clear();
 	m_parents.clear();
 	m_parents.push_back(TVI_ROOT);
+	m_hInsertAfter = TVI_LAST;
 	m_depth = 0;
 	m_levels.clear();
 	m_levels.push_back(0);
 }
 
-void CTreeView::AddTestCase(unsigned id, const std::string& name, bool check)
+HTREEITEM CTreeView::InsertTestItem(unsigned id, const std::string& name, bool check)
 {
-	HTREEITEM hItem = InsertItem(WStr(name), m_iEmpty, m_iEmpty, m_parents.back(), TVI_LAST);
+	HTREEITEM hItem = InsertItem(WStr(name), m_iEmpty, m_iEmpty, m_parents.back(), m_hInsertAfter);
+	m_hInsertAfter = TVI_LAST;
 	SetItemData(hItem, id);
 	SetCheckState(hItem, check);
 	m_items[id] = hItem;
+	return hItem;
+}
+
+void CTreeView::AddTestCase(unsigned id, const std::string& name, bool check)
+{
+	InsertTestItem(id, name, check);
 	++m_levels[m_depth];
 }
 
 void CTreeView::EnterTestSuite(unsigned id, const std::string& name, bool check)
 {
-	HTREEITEM hItem = InsertItem(WStr(name), m_iEmpty, m_iEmpty, m_parents.back(), TVI_LAST);
-	SetItemData(hItem, id);
-	SetCheckState(hItem, check);
-	m_items[id] = hItem;
+	HTREEITEM hItem = InsertTestItem(id, name, check);
 
 	m_parents.push_back(hItem);
 	++m_levels[m_depth];
@@ -360,6 +372,61 @@ void CTreeView::LeaveTestSuite()
 	--m_depth;
 }
 
+void CTreeView::BeginInsert(unsigned parentId, unsigned previousId, bool first)
+{
+	// The root test suite of a Workspace has no tree item.
+	auto it = m_items.find(parentId);
+	m_parents.clear();
+	m_parents.push_back(it == m_items.end() ? TVI_ROOT : it->second);
+
+	it = m_items.find(previousId);
+	m_hInsertAfter = first ? TVI_FIRST : it == m_items.end() ? TVI_LAST : it->second;
+}
+
+void CTreeView::RemoveTestItem(unsigned id)
+{
+	auto it = m_items.find(id);
+	if (it == m_items.end())
+		return;
+
+	if (m_hCurrentItem == it->second)
+		m_hCurrentItem = nullptr;
+	DeleteItem(it->second);
+	m_items.erase(it);
+}
+
+// A renamed test unit is another test, its result is cleared.
+void CTreeView::RenameTestItem(unsigned id, const std::string& name)
+{
+	auto it = m_items.find(id);
+	if (it == m_items.end())
+		return;
+
+	SetItemText(it->second, WStr(name));
+	SetItemImage(it->second, m_iEmpty);
+	m_assertions.erase(id);
+}
+
+void CTreeView::RemapTestItems(const std::map<unsigned, unsigned>& ids)
+{
+	std::map<unsigned, HTREEITEM> items;
+	std::map<unsigned, AssertionCount> assertions;
+	for (auto it = m_items.begin(); it != m_items.end(); ++it)
+	{
+		auto id = ids.find(it->first);
+		if (id == ids.end())
+			continue;
+
+		SetItemData(it->second, id->second);
+		items[id->second] = it->second;
+		auto assertion = m_assertions.find(it->first);
+		if (assertion != m_assertions.end())
+			assertions[id->second] = assertion->second;
+	}
+	m_items.swap(items);
+	m_assertions.swap(assertions);
+}
+
 void ExpandTreeViewItem(CTreeViewCtrl& treeView, HTREEITEM item, bool expand)
 {
 	treeView.Expand(item, expand ? TVE_EXPAND : TVE_COLLAPSE);
@@ -531,6 +598,11 @@ void CTreeView::EndTestCase(unsigned id, TestCaseState::type state)
 	}
 }
 
+void CTreeView::SetAssertionCount(unsigned id, const AssertionCount& count)
+{
+	m_assertions[id] = count;
+}
+
 void CTreeView::EndTestSuite(unsigned id)
 {
 	auto it = m_items.find(id);
@@ -25,6 +25,17 @@ struct TreeViewItemState
 	bool expand;
 };
 
+struct AssertionCount
+{
+	AssertionCount(unsigned passed = 0, unsigned failed = 0) :
+		passed(passed), failed(failed)
+	{
+	}
+
+	unsigned passed;
+	unsigned failed;
+};
+
 typedef CWinTraitsOR<TVS_HASLINES | TVS_HASBUTTONS | TVS_LINESATROOT | TVS_SHOWSELALWAYS | TVS_INFOTIP> CTreeViewTraits;
 
 class CTreeView :
@@ -47,6 +58,15 @@ public:
 	void LeaveTestSuite();
 	void ExpandToView();
 
+	// Updates the tree to a new listing of the test tree.
+	// The test units that follow BeginInsert() are inserted after the previousId
+	// test unit or as the first child of parentId.
+	void BeginInsert(unsigned parentId, unsigned previousId, bool first);
+	void RemoveTestItem(unsigned id);
+	void RenameTestItem(unsigned id, const std::string& name);
+	// Maps the old ids of the kept test items to their new ids, the other test items are dropped.
+	void RemapTestItems(const std::map<unsigned, unsigned>& ids);
+
 	TreeViewItemState GetTestItemState(unsigned id) const;
 	void SetTestItemState(unsigned id, const TreeViewItemState& state);
 	bool IsExpanded(unsigned id) const;
@@ -66,6 +86,7 @@ public:
 	void BeginTestSuite(unsigned id);
 	void BeginTestCase(unsigned id);
 	void EndTestCase(unsigned id, TestCaseState::type state);
+	void SetAssertionCount(unsigned id, const AssertionCount& count);
 	void EndTestSuite(unsigned id);
 
 	void OnTestStart();
@@ -85,6 +106,7 @@ private:
 	LRESULT OnClick(NMHDR* pnmh);
 	LRESULT OnRClick(NMHDR* pnmh);
 
+	HTREEITEM InsertTestItem(unsigned id, const std::string& name, bool check);
 	void ExpandToDepth(HTREEITEM hItem, int depth);
 	void CheckSubTreeItems(HTREEITEM hItem, bool check);
 	void UncheckTreeItem(HTREEITEM hItem);
@@ -112,9 +134,11 @@ private:
 	int m_runIndex;
 	HTREEITEM m_hCurrentItem;
 	std::vector<HTREEITEM> m_parents;
+	HTREEITEM m_hInsertAfter;
 	std::vector<int> m_levels;
 	int m_depth;
 	std::map<unsigned, HTREEITEM> m_items;
+	std::map<unsigned, AssertionCount> m_assertions;
 };
 
 } // namespace gj
@@ -9,6 +9,12 @@
 #include <vector>
 #include <iterator>
 #include <memory>
+#ifndef _WIN32
+#include <cerrno>
+#include <ctime>
+#include <codecvt>
+#include <locale>
+#endif
 #include <boost/system/system_error.hpp>
 #include "Utilities.h"
 
@@ -37,6 +43,8 @@ std::string Quote(const std::string& s)
 	return "\"" + s + "\"";
 }
 
+#ifdef _WIN32
+
 std::wstring LoadString(int id)
 {
 	CString cs;
@@ -81,6 +89,27 @@ std::string WideCharToMultiByte(const std::wstring& str)
 	return WideCharToMultiByte(str.c_str(), str.size());
 }
 
+#else // !_WIN32
+
+// wchar_t holds UTF-32 code points on POSIX, process output and file names are UTF-8:
+typedef std::wstring_convert<std::codecvt_utf8<wchar_t>> Utf8Converter;
+
+std::wstring MultiByteToWideChar(const std::string& str)
+{
+	Utf8Converter conv;
+	return conv.from_bytes(str);
+}
+
+std::string WideCharToMultiByte(const std::wstring& str)
+{
+	Utf8Converter conv;
+	return conv.to_bytes(str);
+}
+
+#endif // _WIN32
+
+#ifdef _WIN32
+
 void ThrowWin32Error(DWORD error, const std::string& what)
 {
 	throw boost::system::system_error(error, boost::system::system_category(), what);
@@ -102,11 +131,36 @@ void CheckHr(HRESULT hr)
 		ThrowWin32Error(hr);
 }
 
+#else // !_WIN32
+
+void FileDescriptor::Close()
+{
+	if (m_fd >= 0)
+		::close(m_fd);
+	m_fd = -1;
+}
+
+void ThrowLastError(const std::string& what)
+{
+	throw boost::system::system_error(errno, boost::system::system_category(), what);
+}
+
+void ThrowLastError(const std::wstring& what)
+{
+	ThrowLastError(WideCharToMultiByte(what));
+}
+
+#endif // _WIN32
+
 Timer::Timer()
 {
+#ifdef _WIN32
 	LARGE_INTEGER li;
 	QueryPerformanceFrequency(&li);
 	m_timerUnit = 1./li.QuadPart;
+#else
+	m_timerUnit = 1e-9;
+#endif
 	Reset();
 }
 
@@ -122,11 +176,19 @@ double Timer::Get() const
 
 long long Timer::GetTicks() const
 {
+#ifdef _WIN32
 	LARGE_INTEGER li;
 	QueryPerformanceCounter(&li);
 	return li.QuadPart;
+#else
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec*1000000000LL + ts.tv_nsec;
+#endif
 }
 
+#ifdef _WIN32
+
 class RichEditStream
 {
 public:
@@ -260,4 +322,6 @@ void CopyToClipboard(const std::wstring& text, HWND owner)
 	}
 }
 
+#endif // _WIN32
+
 } // namespace gj
@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <string>
 #include <sstream>
 #include <boost/noncopyable.hpp>
 
@@ -18,7 +19,9 @@ namespace gj {
 std::string Chomp(std::string s);
 std::wstring Chomp(std::wstring s);
 std::string Quote(const std::string& s);
+#ifdef _WIN32
 std::wstring LoadString(int id);
+#endif
 
 std::wstring MultiByteToWideChar(const std::string& str);
 std::string WideCharToMultiByte(const std::wstring& str);
@@ -102,6 +105,8 @@ private:
 	long long m_offset;
 };
 
+#ifdef _WIN32
+
 class ScopedCursor : boost::noncopyable
 {
 public:
@@ -139,9 +144,50 @@ private:
 };
 
 void ThrowWin32Error(DWORD error, const std::string& what = "");
+void CheckHr(HRESULT hr);
+
+#else // !_WIN32
+
+class FileDescriptor : boost::noncopyable
+{
+public:
+	explicit FileDescriptor(int fd = -1) : m_fd(fd)
+	{
+	}
+
+	~FileDescriptor()
+	{
+		Close();
+	}
+
+	void Attach(int fd)
+	{
+		Close();
+		m_fd = fd;
+	}
+
+	int Detach()
+	{
+		int fd = m_fd;
+		m_fd = -1;
+		return fd;
+	}
+
+	void Close();
+
+	operator int() const
+	{
+		return m_fd;
+	}
+
+private:
+	int m_fd;
+};
+
+#endif // _WIN32
+
 void ThrowLastError(const std::string& what);
 void ThrowLastError(const std::wstring& what);
-void CheckHr(HRESULT hr);
 
 template <typename F>
 class scope_guard : boost::noncopyable
@@ -229,6 +275,8 @@ private:
 typedef basic_stringbuilder<char> stringbuilder;
 typedef basic_stringbuilder<wchar_t> wstringbuilder;
 
+#ifdef _WIN32
+
 DWORD SetRichEditData(CRichEditCtrl& ctrl, DWORD format, const BYTE* pData, size_t len);
 DWORD SetRichEditData(CRichEditCtrl& ctrl, DWORD format, LPWSTR resourcedId);
 
@@ -237,6 +285,8 @@ std::wstring GetDlgItemText(const CWindow& wnd, int idc);
 void CopyToClipboard(const std::string& text, HWND owner);
 void CopyToClipboard(const std::wstring& text, HWND owner);
 
+#endif // _WIN32
+
 } // namespace gj
 
 #endif // BOOST_TESTUI_UTILITIES_H
@@ -0,0 +1,587 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#include "stdafx.h"
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <stdexcept>
+#include <boost/filesystem.hpp>
+#ifdef _WIN32
+#include <boost/algorithm/string/predicate.hpp>
+#endif
+#include "Utilities.h"
+#include "GetUnitTestType.h"
+#include "ExeRunner.h"
+#include "Workspace.h"
+
+namespace gj {
+
+namespace fs = boost::filesystem;
+
+bool IsExecutableFile(const fs::path& path, const fs::file_status& status)
+{
+	if (status.type() != fs::regular_file)
+		return false;
+
+#ifdef _WIN32
+	// NUnit test assemblies are dlls.
+	std::wstring extension = path.extension().wstring();
+	return boost::algorithm::iequals(extension, L".exe") || boost::algorithm::iequals(extension, L".dll");
+#else // !_WIN32
+	// Shared libraries are often executable too: skip lib.so and lib.so.1.2
+	std::string name = path.filename().string();
+	auto pos = name.find(".so");
+	if (pos != std::string::npos && (pos + 3 == name.size() || name[pos + 3] == '.'))
+		return false;
+	return (status.permissions() & fs::owner_exe) != 0;
+#endif
+}
+
+std::vector<std::wstring> FindExecutableFiles(const std::wstring& directory)
+{
+	if (!fs::is_directory(directory))
+		throw std::runtime_error(WideCharToMultiByte(directory) + " is not a directory");
+
+	std::vector<std::wstring> files;
+	for (fs::recursive_directory_iterator it(directory), end; it != end; ++it)
+	{
+		// Symbolic links are not followed, a linked executable is found under its own name.
+		fs::file_status status = it->symlink_status();
+		if (status.type() == fs::directory_file)
+		{
+			if (it->path().filename().string()[0] == '.')
+				it.no_push();
+		}
+		else if (IsExecutableFile(it->path(), status))
+			files.push_back(it->path().wstring());
+	}
+	std::sort(files.begin(), files.end());
+	return files;
+}
+
+// Calls f(0) .. f(count - 1) on at most jobs threads, including the calling thread.
+template <typename F>
+void ParallelFor(std::size_t count, unsigned jobs, F f)
+{
+	std::atomic<std::size_t> next(0);
+	auto worker = [&]()
+	{
+		for (std::size_t i = next++; i < count; i = next++)
+			f(i);
+	};
+
+	boost::thread_group threads;
+	for (std::size_t i = 1; i < std::min<std::size_t>(jobs, count); ++i)
+		threads.create_thread(worker);
+	worker();
+	threads.join_all();
+}
+
+// Finds the highest test unit id and counts the enabled test cases.
+class MaxIdVisitor : public TestTreeVisitor
+{
+public:
+	MaxIdVisitor() : maxId(0), testCases(0)
+	{
+	}
+
+	virtual void VisitTestCase(TestCase& tc) override
+	{
+		maxId = std::max(maxId, tc.id);
+		if (tc.enabled)
+			++testCases;
+	}
+
+	virtual void EnterTestSuite(TestSuite& ts) override
+	{
+		maxId = std::max(maxId, ts.id);
+	}
+
+	unsigned maxId;
+	unsigned testCases;
+};
+
+// Passes copies of the test units of one executable with their workspace ids to
+// the visitor. Changes of the visitor to enabled or active are copied back.
+class OffsetVisitor : public TestTreeVisitor
+{
+public:
+	OffsetVisitor(TestTreeVisitor& visitor, unsigned idBase) :
+		m_pVisitor(&visitor),
+		m_idBase(idBase)
+	{
+	}
+
+	virtual void VisitTestCase(TestCase& tc) override
+	{
+		TestCase original(tc);
+		TestCase unit(tc);
+		unit.id += m_idBase;
+		m_pVisitor->VisitTestCase(unit);
+		CopyChanges(original, unit, tc);
+	}
+
+	virtual void EnterTestSuite(TestSuite& ts) override
+	{
+		m_suites.push_back(Suite(ts));
+		m_suites.back().copy.id += m_idBase;
+		m_pVisitor->EnterTestSuite(m_suites.back().copy);
+	}
+
+	virtual void LeaveTestSuite() override
+	{
+		m_pVisitor->LeaveTestSuite();
+		Suite& suite = m_suites.back();
+		CopyChanges(suite.original, suite.copy, *suite.pUnit);
+		m_suites.pop_back();
+	}
+
+private:
+	// Visitors that enable test units through the runner leave the copy unchanged.
+	static void CopyChanges(const TestUnit& original, const TestUnit& copy, TestUnit& unit)
+	{
+		if (copy.enabled != original.enabled)
+			unit.enabled = copy.enabled;
+		if (copy.active != original.active)
+			unit.active = copy.active;
+	}
+
+	struct Suite
+	{
+		explicit Suite(TestSuite& ts) : pUnit(&ts), original(ts), copy(ts)
+		{
+		}
+
+		TestSuite* pUnit;
+		TestSuite original;
+		TestSuite copy;
+	};
+
+	TestTreeVisitor* m_pVisitor;
+	unsigned m_idBase;
+	// The visitor may keep pointers to the suites it is in.
+	std::list<Suite> m_suites;
+};
+
+// Gives the events of one executable their workspace ids and tells the workspace
+// when its run finishes. The test iteration events are left to the workspace.
+class Workspace::ExecutableObserver : public ShardObserver
+{
+public:
+	ExecutableObserver(Workspace& workspace, TestExecutable& exe, ShardMerger& merger) :
+		ShardObserver(merger),
+		m_pWorkspace(&workspace),
+		m_pExe(&exe),
+		m_idBase(0)
+	{
+	}
+
+	void SetIdBase(unsigned idBase)
+	{
+		m_idBase = idBase;
+	}
+
+	virtual void test_suite_start(unsigned id) override
+	{
+		ShardObserver::test_suite_start(m_idBase + id);
+	}
+
+	virtual void test_case_start(unsigned id) override
+	{
+		ShardObserver::test_case_start(m_idBase + id);
+	}
+
+	virtual void test_case_finish(unsigned id, unsigned long elapsed) override
+	{
+		ShardObserver::test_case_finish(m_idBase + id, elapsed);
+	}
+
+	virtual void test_case_finish(unsigned id, unsigned long elapsed, TestCaseState::type state) override
+	{
+		ShardObserver::test_case_finish(m_idBase + id, elapsed, state);
+	}
+
+	virtual void test_suite_finish(unsigned id, unsigned long elapsed) override
+	{
+		ShardObserver::test_suite_finish(m_idBase + id, elapsed);
+	}
+
+	virtual void test_unit_skipped(unsigned id) override
+	{
+		ShardObserver::test_unit_skipped(m_idBase + id);
+	}
+
+	virtual void test_unit_aborted(unsigned id) override
+	{
+		ShardObserver::test_unit_aborted(m_idBase + id);
+	}
+
+	virtual void test_case_assertions(unsigned id, unsigned passed, unsigned failed) override
+	{
+		ShardObserver::test_case_assertions(m_idBase + id, passed, failed);
+	}
+
+	virtual void TestFinished() override
+	{
+		m_pWorkspace->OnExecutableFinished(*m_pExe);
+	}
+
+private:
+	Workspace* m_pWorkspace;
+	TestExecutable* m_pExe;
+	unsigned m_idBase;
+};
+
+struct Workspace::TestExecutable
+{
+	TestExecutable(const std::wstring& fileName, Workspace& workspace, ShardMerger& merger) :
+		fileName(fileName),
+		idBase(0),
+		idEnd(0),
+		finished(false),
+		observer(workspace, *this, merger)
+	{
+	}
+
+	std::wstring fileName;
+	std::string type;
+	std::string error;
+	// The workspace ids of the test units are idBase + their id in the executable, up to idEnd.
+	unsigned idBase;
+	unsigned idEnd;
+	bool finished;
+	// Serializes the messages of concurrent listings and test runs to the workspace observer.
+	ExecutableObserver observer;
+	std::unique_ptr<ExeRunner> pRunner;
+};
+
+Workspace::Workspace(const std::wstring& directory, TestObserver& observer, unsigned jobs, LoadCancellation* pCancellation) :
+	m_jobs(jobs > 0 ? jobs : std::max(1u, boost::thread::hardware_concurrency())),
+	m_root(0, fs::path(directory).filename().string()),
+	m_merger(observer),
+	m_aborted(false)
+{
+	m_root.fullName = m_root.name;
+	std::vector<std::wstring> files = FindExecutableFiles(directory);
+	std::vector<std::unique_ptr<TestExecutable>> executables;
+	for (auto it = files.begin(); it != files.end(); ++it)
+		executables.push_back(std::unique_ptr<TestExecutable>(new TestExecutable(*it, *this, m_merger)));
+
+	ParallelFor(executables.size(), m_jobs, [&](std::size_t i) { LoadExecutable(*executables[i], pCancellation); });
+	// The executables that were not loaded when the load was canceled have an error.
+	if (pCancellation)
+		pCancellation->Check();
+
+	// Id 0 is the root of the workspace. The executables that could not be read are kept with their error.
+	unsigned idBase = 1;
+	for (auto it = executables.begin(); it != executables.end(); ++it)
+	{
+		TestExecutable& exe = **it;
+		if (exe.type.empty() && exe.error.empty())
+			continue;
+
+		exe.idBase = idBase;
+		if (exe.pRunner)
+		{
+			MaxIdVisitor visitor;
+			exe.pRunner->TraverseTestTree(visitor);
+			idBase += visitor.maxId + 1;
+		}
+		exe.idEnd = idBase;
+		exe.observer.SetIdBase(exe.idBase);
+		m_executables.push_back(std::move(*it));
+	}
+}
+
+Workspace::~Workspace()
+{
+	Abort();
+	Wait();
+}
+
+void Workspace::LoadExecutable(TestExecutable& exe, LoadCancellation* pCancellation)
+{
+	try
+	{
+		if (pCancellation)
+			pCancellation->Check();
+		// Most candidates are not unit tests, these are dropped without an error.
+		exe.type = GetUnitTestType(WideCharToMultiByte(exe.fileName));
+		if (!exe.type.empty())
+			exe.pRunner.reset(new ExeRunner(exe.fileName, exe.observer, exe.type, pCancellation));
+	}
+	catch (std::exception& e)
+	{
+		exe.error = e.what();
+	}
+}
+
+std::size_t Workspace::Size() const
+{
+	return m_executables.size();
+}
+
+const std::wstring& Workspace::GetFileName(std::size_t index) const
+{
+	return m_executables.at(index)->fileName;
+}
+
+const std::string& Workspace::GetTestType(std::size_t index) const
+{
+	return m_executables.at(index)->type;
+}
+
+const std::string& Workspace::GetError(std::size_t index) const
+{
+	return m_executables.at(index)->error;
+}
+
+ExeRunner* Workspace::GetRunner(std::size_t index)
+{
+	return m_executables.at(index)->pRunner.get();
+}
+
+Workspace::TestExecutable* Workspace::FindExecutable(unsigned id)
+{
+	for (auto it = m_executables.begin(); it != m_executables.end(); ++it)
+	{
+		if (id >= (*it)->idBase && id < (*it)->idEnd)
+			return it->get();
+	}
+	return nullptr;
+}
+
+Workspace::TestExecutable& Workspace::GetExecutable(unsigned id)
+{
+	if (auto p = FindExecutable(id))
+		return *p;
+	throw std::invalid_argument("invalid TestUnit id");
+}
+
+TestSuite& Workspace::RootTestSuite()
+{
+	return m_root;
+}
+
+void Workspace::TraverseTestTree(TestTreeVisitor& v)
+{
+	for (auto it = m_executables.begin(); it != m_executables.end(); ++it)
+	{
+		if ((*it)->pRunner)
+		{
+			OffsetVisitor visitor(v, (*it)->idBase);
+			(*it)->pRunner->TraverseTestTree(visitor);
+		}
+	}
+}
+
+void Workspace::TraverseTestTree(unsigned id, TestTreeVisitor& v)
+{
+	if (id == m_root.id)
+		return TraverseTestTree(v);
+
+	TestExecutable& exe = GetExecutable(id);
+	OffsetVisitor visitor(v, exe.idBase);
+	exe.pRunner->TraverseTestTree(id - exe.idBase, visitor);
+}
+
+void Workspace::EnableTestUnit(unsigned id, bool enable)
+{
+	GetTestUnit(id).enabled = enable;
+}
+
+TestUnit& Workspace::GetTestUnit(unsigned id)
+{
+	if (id == m_root.id)
+		return m_root;
+
+	TestExecutable& exe = GetExecutable(id);
+	return exe.pRunner->GetTestUnit(id - exe.idBase);
+}
+
+TestUnit* Workspace::GetTestUnitPtr(unsigned id)
+{
+	if (id == m_root.id)
+		return &m_root;
+
+	auto p = FindExecutable(id);
+	return p ? p->pRunner->GetTestUnitPtr(id - p->idBase) : nullptr;
+}
+
+unsigned Workspace::GetEnabledOptions(unsigned options)
+{
+	unsigned enabled = ExeRunner::Randomize | ExeRunner::Isolate;
+	for (auto it = m_executables.begin(); it != m_executables.end(); ++it)
+	{
+		if ((*it)->pRunner)
+			enabled &= (*it)->pRunner->GetEnabledOptions(options);
+	}
+	return enabled;
+}
+
+bool Workspace::IsRunning() const
+{
+	return m_pThread.get() != nullptr;
+}
+
+void Workspace::SetRepeat(bool /*repeat*/)
+{
+}
+
+std::wstring Workspace::GetCommand(int logLevel, unsigned options, const std::wstring& arguments)
+{
+	std::wstring command;
+	for (auto it = m_executables.begin(); it != m_executables.end(); ++it)
+	{
+		if ((*it)->pRunner)
+			command += (*it)->pRunner->GetCommand(logLevel, GetEnabledOptions(options) & options, arguments) + L"\n";
+	}
+	return command;
+}
+
+void Workspace::Run(int logLevel, unsigned options, const std::wstring& arguments)
+{
+	if (m_pThread)
+		return;
+
+	m_aborted = false;
+	unsigned runOptions = GetEnabledOptions(options) & options;
+	m_pThread.reset(new boost::thread([=]() { RunExecutables(logLevel, runOptions, arguments); }));
+}
+
+void Workspace::Continue()
+{
+	for (auto it = m_executables.begin(); it != m_executables.end(); ++it)
+	{
+		if ((*it)->pRunner)
+			(*it)->pRunner->Continue();
+	}
+}
+
+// The running executables are aborted by RunExecutables(), the thread that also waits for them.
+void Workspace::Abort()
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	m_aborted = true;
+	m_condition.notify_all();
+}
+
+void Workspace::Wait()
+{
+	if (!m_pThread)
+		return;
+
+	m_pThread->join();
+	m_pThread.reset();
+}
+
+void Workspace::SetTimeouts(unsigned testCaseTimeout, unsigned runTimeout)
+{
+	for (auto it = m_executables.begin(); it != m_executables.end(); ++it)
+	{
+		if ((*it)->pRunner)
+			(*it)->pRunner->SetTimeouts(testCaseTimeout, runTimeout);
+	}
+}
+
+void Workspace::SetMemoryLimit(unsigned megabytes)
+{
+	for (auto it = m_executables.begin(); it != m_executables.end(); ++it)
+	{
+		if ((*it)->pRunner)
+			(*it)->pRunner->SetMemoryLimit(megabytes);
+	}
+}
+
+// Starts the executables that have enabled test cases, at most m_jobs at a time,
+// and starts the next one when one finishes. An executable that crashes, times
+// out or fails to start is reported by its own runner and does not stop the others.
+void Workspace::RunExecutables(int logLevel, unsigned options, const std::wstring& arguments)
+{
+	std::vector<TestExecutable*> queue;
+	unsigned testCases = 0;
+	for (auto it = m_executables.begin(); it != m_executables.end(); ++it)
+	{
+		if (!(*it)->pRunner)
+			continue;
+
+		MaxIdVisitor visitor;
+		(*it)->pRunner->TraverseTestTree(visitor);
+		if (visitor.testCases == 0)
+			continue;
+
+		(*it)->finished = false;
+		queue.push_back(it->get());
+		testCases += visitor.testCases;
+	}
+
+	m_merger.Post([](TestObserver& observer) { observer.TestStarted(); });
+	m_merger.Post([testCases](TestObserver& observer) { observer.test_iteration_start(testCases); });
+
+	std::vector<TestExecutable*> running;
+	auto next = queue.begin();
+	bool aborting = false;
+	boost::mutex::scoped_lock lock(m_mutex);
+	for (;;)
+	{
+		if (m_aborted && !aborting)
+		{
+			aborting = true;
+			std::vector<TestExecutable*> aborted(running);
+			lock.unlock();
+			for (auto it = aborted.begin(); it != aborted.end(); ++it)
+				(*it)->pRunner->Abort();
+			lock.lock();
+		}
+
+		while (!m_aborted && running.size() < m_jobs && next != queue.end())
+		{
+			TestExecutable& exe = **next++;
+			try
+			{
+				exe.pRunner->Run(logLevel, options, arguments);
+				running.push_back(&exe);
+			}
+			catch (std::exception& e)
+			{
+				std::string what = WideCharToMultiByte(exe.fileName) + ": " + e.what();
+				m_merger.Post([what](TestObserver& observer) { observer.exception_caught(what); });
+			}
+		}
+		if (running.empty())
+			break;
+
+		auto it = std::find_if(running.begin(), running.end(), [](TestExecutable* p) { return p->finished; });
+		if (it == running.end())
+		{
+			if (m_aborted == aborting)
+				m_condition.wait(lock);
+			continue;
+		}
+
+		TestExecutable& exe = **it;
+		running.erase(it);
+		lock.unlock();
+		exe.pRunner->Wait();
+		lock.lock();
+	}
+	lock.unlock();
+
+	m_merger.Post([](TestObserver& observer) { observer.test_iteration_finish(); });
+	m_merger.Post([](TestObserver& observer) { observer.test_finish(); });
+	m_merger.Post([](TestObserver& observer) { observer.TestFinished(); });
+}
+
+void Workspace::OnExecutableFinished(TestExecutable& exe)
+{
+	boost::mutex::scoped_lock lock(m_mutex);
+	exe.finished = true;
+	m_condition.notify_all();
+}
+
+} // namespace gj
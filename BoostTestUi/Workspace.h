@@ -0,0 +1,102 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#ifndef BOOST_TESTUI_WORKSPACE_H
+#define BOOST_TESTUI_WORKSPACE_H
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#pragma warning(push, 3) // conversion from 'int' to 'unsigned short', possible loss of data
+#include <boost/thread.hpp>
+#pragma warning(pop)
+#include <boost/noncopyable.hpp>
+#include "TestRunner.h"
+#include "ShardObserver.h"
+
+namespace gj {
+
+class ExeRunner;
+class LoadCancellation;
+
+// Returns the files in directory and its subdirectories that may be unit test
+// executables, sorted by path name. Hidden directories are skipped.
+std::vector<std::wstring> FindExecutableFiles(const std::wstring& directory);
+
+// The unit test executables in a build tree. The candidate files are classified
+// with GetUnitTestType and the test trees of the unit test executables are
+// listed concurrently, at most jobs at a time.
+// As a TestRunner, the workspace runs the executables concurrently, at most jobs
+// test processes at a time, and merges their events into one test iteration.
+// The test unit ids are made unique by an id range for each executable.
+class Workspace :
+	boost::noncopyable,
+	public TestRunner
+{
+public:
+	// jobs: the maximum number of concurrent GetUnitTestType scans, listings and test runs, 0: one per core.
+	Workspace(const std::wstring& directory, TestObserver& observer, unsigned jobs = 0, LoadCancellation* pCancellation = nullptr);
+	virtual ~Workspace();
+
+	std::size_t Size() const;
+	const std::wstring& GetFileName(std::size_t index) const;
+	const std::string& GetTestType(std::size_t index) const;
+	// The reason why an executable could not be loaded, empty when it was loaded.
+	const std::string& GetError(std::size_t index) const;
+	// nullptr when the executable could not be loaded.
+	ExeRunner* GetRunner(std::size_t index);
+
+	// The root test suites of the executables are the children of RootTestSuite().
+	// GetTestUnit() returns a test unit with the id it has in its own executable.
+	virtual TestSuite& RootTestSuite() override;
+	// Visits the test trees of all loaded executables, in path name order.
+	virtual void TraverseTestTree(TestTreeVisitor& v) override;
+	virtual void TraverseTestTree(unsigned id, TestTreeVisitor& v) override;
+
+	virtual void EnableTestUnit(unsigned id, bool enable) override;
+	virtual TestUnit& GetTestUnit(unsigned id) override;
+	virtual TestUnit* GetTestUnitPtr(unsigned id) override;
+
+	// The executables run in parallel instead of their test cases: Parallel,
+	// Resident, Zygote, Repeat and WaitForDebugger are not used.
+	virtual unsigned GetEnabledOptions(unsigned options) override;
+	virtual bool IsRunning() const override;
+	virtual void SetRepeat(bool repeat) override;
+	virtual std::wstring GetCommand(int logLevel, unsigned options, const std::wstring& arguments) override;
+	virtual void Run(int logLevel, unsigned options, const std::wstring& arguments) override;
+	virtual void Continue() override;
+	virtual void Abort() override;
+	virtual void Wait() override;
+
+	void SetTimeouts(unsigned testCaseTimeout, unsigned runTimeout);
+	void SetMemoryLimit(unsigned megabytes);
+
+private:
+	struct TestExecutable;
+	class ExecutableObserver;
+
+	void LoadExecutable(TestExecutable& exe, LoadCancellation* pCancellation);
+	TestExecutable& GetExecutable(unsigned id);
+	TestExecutable* FindExecutable(unsigned id);
+	void RunExecutables(int logLevel, unsigned options, const std::wstring& arguments);
+	void OnExecutableFinished(TestExecutable& exe);
+
+	unsigned m_jobs;
+	TestSuite m_root;
+	ShardMerger m_merger;
+	std::vector<std::unique_ptr<TestExecutable>> m_executables;
+	boost::mutex m_mutex;
+	boost::condition_variable m_condition;
+	bool m_aborted;
+	std::unique_ptr<boost::thread> m_pThread;
+};
+
+} // namespace gj
+
+#endif // BOOST_TESTUI_WORKSPACE_H
@@ -10,22 +10,112 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstring>
 #include <streambuf>
 #include <vector>
+#ifndef _WIN32
+#include <cerrno>
+#include <csignal>
+#include <ctime>
+#include <pthread.h>
+#include <unistd.h>
+#endif
 
 namespace gj {
 
+#ifdef _WIN32
+
+typedef HANDLE FileHandle;
+const FileHandle NoFileHandle = nullptr;
+
+inline bool ReadHandle(FileHandle handle, void* buffer, std::size_t size, std::size_t& read)
+{
+	DWORD n;
+	if (!ReadFile(handle, buffer, static_cast<DWORD>(size), &n, nullptr))
+		return false;
+	read = n;
+	return true;
+}
+
+inline bool WriteHandle(FileHandle handle, const void* buffer, std::size_t size)
+{
+	DWORD written;
+	return WriteFile(handle, buffer, static_cast<DWORD>(size), &written, nullptr) != FALSE;
+}
+
+#else // !_WIN32
+
+typedef int FileHandle;
+const FileHandle NoFileHandle = -1;
+
+inline bool ReadHandle(FileHandle handle, void* buffer, std::size_t size, std::size_t& read)
+{
+	ssize_t n;
+	do
+		n = ::read(handle, buffer, size);
+	while (n < 0 && errno == EINTR);
+	if (n < 0)
+		return false;
+	read = static_cast<std::size_t>(n);
+	return true;
+}
+
+// A child that exits early must not take the runner down when we write to its stdin.
+// SIGPIPE is blocked on this thread during the write and a SIGPIPE that the write raised
+// is taken from the pending signals, the disposition that test processes inherit is kept.
+inline bool WriteHandle(FileHandle handle, const void* buffer, std::size_t size)
+{
+	sigset_t sigPipe, mask, pending;
+	sigemptyset(&sigPipe);
+	sigaddset(&sigPipe, SIGPIPE);
+	pthread_sigmask(SIG_BLOCK, &sigPipe, &mask);
+	sigpending(&pending);
+	bool wasPending = sigismember(&pending, SIGPIPE) == 1;
+
+	bool ok = true;
+	auto p = static_cast<const char*>(buffer);
+	while (size > 0)
+	{
+		ssize_t n = ::write(handle, p, size);
+		if (n < 0 && errno == EINTR)
+			continue;
+		if (n <= 0)
+		{
+			if (n < 0 && errno == EPIPE && !wasPending)
+			{
+				timespec zero = { 0, 0 };
+				while (sigtimedwait(&sigPipe, nullptr, &zero) < 0 && errno == EINTR)
+				{
+				}
+			}
+			ok = false;
+			break;
+		}
+		p += n;
+		size -= static_cast<std::size_t>(n);
+	}
+
+	pthread_sigmask(SIG_SETMASK, &mask, nullptr);
+	return ok;
+}
+
+#endif // _WIN32
+
 template <class Elem, class Tr = std::char_traits<Elem>, class Alloc = std::allocator<Elem> >
 class basic_handlebuf : public std::basic_streambuf<Elem, Tr>
 {
 public:
-	basic_handlebuf(HANDLE handle, std::size_t buff_sz = 256, std::size_t put_back = 8) :
+	typedef typename std::basic_streambuf<Elem, Tr>::int_type int_type;
+	typedef typename std::basic_streambuf<Elem, Tr>::traits_type traits_type;
+
+	basic_handlebuf(FileHandle handle, std::size_t buff_sz = 256, std::size_t put_back = 8) :
 		m_handle(handle),
 		m_put_back(std::max<std::size_t>(put_back, 1)),
 		m_readBuffer(std::max(buff_sz, m_put_back) + m_put_back)
 	{
 		Elem* end = &m_readBuffer.front() + m_readBuffer.size();
-		setg(end, end, end);
+		this->setg(end, end, end);
 	}
 
 protected:
@@ -33,8 +123,7 @@ protected:
 	{
 		if (!m_writeBuffer.empty())
 		{
-			DWORD written;
-			if (!WriteFile(m_handle, m_writeBuffer.data(), m_writeBuffer.size(), &written, nullptr))
+			if (!WriteHandle(m_handle, m_writeBuffer.data(), m_writeBuffer.size()*sizeof(Elem)))
 				return traits_type::eof();
 
 			m_writeBuffer.clear();
@@ -55,33 +144,33 @@ protected:
 
 	int_type underflow()
 	{
-		if (gptr() < egptr()) // buffer not exhausted
-			return traits_type::to_int_type(*gptr());
+		if (this->gptr() < this->egptr()) // buffer not exhausted
+			return traits_type::to_int_type(*this->gptr());
 
 		Elem* base = &m_readBuffer.front();
 		Elem* start = base;
 
-		if (eback() == base) // true when this isn't the first fill
+		if (this->eback() == base) // true when this isn't the first fill
 		{
 			// Make arrangements for putback characters
-			std::memmove(base, egptr() - m_put_back, m_put_back);
+			std::memmove(base, this->egptr() - m_put_back, m_put_back*sizeof(Elem));
 			start += m_put_back;
 		}
 
 		// start is now the start of the buffer, proper.
 		// Read from m_handle in to the provided buffer
-		DWORD read;
-		if (!ReadFile(m_handle, start, (m_readBuffer.size() - (start - base))*sizeof(Elem), &read, nullptr) || read == 0)
+		std::size_t read;
+		if (!ReadHandle(m_handle, start, (m_readBuffer.size() - (start - base))*sizeof(Elem), read) || read == 0)
 			return traits_type::eof();
 
 		// Set buffer pointers
-		setg(base, start, start + read/sizeof(Elem));
+		this->setg(base, start, start + read/sizeof(Elem));
 
-		return traits_type::to_int_type(*gptr());
+		return traits_type::to_int_type(*this->gptr());
 	}
 
 private:
-	HANDLE m_handle;
+	FileHandle m_handle;
 	const std::size_t m_put_back;
 	std::vector<Elem> m_readBuffer;
 	std::vector<Elem> m_writeBuffer;
@@ -91,7 +180,7 @@ template <class Elem, class Tr = std::char_traits<Elem>>
 class basic_handlestream : public std::basic_iostream<Elem, Tr>
 {
 public:
-	basic_handlestream(HANDLE handle) :
+	basic_handlestream(FileHandle handle) :
 		std::basic_iostream<Elem, Tr>(&m_buf),
 		m_buf(handle)
 	{
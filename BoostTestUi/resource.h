@@ -32,6 +32,7 @@
 #define IDD_CATEGORIES                  215
 #define IDD_ARGUMENTS                   216
 #define IDD_FIND                        217
+#define IDR_BOOSTTESTUI_GUI_HPP         218
 #define IDI_WARN                        218
 #define IDD_SELECT_DEBUG                218
 #define IDC_TREEVIEW                    1000
@@ -109,13 +110,17 @@
 #define ID_TEST_RUNNERARGS              32814
 #define ID_LOG_FIND                     32815
 #define ID_PROGRESS                     32816
+#define ID_TEST_PARALLEL                32817
+#define ID_TEST_RESIDENT                32818
+#define ID_LOG_STDOUT                   32819
+#define ID_LOG_STDERR                   32820
 
 // Next default values for new objects
 //
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
-#define _APS_NEXT_RESOURCE_VALUE        218
-#define _APS_NEXT_COMMAND_VALUE         32817
+#define _APS_NEXT_RESOURCE_VALUE        219
+#define _APS_NEXT_COMMAND_VALUE         32821
 #define _APS_NEXT_CONTROL_VALUE         1036
 #define _APS_NEXT_SYMED_VALUE           105
 #endif
@@ -7,6 +7,8 @@
 
 #pragma once
 
+#ifdef _WIN32
+
 #define NOMINMAX
 #define _CRT_SECURE_NO_WARNINGS
 
@@ -53,3 +55,18 @@ extern CAppModule _Module;
 #else
   #pragma comment(linker, "/manifestdependency:\"type='win32' name='Microsoft.Windows.Common-Controls' version='6.0.0.0' processorArchitecture='*' publicKeyToken='6595b64144ccf1df' language='*'\"")
 #endif
+
+#else // !_WIN32
+
+// The portable core (ExeRunner, the ArgumentBuilders and Process) builds without ATL/WTL:
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <sys/types.h>
+
+#endif // _WIN32
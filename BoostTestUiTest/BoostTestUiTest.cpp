@@ -0,0 +1,12 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+// Unit tests of the test runner core. The other files of this directory add
+// their test suites to this module.
+
+#define BOOST_TEST_MODULE BoostTestUi Test
+#include <boost/test/included/unit_test.hpp>
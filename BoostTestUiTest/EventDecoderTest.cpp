@@ -0,0 +1,97 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <boost/test/unit_test.hpp>
+#include "EventChannel.h"
+
+namespace gj {
+
+void PutUint32(std::string& data, std::uint32_t value)
+{
+	data.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+// An event record as boosttestui-gui.hpp writes it.
+std::string EventRecord(ClientEvent::Type type, unsigned id, unsigned value, const std::string& text)
+{
+	std::string data;
+	PutUint32(data, static_cast<std::uint32_t>(1 + 4 + 4 + 4 + text.size()));
+	data += static_cast<char>(type);
+	PutUint32(data, id);
+	PutUint32(data, value);
+	PutUint32(data, static_cast<std::uint32_t>(text.size()));
+	data += text;
+	return data;
+}
+
+BOOST_AUTO_TEST_SUITE(EventDecoderTest)
+
+BOOST_AUTO_TEST_CASE(DecodesRecords)
+{
+	std::string data = EventRecord(ClientEvent::UnitStart, 3, 0, "") + EventRecord(ClientEvent::Assertion, 3, 17, "check failed");
+	EventDecoder decoder;
+	decoder.Append(data.data(), data.size());
+
+	ClientEvent event;
+	BOOST_REQUIRE(decoder.Next(event));
+	BOOST_TEST(event.type == ClientEvent::UnitStart);
+	BOOST_TEST(event.id == 3u);
+	BOOST_TEST(event.text.empty());
+
+	BOOST_REQUIRE(decoder.Next(event));
+	BOOST_TEST(event.type == ClientEvent::Assertion);
+	BOOST_TEST(event.id == 3u);
+	BOOST_TEST(event.value == 17u);
+	BOOST_TEST(event.text == "check failed");
+
+	BOOST_TEST(!decoder.Next(event));
+	BOOST_TEST(decoder.Empty());
+}
+
+BOOST_AUTO_TEST_CASE(WaitsForCompleteRecord)
+{
+	std::string data = EventRecord(ClientEvent::UnitFailed, 5, 1, "message");
+	EventDecoder decoder;
+	ClientEvent event;
+	for (std::size_t i = 0; i + 1 < data.size(); ++i)
+	{
+		decoder.Append(data.data() + i, 1);
+		BOOST_TEST(!decoder.Next(event));
+	}
+	decoder.Append(data.data() + data.size() - 1, 1);
+	BOOST_REQUIRE(decoder.Next(event));
+	BOOST_TEST(event.type == ClientEvent::UnitFailed);
+	BOOST_TEST(event.text == "message");
+	BOOST_TEST(decoder.Empty());
+}
+
+BOOST_AUTO_TEST_CASE(RejectsInconsistentTextLength)
+{
+	std::string data = EventRecord(ClientEvent::Exception, 1, 0, "text");
+	data[13] = 3;
+	EventDecoder decoder;
+	decoder.Append(data.data(), data.size());
+	ClientEvent event;
+	BOOST_CHECK_THROW(decoder.Next(event), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(RejectsShortRecordSize)
+{
+	std::string data = EventRecord(ClientEvent::Hello, 0, 0, "");
+	data[0] = 4;
+	EventDecoder decoder;
+	decoder.Append(data.data(), data.size());
+	ClientEvent event;
+	BOOST_CHECK_THROW(decoder.Next(event), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace gj
@@ -0,0 +1,79 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#include <string>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/test/unit_test.hpp>
+#include "GetUnitTestType.h"
+
+namespace gj {
+
+namespace fs = boost::filesystem;
+
+// Gets the unit test type of a file with the given contents.
+std::string GetContentsTestType(const std::string& contents)
+{
+	fs::path path = fs::temp_directory_path() / fs::unique_path("BoostTestUiTest-%%%%%%%%.bin");
+	{
+		fs::ofstream file(path, std::ios::binary);
+		file.write(contents.data(), contents.size());
+	}
+	std::string type = GetUnitTestType(path.string());
+	fs::remove(path);
+	return type;
+}
+
+// The patterns are split so this test does not look like a test executable itself.
+const std::string BoostPattern = std::string("BOOST_") + "TESTS_TO_RUN";
+const std::string CatchPattern = std::string("Catch::") + "Session";
+const std::string GooglePattern = std::string("GTEST_") + "COLOR";
+
+BOOST_AUTO_TEST_SUITE(GetUnitTestTypeTest)
+
+BOOST_AUTO_TEST_CASE(EmptyFile)
+{
+	BOOST_TEST(GetContentsTestType("") == "");
+}
+
+BOOST_AUTO_TEST_CASE(NoPattern)
+{
+	BOOST_TEST(GetContentsTestType(std::string(1000, 'x')) == "");
+}
+
+BOOST_AUTO_TEST_CASE(FindsEachPattern)
+{
+	BOOST_TEST(GetContentsTestType("..." + BoostPattern + "...") == "boost/noheader");
+	BOOST_TEST(GetContentsTestType("..." + CatchPattern + "...") == "catch/noheader");
+	BOOST_TEST(GetContentsTestType("..." + GooglePattern + "...") == "google/noheader");
+}
+
+BOOST_AUTO_TEST_CASE(FirstPatternWinsRegardlessOfPosition)
+{
+	BOOST_TEST(GetContentsTestType(GooglePattern + " " + CatchPattern + " " + BoostPattern) == "boost/noheader");
+	BOOST_TEST(GetContentsTestType(GooglePattern + " " + CatchPattern) == "catch/noheader");
+}
+
+BOOST_AUTO_TEST_CASE(FindsPatternAfterPartialMatch)
+{
+	BOOST_TEST(GetContentsTestType("BOOST_BOOST_" + BoostPattern.substr(6)) == "boost/noheader");
+	BOOST_TEST(GetContentsTestType("GTEST_GTEST_" + GooglePattern.substr(6) + "\n") == "google/noheader");
+}
+
+BOOST_AUTO_TEST_CASE(FindsPatternAtBufferEnd)
+{
+	BOOST_TEST(GetContentsTestType(std::string(100, '\0') + CatchPattern) == "catch/noheader");
+}
+
+BOOST_AUTO_TEST_CASE(MarkerWinsOverPatterns)
+{
+	BOOST_TEST(GetContentsTestType(BoostPattern + " unit_test_type_" + std::string("catch") + '\0') == "catch");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace gj
@@ -0,0 +1,67 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <boost/test/unit_test.hpp>
+#include "LineReader.h"
+
+namespace gj {
+
+// Writes the output to a pipe and reads it back with a LineReader of the given buffer size.
+std::vector<std::string> ReadLines(const std::string& output, std::size_t bufferSize = LineReader::DefaultBufferSize)
+{
+	int fds[2];
+	BOOST_REQUIRE(pipe(fds) == 0);
+	BOOST_REQUIRE(WriteHandle(fds[1], output.data(), output.size()));
+	close(fds[1]);
+
+	std::vector<std::string> lines;
+	LineReader reader(fds[0], bufferSize);
+	std::string_view line;
+	while (reader.GetLine(line))
+		lines.push_back(std::string(line));
+	close(fds[0]);
+	return lines;
+}
+
+BOOST_AUTO_TEST_SUITE(LineReaderTest)
+
+BOOST_AUTO_TEST_CASE(SplitsLines)
+{
+	std::vector<std::string> expected = { "first", "", "third" };
+	BOOST_TEST(ReadLines("first\n\nthird\n") == expected, boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_CASE(StripsTrailingControlCharacters)
+{
+	std::vector<std::string> expected = { "windows", "tab", " indented" };
+	BOOST_TEST(ReadLines("windows\r\ntab\t\n indented\n") == expected, boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_CASE(ReturnsUnterminatedLastLine)
+{
+	std::vector<std::string> expected = { "line", "last" };
+	BOOST_TEST(ReadLines("line\nlast") == expected, boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_CASE(GrowsBufferForLongLine)
+{
+	std::string longLine(100, 'x');
+	std::vector<std::string> expected = { "a", longLine, "b" };
+	BOOST_TEST(ReadLines("a\n" + longLine + "\nb\n", 4) == expected, boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_CASE(EmptyOutput)
+{
+	BOOST_TEST(ReadLines("").empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace gj
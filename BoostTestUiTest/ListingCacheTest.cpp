@@ -0,0 +1,146 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#include <string>
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+#include <boost/test/unit_test.hpp>
+#include "ListingCache.h"
+
+namespace gj {
+
+namespace fs = boost::filesystem;
+
+// A test executable and a cache directory in a temporary directory.
+struct ListingCacheFixture
+{
+	ListingCacheFixture() :
+		directory(fs::temp_directory_path() / fs::unique_path("BoostTestUiTest-%%%%%%%%")),
+		exe(directory / "test.exe"),
+		savedCacheDirectory(ListingCache::GetDirectory())
+	{
+		fs::create_directories(directory);
+		ListingCache::SetDirectory((directory / "cache").wstring());
+		WriteExe("first build");
+	}
+
+	~ListingCacheFixture()
+	{
+		ListingCache::SetDirectory(savedCacheDirectory);
+		boost::system::error_code ec;
+		fs::remove_all(directory, ec);
+	}
+
+	void WriteExe(const std::string& contents)
+	{
+		fs::ofstream file(exe, std::ios::binary);
+		file << contents;
+	}
+
+	void Touch()
+	{
+		fs::last_write_time(exe, fs::last_write_time(exe) + 10);
+	}
+
+	bool Load(TestUnitNode& tree, const std::wstring& listCommand = L"--list_content")
+	{
+		return ListingCache(exe.wstring(), listCommand).Load(tree);
+	}
+
+	void Store(const TestUnitNode& tree, const std::wstring& listCommand = L"--list_content")
+	{
+		ListingCache(exe.wstring(), listCommand).Store(tree);
+	}
+
+	fs::path directory;
+	fs::path exe;
+	std::wstring savedCacheDirectory;
+};
+
+TestUnitNode MakeCachedTree()
+{
+	TestUnitNode tree(TestSuite(1, "Master"));
+	tree.children.push_back(TestUnitNode(TestSuite(2, "Suite")));
+	tree.children.back().children.push_back(TestUnitNode(TestCase(3, "Case", false)));
+	tree.children.back().children.back().data.categories.push_back("slow");
+	tree.children.push_back(TestUnitNode(TestCase(4, "Other")));
+	return tree;
+}
+
+void CheckEqualTrees(const TestUnitNode& a, const TestUnitNode& b)
+{
+	BOOST_TEST(a.data.id == b.data.id);
+	BOOST_TEST(a.data.type == b.data.type);
+	BOOST_TEST(a.data.name == b.data.name);
+	BOOST_TEST(a.data.enabled == b.data.enabled);
+	BOOST_TEST(a.data.categories == b.data.categories, boost::test_tools::per_element());
+	BOOST_REQUIRE(a.children.size() == b.children.size());
+	for (std::size_t i = 0; i < a.children.size(); ++i)
+		CheckEqualTrees(a.children[i], b.children[i]);
+}
+
+BOOST_FIXTURE_TEST_SUITE(ListingCacheTest, ListingCacheFixture)
+
+BOOST_AUTO_TEST_CASE(MissesWithoutEntry)
+{
+	TestUnitNode tree(TestSuite(1, "Master"));
+	BOOST_TEST(!Load(tree));
+}
+
+BOOST_AUTO_TEST_CASE(LoadsStoredTree)
+{
+	Store(MakeCachedTree());
+	TestUnitNode tree(TestSuite(1, "Master"));
+	BOOST_REQUIRE(Load(tree));
+	CheckEqualTrees(tree, MakeCachedTree());
+}
+
+BOOST_AUTO_TEST_CASE(MissesForOtherListCommand)
+{
+	Store(MakeCachedTree());
+	TestUnitNode tree(TestSuite(1, "Master"));
+	BOOST_TEST(!Load(tree, L"--gtest_list_tests"));
+}
+
+BOOST_AUTO_TEST_CASE(MissesWhenExeIsRebuilt)
+{
+	Store(MakeCachedTree());
+	WriteExe("other build");
+	Touch();
+	TestUnitNode tree(TestSuite(1, "Master"));
+	BOOST_TEST(!Load(tree));
+}
+
+BOOST_AUTO_TEST_CASE(HitsWhenOnlyTimeStampChanged)
+{
+	Store(MakeCachedTree());
+	Touch();
+	TestUnitNode tree(TestSuite(1, "Master"));
+	BOOST_REQUIRE(Load(tree));
+	CheckEqualTrees(tree, MakeCachedTree());
+}
+
+BOOST_AUTO_TEST_CASE(IgnoresCorruptEntry)
+{
+	Store(MakeCachedTree());
+	for (fs::directory_iterator it(directory / "cache"), end; it != end; ++it)
+		fs::resize_file(it->path(), fs::file_size(it->path()) - 1);
+	TestUnitNode tree(TestSuite(1, "Master"));
+	BOOST_TEST(!Load(tree));
+}
+
+BOOST_AUTO_TEST_CASE(EmptyDirectoryDisablesCache)
+{
+	ListingCache::SetDirectory(L"");
+	Store(MakeCachedTree());
+	TestUnitNode tree(TestSuite(1, "Master"));
+	BOOST_TEST(!Load(tree));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace gj
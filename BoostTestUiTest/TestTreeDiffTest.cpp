@@ -0,0 +1,127 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/test/unit_test.hpp>
+#include "TestTreeDiff.h"
+
+namespace gj {
+
+// A test suite with the given id and test cases numbered after it. The tests number
+// the old tree from 1 and the new tree from 101.
+TestUnitNode MakeDiffTree(unsigned firstId, const std::vector<std::string>& names)
+{
+	TestUnitNode tree(TestSuite(firstId, "Master"));
+	for (auto it = names.begin(); it != names.end(); ++it)
+		tree.children.push_back(TestUnitNode(TestCase(firstId + 1 + static_cast<unsigned>(it - names.begin()), *it)));
+	return tree;
+}
+
+typedef std::map<unsigned, unsigned> IdMap;
+
+BOOST_AUTO_TEST_SUITE(TestTreeDiffTest)
+
+BOOST_AUTO_TEST_CASE(MatchesUnchangedTree)
+{
+	TestTreeDiff diff = DiffTestTrees(MakeDiffTree(1, { "A", "B" }), MakeDiffTree(101, { "A", "B" }));
+	IdMap unchanged = { { 1, 101 }, { 2, 102 }, { 3, 103 } };
+	BOOST_TEST(diff.unchanged == unchanged);
+	BOOST_TEST(diff.renamed.empty());
+	BOOST_TEST(diff.removed.empty());
+	BOOST_TEST(diff.added.empty());
+}
+
+BOOST_AUTO_TEST_CASE(MatchesReorderedTestUnitsByName)
+{
+	TestTreeDiff diff = DiffTestTrees(MakeDiffTree(1, { "A", "B" }), MakeDiffTree(101, { "B", "A" }));
+	IdMap unchanged = { { 1, 101 }, { 2, 103 }, { 3, 102 } };
+	BOOST_TEST(diff.unchanged == unchanged);
+	BOOST_TEST(diff.added.empty());
+}
+
+BOOST_AUTO_TEST_CASE(MatchesRenameInPlace)
+{
+	TestTreeDiff diff = DiffTestTrees(MakeDiffTree(1, { "A", "B", "C" }), MakeDiffTree(101, { "A", "X", "C" }));
+	IdMap renamed = { { 3, 103 } };
+	BOOST_TEST(diff.renamed == renamed);
+	BOOST_TEST(diff.unchanged.size() == 3u);
+	BOOST_TEST(diff.removed.empty());
+	BOOST_TEST(diff.added.empty());
+}
+
+BOOST_AUTO_TEST_CASE(InsertsAfterPreviousTestUnit)
+{
+	TestTreeDiff diff = DiffTestTrees(MakeDiffTree(1, { "A", "C" }), MakeDiffTree(101, { "A", "B", "C" }));
+	BOOST_TEST(diff.renamed.empty());
+	BOOST_TEST(diff.removed.empty());
+	BOOST_REQUIRE(diff.added.size() == 1u);
+	BOOST_TEST(diff.added[0].id == 103u);
+	BOOST_TEST(diff.added[0].parentId == 101u);
+	BOOST_TEST(diff.added[0].previousId == 102u);
+	BOOST_TEST(!diff.added[0].first);
+}
+
+BOOST_AUTO_TEST_CASE(InsertsFirstChild)
+{
+	TestTreeDiff diff = DiffTestTrees(MakeDiffTree(1, { "A" }), MakeDiffTree(101, { "Z", "A" }));
+	BOOST_REQUIRE(diff.added.size() == 1u);
+	BOOST_TEST(diff.added[0].id == 102u);
+	BOOST_TEST(diff.added[0].parentId == 101u);
+	BOOST_TEST(diff.added[0].first);
+}
+
+BOOST_AUTO_TEST_CASE(RemovesMissingTestUnit)
+{
+	TestTreeDiff diff = DiffTestTrees(MakeDiffTree(1, { "A", "B" }), MakeDiffTree(101, { "A" }));
+	BOOST_TEST(diff.removed == std::vector<unsigned>(1, 3), boost::test_tools::per_element());
+	BOOST_TEST(diff.added.empty());
+}
+
+BOOST_AUTO_TEST_CASE(DoesNotRenameToOtherType)
+{
+	TestUnitNode oldTree = MakeDiffTree(1, { "A", "B" });
+	TestUnitNode newTree = MakeDiffTree(101, { "A" });
+	newTree.children.push_back(TestUnitNode(TestSuite(103, "X")));
+	TestTreeDiff diff = DiffTestTrees(oldTree, newTree);
+	BOOST_TEST(diff.renamed.empty());
+	BOOST_TEST(diff.removed == std::vector<unsigned>(1, 3), boost::test_tools::per_element());
+	BOOST_REQUIRE(diff.added.size() == 1u);
+	BOOST_TEST(diff.added[0].id == 103u);
+}
+
+BOOST_AUTO_TEST_CASE(AddsSecondOfEquallyNamedTestUnits)
+{
+	TestTreeDiff diff = DiffTestTrees(MakeDiffTree(1, { "A" }), MakeDiffTree(101, { "A", "A" }));
+	IdMap unchanged = { { 1, 101 }, { 2, 102 } };
+	BOOST_TEST(diff.unchanged == unchanged);
+	BOOST_REQUIRE(diff.added.size() == 1u);
+	BOOST_TEST(diff.added[0].id == 103u);
+	BOOST_TEST(diff.added[0].previousId == 102u);
+}
+
+BOOST_AUTO_TEST_CASE(DiffsChildrenOfRenamedSuite)
+{
+	TestUnitNode oldTree(TestSuite(1, "Master"));
+	oldTree.children.push_back(MakeDiffTree(2, { "A", "B" }));
+	oldTree.children.back().data.name = "Old";
+	TestUnitNode newTree(TestSuite(101, "Master"));
+	newTree.children.push_back(MakeDiffTree(102, { "A", "C" }));
+	newTree.children.back().data.name = "New";
+
+	TestTreeDiff diff = DiffTestTrees(oldTree, newTree);
+	IdMap unchanged = { { 1, 101 }, { 3, 103 } };
+	IdMap renamed = { { 2, 102 }, { 4, 104 } };
+	BOOST_TEST(diff.unchanged == unchanged);
+	BOOST_TEST(diff.renamed == renamed);
+	BOOST_TEST(diff.added.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace gj
@@ -0,0 +1,114 @@
+// (C) Copyright Gert-Jan de Vos 2012.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at 
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+// Measures the throughput of reading test output from a pipe with hstream and
+// std::getline, as the runner did, and with LineReader.
+//
+//	LineReaderBenchmark [<megabytes>]
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "hstream.h"
+#include "LineReader.h"
+#include "Utilities.h"
+
+namespace gj {
+
+// Test output with lines of varying length, like a log of assertions and diagnostics.
+std::string MakeOutput()
+{
+	std::string output;
+	for (unsigned i = 0; output.size() < 1024 * 1024; ++i)
+	{
+		output += "../test/unit_test.cpp(" + std::to_string(i % 1000) + "): info: check ";
+		output.append(i % 97, 'x');
+		output += " has passed\n";
+	}
+	return output;
+}
+
+struct Result
+{
+	std::size_t lines = 0;
+	std::size_t bytes = 0;
+};
+
+template <typename Reader>
+double Measure(const char* name, std::size_t megabytes, Reader read)
+{
+	int fds[2];
+	if (pipe(fds) != 0)
+		throw std::runtime_error("pipe failed");
+
+	std::string output = MakeOutput();
+	std::size_t blocks = megabytes * 1024 * 1024 / output.size() + 1;
+	std::thread writer([&]()
+	{
+		for (std::size_t i = 0; i < blocks; ++i)
+			WriteHandle(fds[1], output.data(), output.size());
+		close(fds[1]);
+	});
+
+	auto start = std::chrono::steady_clock::now();
+	Result result = read(fds[0]);
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+	writer.join();
+	close(fds[0]);
+
+	double mbs = blocks * output.size() / (1024.0 * 1024.0) / elapsed.count();
+	std::cout << name << ": " << result.lines << " lines, " << result.bytes << " bytes in " << elapsed.count() << " s, " << mbs << " MB/s\n";
+	return mbs;
+}
+
+Result ReadHstream(FileHandle handle)
+{
+	Result result;
+	hstream hs(handle);
+	std::string line;
+	while (std::getline(hs, line))
+	{
+		std::string msg = Chomp(line);
+		++result.lines;
+		result.bytes += msg.size();
+	}
+	return result;
+}
+
+Result ReadLineReader(FileHandle handle)
+{
+	Result result;
+	LineReader reader(handle);
+	std::string_view line;
+	while (reader.GetLine(line))
+	{
+		++result.lines;
+		result.bytes += line.size();
+	}
+	return result;
+}
+
+} // namespace gj
+
+int main(int argc, char* argv[])
+try
+{
+	std::size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 256;
+	double before = gj::Measure("hstream", megabytes, gj::ReadHstream);
+	double after = gj::Measure("LineReader", megabytes, gj::ReadLineReader);
+	std::cout << "Speedup: " << after / before << "x\n";
+	return 0;
+}
+catch (std::exception& e)
+{
+	std::cerr << e.what() << "\n";
+	return 2;
+}
@@ -10,14 +10,23 @@
 
 #define init_unit_test_suite init_unit_test_suite2
 
+#include <cstdlib>
 #include <iostream>
 #include <iomanip>
+#include <set>
+#include <string>
+#include <vector>
 #include <boost/test/unit_test.hpp>
 #include <boost/test/execution_monitor.hpp>
 
 // Starting with 1.59, boost.test directly supports list_content and wait_for_debugger:
 #if BOOST_VERSION >= 105900
 #	define BOOST_TEST_API_3
+#	include <boost/test/results_collector.hpp>
+#	include <boost/test/unit_test_monitor.hpp>
+#	include <boost/test/unit_test_parameters.hpp>
+#	include <boost/test/tree/traverse.hpp>
+#	include <boost/test/tree/visitor.hpp>
 #endif
 
 #ifndef BOOST_TEST_API_3
@@ -27,57 +36,176 @@
 
 #undef init_unit_test_suite
 
+#include "boosttestui-gui.hpp"
+
 namespace boost {
 namespace unit_test {
 namespace gui {
 
+// The binary event channel of boosttestui-gui.hpp, without one the events go to stdout as '#' lines.
+class event_channel : public boosttestui::event_channel
+{
+public:
+	static void write(type t, unsigned id = 0, unsigned value = 0, const std::string& text = std::string())
+	{
+		if (!is_open())
+			append_line(t, id, value, text);
+		boosttestui::event_channel::write(t, id, value, text);
+	}
+
+private:
+	// The text protocol, stdout buffers the lines.
+	static void append_line(type t, unsigned id, unsigned value, const std::string& text)
+	{
+		switch (t)
+		{
+		case hello: return;
+		case waiting: std::cout << "#waiting\n"; break;
+		case iteration_start: std::cout << "#start " << value << "\n"; break;
+		case iteration_finish: std::cout << "#finish\n"; break;
+		case aborted: std::cout << "#aborted\n"; break;
+		case unit_start: std::cout << "#unit_start " << id << "\n"; break;
+		case unit_finish: std::cout << "#unit_finish " << id << " " << value << "\n"; break;
+		case unit_skipped: std::cout << "#unit_skipped " << id << "\n"; break;
+		case unit_aborted: std::cout << "#unit_aborted " << id << "\n"; break;
+		case assertion: std::cout << "#assertion " << value << "\n"; break;
+		case exception: std::cout << "#exception " << text << "\n"; break;
+		case unit_assertions: std::cout << "#unit_assertions " << id << " " << value << "\n"; break;
+		default: break;
+		}
+	}
+};
+
+// The passed assertions of the running test case are counted and reported once, when it finishes.
+inline unsigned& passed_assertions()
+{
+	static unsigned count = 0;
+	return count;
+}
+
+inline bool is_test_case(test_unit const& tu)
+{
+#ifdef BOOST_TEST_API_3
+	return tu.p_type == TUT_CASE;
+#else
+	return tu.p_type == tut_case;
+#endif
+}
+
+inline void report_passed_assertions(test_unit_id id)
+{
+	if (passed_assertions() > 0)
+		event_channel::write(event_channel::unit_assertions, id, passed_assertions());
+	passed_assertions() = 0;
+}
+
 class gui_observer : public test_observer
 {
 public:
+	typedef void (*worker_function)();
+
+	gui_observer() : m_worker(0), m_in_worker(false), m_batches(false)
+	{
+	}
+
+	// The worker replaces the test run: it runs the batches of test cases
+	// that the gui runner hands out, or repeats the whole test run, and ends
+	// the process when done.
+	void set_worker(worker_function worker, bool batches)
+	{
+		m_worker = worker;
+		m_batches = batches;
+	}
+
+#ifdef BOOST_TEST_API_3
+	// The worker runs nested from test_start(): framework::run() must have
+	// initialized its own init observer, with priority 0, before that.
+	virtual int priority()
+	{
+		return 1;
+	}
+#endif
+
 	virtual void test_start(counter_t test_cases_amount)
 	{
-		std::cout << "#start " << test_cases_amount << std::endl;
+		if (m_worker && !m_in_worker)
+		{
+			m_in_worker = true;
+			m_worker();
+		}
+		event_channel::write(event_channel::iteration_start, 0, static_cast<unsigned>(test_cases_amount));
+	}
+
+	// Later boost versions also pass the root test unit id:
+	virtual void test_start(counter_t test_cases_amount, test_unit_id /*root_id*/)
+	{
+		test_start(test_cases_amount);
 	}
 
 	virtual void test_finish()
 	{
-		std::cout << "#finish" << std::endl;
+		event_channel::write(event_channel::iteration_finish);
 	}
 
 	virtual void test_aborted()
 	{
-		std::cout << "#aborted" << std::endl;
+		event_channel::write(event_channel::aborted);
 	}
 
 	virtual void test_unit_start(test_unit const& tu)
 	{
-		std::cout << "#unit_start " << tu.p_id << std::endl;
+		passed_assertions() = 0;
+		event_channel::write(event_channel::unit_start, tu.p_id);
+		if (is_test_case(tu))
+			event_channel::flush();
 	}
 
 	virtual void test_unit_finish(test_unit const& tu, unsigned long elapsed)
 	{
-		std::cout << "#unit_finish " << tu.p_id << " " << elapsed << std::endl;
+		report_passed_assertions(tu.p_id);
+		event_channel::write(event_channel::unit_finish, tu.p_id, static_cast<unsigned>(elapsed));
 	}
 
 	virtual void test_unit_skipped(test_unit const& tu)
 	{
-		std::cout << "#unit_skipped " << tu.p_id << std::endl;
+#ifdef BOOST_TEST_API_3
+		// A worker runs only the test cases of its batch, the others are not skipped.
+		if (m_in_worker && m_batches && !tu.is_enabled())
+			return;
+#endif
+		event_channel::write(event_channel::unit_skipped, tu.p_id);
 	}
 
 	virtual void test_unit_aborted(test_unit const& tu)
 	{
-		std::cout << "#unit_aborted " << tu.p_id << std::endl;
+		event_channel::write(event_channel::unit_aborted, tu.p_id);
 	}
 
 	virtual void assertion_result(bool passed)
 	{
-		std::cout << "#assertion " << passed << std::endl;
+		if (passed)
+			++passed_assertions();
+		else
+			event_channel::write(event_channel::assertion, 0, passed);
+	}
+
+#ifdef BOOST_TEST_API_3
+	virtual void assertion_result(boost::unit_test::assertion_result ar)
+	{
+		if (ar != AR_TRIGGERED)
+			assertion_result(ar == AR_PASSED);
 	}
+#endif
 
 	virtual void exception_caught(boost::execution_exception const& e)
 	{
-		std::cout << "#exception " << e.what() << std::endl;
+		event_channel::write(event_channel::exception, 0, 0, std::string(e.what().begin(), e.what().end()));
 	}
+
+private:
+	worker_function m_worker;
+	bool m_in_worker;
+	bool m_batches;
 };
 
 } // namespace gui
@@ -119,31 +247,259 @@ private:
 #define BOOST_AUTO_TEST_CASE_ENABLE(name, enable) \
 	BOOST_AUTO_TEST_CASE(name, *::boost::unit_test::Enable(enable))
 
-#ifndef BOOST_TEST_NO_GUI_INIT
+namespace boost {
+namespace unit_test {
+namespace gui {
 
-boost::unit_test::test_suite* init_unit_test_suite(int argc, char* argv[])
+class test_case_selector : public test_tree_visitor
 {
-	for (int i = 1; i < argc; ++i)
+public:
+	explicit test_case_selector(const std::set<test_unit_id>& ids) : m_ids(ids)
+	{
+	}
+
+private:
+	virtual void visit(test_case const& tc)
+	{
+		framework::get(tc.p_id, TUT_CASE).p_default_status.value = m_ids.count(tc.p_id) ? test_unit::RS_ENABLED : test_unit::RS_DISABLED;
+	}
+
+	const std::set<test_unit_id>& m_ids;
+};
+
+// The number of workers to fork from the initialized test process, 0 for a single worker.
+inline int& zygote_workers()
+{
+	static int workers = 0;
+	return workers;
+}
+
+// Reads batches of test case ids from stdin, one id per line and an empty line
+// after each batch, and runs each batch as a test run of its own.
+// An empty batch or the end of stdin ends the worker.
+inline void run_worker()
+{
+#ifndef _WIN32
+	if (zygote_workers() > 0)
+		boosttestui::fork_workers(zygote_workers());
+#endif
+
+	for (;;)
+	{
+		event_channel::write(event_channel::waiting);
+
+		std::vector<std::string> batch;
+		if (!boosttestui::read_batch(batch))
+			break;
+
+		std::set<test_unit_id> ids;
+		for (std::vector<std::string>::const_iterator it = batch.begin(); it != batch.end(); ++it)
+			ids.insert(static_cast<test_unit_id>(std::strtoul(it->c_str(), 0, 10)));
+
+		test_case_selector selector(ids);
+		traverse_test_tree(framework::master_test_suite(), selector, true);
+		try
+		{
+			framework::run(framework::master_test_suite().p_id, false);
+		}
+		catch (std::exception& e)
+		{
+			event_channel::write(event_channel::exception, 0, 0, e.what());
+		}
+	}
+	event_channel::flush();
+	std::exit(boost::exit_success);
+}
+
+// The number of test runs of --gui_repeat, 0 repeats until a test fails.
+inline int& repeat_count()
+{
+	static int count = 1;
+	return count;
+}
+
+// Repeats the test run in this process, each run reports its own start and finish.
+// It stops after repeat_count() runs or at the first run that fails.
+inline void run_repeated()
+{
+	test_unit_id id = framework::master_test_suite().p_id;
+	bool passed = true;
+	for (int i = 0; passed && (repeat_count() == 0 || i < repeat_count()); ++i)
 	{
-		if (argv[i] == std::string("--gui_run"))
+		try
 		{
-			static boost::unit_test::gui::gui_observer observer;
-			boost::unit_test::framework::register_observer(observer);
+			framework::run(id, false);
+			passed = results_collector.results(id).passed();
+		}
+		catch (std::exception& e)
+		{
+			event_channel::write(event_channel::exception, 0, 0, e.what());
+			passed = false;
+		}
+	}
+	event_channel::flush();
+	std::exit(passed ? boost::exit_success : boost::exit_test_failure);
+}
+
+#ifndef _WIN32
+
+// The test case body that runs in the forked test process, it reports its assertions as usual.
+class isolated_test_body
+{
+public:
+	isolated_test_body(test_unit_id id, boost::function<void ()> const& func) :
+		m_id(id), m_func(func)
+	{
+	}
 
+	bool operator()() const
+	{
+		bool passed = unit_test_monitor.execute_and_translate(m_func) == unit_test_monitor_t::test_ok &&
+			results_collector.results(m_id).p_assertions_failed == 0;
+		report_passed_assertions(m_id);
+		return passed;
+	}
+
+private:
+	test_unit_id m_id;
+	boost::function<void ()> m_func;
+};
+
+// Runs a test case in a forked copy of the test process. A crash of the child
+// fails the test case and the run goes on.
+class isolated_test_case
+{
+public:
+	isolated_test_case(test_unit_id id, boost::function<void ()> const& func) :
+		m_id(id), m_body(id, func)
+	{
+	}
+
+	void operator()() const
+	{
+		// The child reported its assertions, only the results of this process are left to update.
+		switch (boosttestui::run_isolated(m_body))
+		{
+		case boosttestui::isolated_passed:
+			return results_collector.assertion_result(AR_PASSED);
+		case boosttestui::isolated_failed:
+			return results_collector.assertion_result(AR_FAILED);
+		default:
+			event_channel::write(event_channel::unit_aborted, m_id);
+			framework::assertion_result(AR_FAILED);
+		}
+	}
+
+private:
+	test_unit_id m_id;
+	isolated_test_body m_body;
+};
+
+class test_case_isolator : public test_tree_visitor
+{
+private:
+	virtual void visit(test_case const& tc)
+	{
+		// p_test_func is read-only outside of test_case, but the test case itself is not const.
+		boost::function<void ()>& func = const_cast<boost::function<void ()>&>(tc.p_test_func.get());
+		func = isolated_test_case(tc.p_id, func);
+	}
+};
+
+#endif // !_WIN32
+
+inline bool remove_arg(int& argc, char* argv[], const std::string& arg)
+{
+	for (int i = 1; i < argc; ++i)
+	{
+		if (argv[i] == arg)
+		{
 			while (i < argc)
 			{
 				argv[i] = argv[i + 1];
 				++i;
 			}
 			--argc;
-			break;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Removes an argument of the form arg=value.
+inline bool remove_arg(int& argc, char* argv[], const std::string& arg, std::string& value)
+{
+	const std::string prefix = arg + "=";
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::string(argv[i]).compare(0, prefix.size(), prefix) == 0)
+		{
+			value = argv[i] + prefix.size();
+			return remove_arg(argc, argv, argv[i]);
 		}
 	}
+	return false;
+}
+
+} // namespace gui
+} // namespace unit_test
+} // namespace boost
+
+#ifndef BOOST_TEST_NO_GUI_INIT
+
+boost::unit_test::test_suite* init_unit_test_suite(int argc, char* argv[])
+{
+	namespace ut = boost::unit_test;
 
+	if (!ut::gui::remove_arg(argc, argv, "--gui_run"))
+		return init_unit_test_suite2(argc, argv);
+
+	static ut::gui::gui_observer observer;
+	ut::framework::register_observer(observer);
+	bool worker = ut::gui::remove_arg(argc, argv, "--gui_worker");
+	std::string zygote;
+	if (ut::gui::remove_arg(argc, argv, "--gui_zygote", zygote))
+	{
+		ut::gui::zygote_workers() = std::atoi(zygote.c_str());
+		worker = true;
+	}
+	std::string repeat;
+	if (ut::gui::remove_arg(argc, argv, "--gui_repeat", repeat))
+		ut::gui::repeat_count() = std::atoi(repeat.c_str());
+	if (worker)
+		observer.set_worker(&ut::gui::run_worker, true);
+	else if (ut::gui::repeat_count() != 1)
+		observer.set_worker(&ut::gui::run_repeated, false);
+
+	std::string events;
+#ifdef _WIN32
+	ut::gui::remove_arg(argc, argv, "--gui_isolate");
+	ut::gui::remove_arg(argc, argv, "--gui_events", events);
 	return init_unit_test_suite2(argc, argv);
+#else
+	if (ut::gui::remove_arg(argc, argv, "--gui_events", events))
+	{
+		ut::gui::event_channel::open(std::atoi(events.c_str()));
+#if BOOST_VERSION >= 106000
+		// The framework prints its "Press any key to continue..." as test output.
+		if (ut::runtime_config::get<bool>(ut::runtime_config::btrt_wait_for_debugger))
+			ut::gui::event_channel::write(ut::gui::event_channel::waiting);
+#endif
+	}
+	bool isolate = ut::gui::remove_arg(argc, argv, "--gui_isolate");
+	ut::test_suite* p = init_unit_test_suite2(argc, argv);
+	if (isolate)
+	{
+		ut::gui::test_case_isolator isolator;
+		ut::traverse_test_tree(ut::framework::master_test_suite(), isolator, true);
+		if (p)
+			ut::traverse_test_tree(*p, isolator, true);
+	}
+	return p;
+#endif
 }
 
-extern "C" __declspec(dllexport) inline void unit_test_type_boost2()
+BOOST_TESTUI_EXPORT inline void unit_test_type_boost2()
 {
 }
 
@@ -274,7 +630,7 @@ public:
 
 	static void wait()
 	{
-		std::cout << "#waiting" << std::endl;
+		event_channel::write(event_channel::waiting);
 		std::getchar();
 	}
 
@@ -351,7 +707,7 @@ boost::unit_test::test_suite* init_unit_test_suite(int argc, char* argv[])
 	return p;
 }
 
-extern "C" __declspec(dllexport) inline void unit_test_type_boost()
+BOOST_TESTUI_EXPORT inline void unit_test_type_boost()
 {
 }
 
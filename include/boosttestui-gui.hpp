@@ -0,0 +1,274 @@
+//  (C) Copyright Gert-Jan de Vos 2012.
+//  Distributed under the Boost Software License, Version 1.0.
+//  (See accompanying file LICENSE_1_0.txt or copy at 
+//  http://www.boost.org/LICENSE_1_0.txt)
+
+//  See http://boosttestui.wordpress.com/ for the boosttestui home page.
+
+// The parts of the gui headers that do not depend on the test framework: the event channel,
+// the zygote that forks the workers, the batches of a worker and the forked test processes
+// of --gui_isolate. unit_test_gui.hpp, gtest-gui.h and catch-gui.hpp include it, keep it
+// in the same directory as those or in the include path.
+
+#ifndef BOOSTTESTUI_GUI_HPP
+#define BOOSTTESTUI_GUI_HPP
+
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#ifndef _WIN32
+#	include <cerrno>
+#	include <cstring>
+#	include <fcntl.h>
+#	include <stdint.h>
+#	include <sys/wait.h>
+#	include <unistd.h>
+#endif
+
+#ifndef BOOST_TESTUI_EXPORT
+#	ifdef _WIN32
+#		define BOOST_TESTUI_EXPORT extern "C" __declspec(dllexport)
+#	else
+#		define BOOST_TESTUI_EXPORT extern "C" __attribute__((used, visibility("default")))
+#	endif
+#endif
+
+namespace boosttestui {
+
+// Writes the test events as binary records to the event channel, a file descriptor
+// that the gui runner passes with --gui_events=<fd>. A record is, in native byte order:
+// uint32 size of the rest, uint8 type, uint32 id, uint32 value, uint32 text length, text.
+// Without an event channel, the framework header writes the events as text to stdout.
+//
+// The events are buffered and written in batches, together with the buffered stdout.
+// Failures, waiting and the end of an iteration flush right away, as does a full buffer
+// and the end of the process. The framework header also flushes at the start of each
+// test case: the runner must know which test case runs for its timeouts and to report
+// a crash.
+class event_channel
+{
+public:
+	enum type
+	{
+		hello, waiting, iteration_start, iteration_finish, aborted, unit_start, unit_finish,
+		unit_passed, unit_failed, unit_skipped, unit_aborted, assertion, exception,
+		unit_assertions
+	};
+
+	static bool is_open()
+	{
+		return descriptor() >= 0;
+	}
+
+	// The file descriptor of the channel, -1 when it is not open.
+	static int get_descriptor()
+	{
+		return descriptor();
+	}
+
+#ifndef _WIN32
+	static void open(int fd)
+	{
+		static bool registered = false;
+		if (!registered)
+			registered = std::atexit(&flush) == 0;
+
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
+		descriptor() = fd;
+		buffer().clear();
+		write(hello);
+	}
+#endif
+
+	// Test units have an id or a name, the root test suite has id 0 and an empty name.
+	static void write(type t, unsigned id = 0, unsigned value = 0, const std::string& text = std::string())
+	{
+#ifndef _WIN32
+		if (is_open())
+			append_record(t, id, value, text);
+#endif
+		if (flushes(t) || buffer().size() >= buffer_size)
+			flush();
+	}
+
+	// The output before the events must arrive first.
+	static void flush()
+	{
+		std::cout.flush();
+		std::fflush(stdout);
+#ifndef _WIN32
+		std::string& data = buffer();
+		for (std::size_t written = 0; written < data.size(); )
+		{
+			ssize_t n = ::write(descriptor(), data.data() + written, data.size() - written);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n <= 0)
+				break;
+			written += n;
+		}
+		data.clear();
+#endif
+	}
+
+private:
+	static const std::size_t buffer_size = 64 * 1024;
+
+	static int& descriptor()
+	{
+		static int fd = -1;
+		return fd;
+	}
+
+	static std::string& buffer()
+	{
+		static std::string data;
+		return data;
+	}
+
+	static bool flushes(type t)
+	{
+		switch (t)
+		{
+		case hello:
+		case waiting:
+		case iteration_finish:
+		case aborted:
+		case unit_failed:
+		case unit_aborted:
+		case assertion:
+		case exception:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+#ifndef _WIN32
+	static void append_record(type t, unsigned id, unsigned value, const std::string& text)
+	{
+		std::string& data = buffer();
+		put(data, static_cast<unsigned>(1 + 4 + 4 + 4 + text.size()));
+		data += static_cast<char>(t);
+		put(data, id);
+		put(data, value);
+		put(data, static_cast<unsigned>(text.size()));
+		data += text;
+	}
+
+	static void put(std::string& data, unsigned value)
+	{
+		uint32_t v = value;
+		data.append(reinterpret_cast<const char*>(&v), sizeof(v));
+	}
+#endif
+};
+
+// Set in a forked isolated test process, where the parent process reports the run framing.
+inline bool& isolated_test_process()
+{
+	static bool isolated = false;
+	return isolated;
+}
+
+// Reads the next batch of a worker from stdin: one test per line and an empty line
+// after the batch. An empty batch or the end of stdin ends the worker, then it
+// returns false.
+inline bool read_batch(std::vector<std::string>& batch)
+{
+	batch.clear();
+	std::string line;
+	while (std::getline(std::cin, line) && !line.empty())
+		batch.push_back(line);
+	return !batch.empty();
+}
+
+#ifndef _WIN32
+
+// Forks count workers and waits for them to finish. Worker i reads its batches from
+// file descriptor 3 + 2 * i and writes its output to file descriptor 4 + 2 * i.
+// With an event channel, the zygote has the one of worker 0 and worker i writes its
+// events to that file descriptor + 2 * i. Returns in the workers only.
+inline void fork_workers(int count)
+{
+	event_channel::flush();
+	int events = event_channel::get_descriptor();
+	int end = events >= 0 ? events + 2 * count : 3 + 2 * count;
+	for (int i = 0; i < count; ++i)
+	{
+		if (fork() == 0)
+		{
+			dup2(3 + 2 * i, STDIN_FILENO);
+			dup2(4 + 2 * i, STDOUT_FILENO);
+			dup2(4 + 2 * i, STDERR_FILENO);
+			int worker_events = events >= 0 ? events + 2 * i : -1;
+			for (int fd = 3; fd < end; ++fd)
+			{
+				if (fd != worker_events)
+					close(fd);
+			}
+			if (i > 0 && worker_events >= 0)
+				event_channel::open(worker_events);
+			return;
+		}
+	}
+
+	for (int fd = 3; fd < end; ++fd)
+		close(fd);
+	while (wait(0) > 0 || errno == EINTR)
+	{
+	}
+	std::exit(0);
+}
+
+enum isolated_result { isolated_passed, isolated_failed, isolated_crashed };
+
+// Exit codes of an isolated test process. Any other exit means it crashed, also exit
+// code 0: a test that calls exit(0) ends its test process before the test is done.
+const int isolated_exit_passed = 0x7d;
+const int isolated_exit_failed = 0x7e;
+
+// Runs a test in a forked copy of the test process: child() runs the test and returns
+// whether it passed. The child reports the test itself, the parent only tells apart a
+// crash, which it logs, from a test that passed or failed.
+template <class Child>
+isolated_result run_isolated(Child child)
+{
+	event_channel::flush();
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		isolated_test_process() = true;
+		bool passed = child();
+		event_channel::flush();
+		_exit(passed ? isolated_exit_passed : isolated_exit_failed);
+	}
+	if (pid < 0)
+	{
+		std::cout << "Cannot start test process: " << std::strerror(errno) << std::endl;
+		return isolated_crashed;
+	}
+
+	int status = 0;
+	while (waitpid(pid, &status, 0) < 0 && errno == EINTR)
+	{
+	}
+	if (WIFEXITED(status) && WEXITSTATUS(status) == isolated_exit_passed)
+		return isolated_passed;
+	if (WIFEXITED(status) && WEXITSTATUS(status) == isolated_exit_failed)
+		return isolated_failed;
+
+	if (WIFSIGNALED(status))
+		std::cout << "Test process " << pid << " killed by signal " << WTERMSIG(status) << ": " << strsignal(WTERMSIG(status)) << std::endl;
+	else
+		std::cout << "Test process " << pid << " exited with code " << WEXITSTATUS(status) << std::endl;
+	return isolated_crashed;
+}
+
+#endif // !_WIN32
+
+} // namespace boosttestui
+
+#endif // BOOSTTESTUI_GUI_HPP
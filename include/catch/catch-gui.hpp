@@ -17,8 +17,20 @@
 
 #ifdef CATCH_GUI_CONFIG_MAIN
 
+#include "boosttestui-gui.hpp"
+
 namespace Catch {
 
+    // The binary event channel of boosttestui-gui.hpp, without one the reporter writes the events as '#' lines.
+    struct BoostTestUiEvents : boosttestui::event_channel
+    {
+        // Test cases are named, the root test suite has an empty name.
+        static void write(type t, unsigned value = 0, std::string const& name = std::string())
+        {
+            boosttestui::event_channel::write(t, 0, value, name);
+        }
+    };
+
     struct BoostTestUiReporter : StreamingReporterBase
 	{
         BoostTestUiReporter(ReporterConfig const& _config) :
@@ -36,6 +48,8 @@ namespace Catch {
 
         virtual void skipTest(TestCaseInfo const& testInfo) CATCH_OVERRIDE
 		{
+            if (BoostTestUiEvents::is_open())
+                return writeEvent(BoostTestUiEvents::unit_skipped, 0, testInfo.name);
             stream  << "#TestIgnored " << testInfo.name << "\n";
         }
 
@@ -46,13 +60,29 @@ namespace Catch {
         virtual void testGroupStarting(GroupInfo const& groupInfo) CATCH_OVERRIDE
 		{
             StreamingReporterBase::testGroupStarting( groupInfo );
-			stream << "#RunStarted " << groupInfo.groupsCounts << "\n";
+            if (boosttestui::isolated_test_process())
+                return;
+            if (BoostTestUiEvents::is_open())
+            {
+                writeEvent(BoostTestUiEvents::iteration_start, static_cast<unsigned>(groupInfo.groupsCounts));
+                writeEvent(BoostTestUiEvents::unit_start);
+            }
+            else
+                stream << "#RunStarted " << groupInfo.groupsCounts << "\n";
         }
 
         virtual void testGroupEnded(TestGroupStats const& testGroupStats) CATCH_OVERRIDE
 		{
             StreamingReporterBase::testGroupEnded( testGroupStats );
-            stream << "#RunFinished\n";
+            if (boosttestui::isolated_test_process())
+                return;
+            if (BoostTestUiEvents::is_open())
+            {
+                writeEvent(BoostTestUiEvents::unit_finish);
+                writeEvent(BoostTestUiEvents::iteration_finish);
+            }
+            else
+                stream << "#RunFinished\n";
         }
 
         virtual void assertionStarting(AssertionInfo const&) CATCH_OVERRIDE
@@ -122,7 +152,14 @@ namespace Catch {
                         "  " << result.getExpandedExpression() << "\n";
                 }
 				stream << "\n";
-                stream << msg.str() << "#Assertion " << (result.isOk() ? 1 : 0) <<  "\n";
+                stream << msg.str();
+                // Passed assertions are counted per test case, see testCaseEnded().
+                if (result.isOk())
+                    return true;
+                if (BoostTestUiEvents::is_open())
+                    writeEvent(BoostTestUiEvents::assertion, 0);
+                else
+                    stream << "#Assertion 0\n";
             }
             return true;
         }
@@ -136,16 +173,33 @@ namespace Catch {
         virtual void testCaseStarting(TestCaseInfo const& testInfo) CATCH_OVERRIDE
 		{
             StreamingReporterBase::testCaseStarting(testInfo);
-            stream << "#TestStarted " << testInfo.name << "\n";
+            if (BoostTestUiEvents::is_open())
+                writeEvent(BoostTestUiEvents::unit_start, 0, testInfo.name);
+            else
+                stream << "#TestStarted " << testInfo.name << "\n";
+            stream.flush();
+            BoostTestUiEvents::flush();
         }
 
         virtual void testCaseEnded(TestCaseStats const& testCaseStats) CATCH_OVERRIDE
 		{
             StreamingReporterBase::testCaseEnded(testCaseStats);			
+            std::size_t passed = testCaseStats.totals.assertions.passed;
+            if (BoostTestUiEvents::is_open() && passed > 0)
+                writeEvent(BoostTestUiEvents::unit_assertions, static_cast<unsigned>(passed), testCaseStats.testInfo.name);
+            else if (passed > 0)
+                stream << "#TestAssertions " << passed << " " << testCaseStats.testInfo.name << "\n";
+            if (BoostTestUiEvents::is_open())
+                return writeEvent(testCaseStats.totals.testCases.allOk() ? BoostTestUiEvents::unit_passed : BoostTestUiEvents::unit_failed, 0, testCaseStats.testInfo.name);
             stream << "#TestFinished " << (testCaseStats.totals.testCases.allOk() ? "1" : "0") << " " << testCaseStats.testInfo.name << "\n";
         }
 
     private:
+        void writeEvent(BoostTestUiEvents::type type, unsigned value = 0, std::string const& name = std::string())
+        {
+            BoostTestUiEvents::write(type, value, name);
+        }
+
         void printSectionHeader(std::ostream& os)
 		{
             assert(!m_sectionStack.empty());
@@ -195,28 +249,213 @@ namespace Catch {
 
 } // end namespace Catch
 
+#ifndef _WIN32
+
+// Runs one test case in the isolated test process.
+class IsolatedCatchTest
+{
+public:
+	IsolatedCatchTest(Catch::Session& session, const std::string& name) :
+		m_session(session), m_name(name)
+	{
+	}
+
+	bool operator()() const
+	{
+		Catch::ConfigData config = m_session.configData();
+		config.testsOrTags.assign(1, '"' + m_name + '"');
+		m_session.useConfigData(config);
+		return m_session.run() == 0;
+	}
+
+private:
+	Catch::Session& m_session;
+	std::string m_name;
+};
+
+// Runs each selected test case in a forked process of its own. A test case that
+// crashes its process is reported as aborted and the run continues with the next one.
+inline int RunIsolatedTests(Catch::Session& session)
+{
+	std::vector<Catch::TestCase> testCases = Catch::filterTests(Catch::getAllTestCasesSorted(session.config()), session.config().testSpec(), session.config());
+
+	bool events = Catch::BoostTestUiEvents::is_open();
+	if (events)
+	{
+		Catch::BoostTestUiEvents::write(Catch::BoostTestUiEvents::iteration_start, static_cast<unsigned>(testCases.size()));
+		Catch::BoostTestUiEvents::write(Catch::BoostTestUiEvents::unit_start);
+	}
+	else
+		std::cout << "#RunStarted " << testCases.size() << std::endl;
+	int failed = 0;
+	for (std::vector<Catch::TestCase>::const_iterator it = testCases.begin(); it != testCases.end(); ++it)
+	{
+		const std::string& name = it->getTestCaseInfo().name;
+		boosttestui::isolated_result result = boosttestui::run_isolated(IsolatedCatchTest(session, name));
+		if (result == boosttestui::isolated_passed)
+			continue;
+		++failed;
+		if (result == boosttestui::isolated_failed)
+			continue;
+
+		if (events)
+		{
+			Catch::BoostTestUiEvents::write(Catch::BoostTestUiEvents::unit_aborted, 0, name);
+			Catch::BoostTestUiEvents::write(Catch::BoostTestUiEvents::unit_failed, 0, name);
+			continue;
+		}
+		std::cout << "#TestAborted " << name << std::endl;
+		std::cout << "#TestFinished 0 " << name << std::endl;
+	}
+	if (events)
+	{
+		Catch::BoostTestUiEvents::write(Catch::BoostTestUiEvents::unit_finish);
+		Catch::BoostTestUiEvents::write(Catch::BoostTestUiEvents::iteration_finish);
+	}
+	else
+		std::cout << "#RunFinished" << std::endl;
+	return failed;
+}
+
+#endif // !_WIN32
+
+inline void WriteCatchWaiting()
+{
+	if (Catch::BoostTestUiEvents::is_open())
+		Catch::BoostTestUiEvents::write(Catch::BoostTestUiEvents::waiting);
+	else
+		std::cout << "#Waiting" << std::endl;
+}
+
+// Reads batches of test names from stdin, one name per line and an empty line
+// after each batch, and runs each batch as a test run of its own.
+// An empty batch or the end of stdin ends the worker.
+inline int RunCatchWorker(Catch::Session& session, bool isolate)
+{
+
+	for (;;)
+	{
+		WriteCatchWaiting();
+
+		std::vector<std::string> names;
+		if (!boosttestui::read_batch(names))
+			return 0;
+		for (std::vector<std::string>::iterator it = names.begin(); it != names.end(); ++it)
+			*it = '"' + *it + '"';
+
+		Catch::ConfigData config = session.configData();
+		config.testsOrTags = names;
+		session.useConfigData(config);
+#ifndef _WIN32
+		if (isolate)
+		{
+			RunIsolatedTests(session);
+			continue;
+		}
+#endif
+		session.run();
+	}
+}
+
+// Repeats the test run in this process, each run reports its own start and finish.
+// It stops after count runs or at the first run that fails, count 0 has no limit.
+inline int RunCatchRepeated(Catch::Session& session, bool isolate, int count)
+{
+	int result = 0;
+	for (int i = 0; result == 0 && (count == 0 || i < count); ++i)
+	{
+#ifndef _WIN32
+		if (isolate)
+		{
+			result = RunIsolatedTests(session);
+			continue;
+		}
+#else
+		(void)isolate;
+#endif
+		result = session.run();
+	}
+	return result;
+}
+
 int main(int argc, char* argv[])
 {
 	const std::string gui_wait = "--gui_wait";
-	for (int i = 1; i < argc; ++i)
+	const std::string gui_worker = "--gui_worker";
+	const std::string gui_isolate = "--gui_isolate";
+	const std::string gui_zygote = "--gui_zygote=";
+	const std::string gui_events = "--gui_events=";
+	const std::string gui_repeat = "--gui_repeat=";
+	bool wait = false;
+	bool worker = false;
+	bool isolate = false;
+	int zygote = 0;
+	int repeat = 1;
+	int i = 1;
+	while (i < argc)
 	{
 		if (argv[i] == gui_wait)
+			wait = true;
+		else if (argv[i] == gui_worker)
+			worker = true;
+		else if (argv[i] == gui_isolate)
+			// Fork-per-test isolation needs POSIX fork(), it is ignored on Windows.
+			isolate = true;
+		else if (std::string(argv[i]).compare(0, gui_zygote.size(), gui_zygote) == 0)
+		{
+			// Fork the workers from this initialized process, POSIX only.
+			zygote = std::atoi(argv[i] + gui_zygote.size());
+			worker = true;
+		}
+		else if (std::string(argv[i]).compare(0, gui_repeat.size(), gui_repeat) == 0)
+			repeat = std::atoi(argv[i] + gui_repeat.size());
+		else if (std::string(argv[i]).compare(0, gui_events.size(), gui_events) == 0)
+		{
+			// The binary event channel needs an inherited file descriptor, POSIX only.
+#ifndef _WIN32
+			Catch::BoostTestUiEvents::open(std::atoi(argv[i] + gui_events.size()));
+#endif
+		}
+		else
 		{
-			std::cout << "#Waiting" << std::endl;
-			std::getchar();
-			for (int j = i; j < argc; ++j)
-				argv[j] = argv[j + 1];
-			--argc;
-			break;
+			++i;
+			continue;
 		}
+		for (int j = i; j < argc; ++j)
+			argv[j] = argv[j + 1];
+		--argc;
 	}
-    return Catch::Session().run(argc, argv);
+
+	if (wait)
+	{
+		WriteCatchWaiting();
+		std::getchar();
+	}
+
+	if (!worker && !isolate && repeat == 1)
+		return Catch::Session().run(argc, argv);
+
+	Catch::Session session;
+	int result = session.applyCommandLine(argc, argv);
+	if (result != 0)
+		return result;
+#ifndef _WIN32
+	if (zygote > 0)
+		boosttestui::fork_workers(zygote);
+#endif
+	if (worker)
+		return RunCatchWorker(session, isolate);
+	if (repeat != 1)
+		return RunCatchRepeated(session, isolate, repeat);
+#ifndef _WIN32
+	return RunIsolatedTests(session);
+#else
+	return session.run();
+#endif
 }
 
-#if _WIN32
-extern "C" __declspec(dllexport) void unit_test_type_catch()
+BOOST_TESTUI_EXPORT void unit_test_type_catch()
 {
 }
-#endif
 
 #endif // CATCH_GUI_CONFIG_MAIN
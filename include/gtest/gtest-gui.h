@@ -1,11 +1,340 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <ctime>
 #include <iostream>
+#include <random>
 #include <string>
+#include <utility>
+#include <vector>
 #include "gtest/gtest.h"
+#include "boosttestui-gui.hpp"
 
 namespace testing {
 
+namespace gui {
+
+typedef boosttestui::event_channel EventChannel;
+
+// Test units are named, the root test suite has an empty name.
+inline void WriteEvent(EventChannel::type type, unsigned value = 0, const std::string& name = std::string())
+{
+	EventChannel::write(type, 0, value, name);
+}
+
+inline std::string FullName(const TestInfo& info)
+{
+	return std::string(info.test_case_name()) + "." + info.name();
+}
+
+// Sends the test events to the event channel.
+class EventListener : public EmptyTestEventListener
+{
+public:
+	virtual void OnTestIterationStart(const UnitTest& unitTest, int /*iteration*/)
+	{
+		if (boosttestui::isolated_test_process())
+			return;
+		WriteEvent(EventChannel::iteration_start, unitTest.test_to_run_count());
+		WriteEvent(EventChannel::unit_start);
+	}
+
+	virtual void OnTestCaseStart(const TestCase& testCase)
+	{
+		if (!boosttestui::isolated_test_process())
+			WriteEvent(EventChannel::unit_start, 0, testCase.name());
+	}
+
+	virtual void OnTestStart(const TestInfo& info)
+	{
+		WriteEvent(EventChannel::unit_start, 0, FullName(info));
+		EventChannel::flush();
+	}
+
+	virtual void OnTestPartResult(const TestPartResult& result)
+	{
+		if (result.failed())
+			WriteEvent(EventChannel::assertion, 0);
+	}
+
+	virtual void OnTestEnd(const TestInfo& info)
+	{
+		WriteEvent(info.result()->Failed() ? EventChannel::unit_failed : EventChannel::unit_passed, static_cast<unsigned>(info.result()->elapsed_time()), FullName(info));
+	}
+
+	virtual void OnTestCaseEnd(const TestCase& testCase)
+	{
+		if (!boosttestui::isolated_test_process())
+			WriteEvent(EventChannel::unit_finish, static_cast<unsigned>(testCase.elapsed_time()), testCase.name());
+	}
+
+	virtual void OnTestIterationEnd(const UnitTest& unitTest, int /*iteration*/)
+	{
+		if (boosttestui::isolated_test_process())
+			return;
+		WriteEvent(EventChannel::unit_finish, static_cast<unsigned>(unitTest.elapsed_time()));
+		WriteEvent(EventChannel::iteration_finish);
+	}
+};
+
+inline void WriteWaiting()
+{
+	if (EventChannel::is_open())
+		WriteEvent(EventChannel::waiting);
+	else
+		std::cout << "#waiting" << std::endl;
+}
+
+} // namespace gui
+
+#ifndef _WIN32
+
+namespace gui {
+
+// Lets gtest apply its filter, disabled test and sharding flags to TestInfo::should_run(),
+// without running the tests: RUN_ALL_TESTS() selects the tests before it lists them.
+inline void SelectTests()
+{
+	const bool listTests = GTEST_FLAG(list_tests);
+	const std::string output = GTEST_FLAG(output);
+	GTEST_FLAG(list_tests) = true;
+	GTEST_FLAG(output) = "";
+
+	std::fflush(stdout);
+	int savedStdout = dup(STDOUT_FILENO);
+	int null = open("/dev/null", O_WRONLY);
+	if (null >= 0)
+	{
+		dup2(null, STDOUT_FILENO);
+		close(null);
+	}
+	int result = RUN_ALL_TESTS();
+	(void)result;
+	std::fflush(stdout);
+	dup2(savedStdout, STDOUT_FILENO);
+	close(savedStdout);
+
+	GTEST_FLAG(list_tests) = listTests;
+	GTEST_FLAG(output) = output;
+}
+
+// Forwards only the test case events to the default printer. The parent process
+// prints the iteration and test suite framing around the isolated test processes.
+class IsolatedTestPrinter : public EmptyTestEventListener
+{
+public:
+	explicit IsolatedTestPrinter(TestEventListener* pPrinter) :
+		m_pPrinter(pPrinter)
+	{
+	}
+
+	~IsolatedTestPrinter()
+	{
+		delete m_pPrinter;
+	}
+
+	virtual void OnTestStart(const TestInfo& info)
+	{
+		m_pPrinter->OnTestStart(info);
+	}
+
+	virtual void OnTestPartResult(const TestPartResult& result)
+	{
+		m_pPrinter->OnTestPartResult(result);
+	}
+
+	virtual void OnTestEnd(const TestInfo& info)
+	{
+		m_pPrinter->OnTestEnd(info);
+	}
+
+private:
+	TestEventListener* m_pPrinter;
+};
+
+inline bool RunIsolatedTest(const std::string& name)
+{
+	// The parent process applied the sharding, this process runs the one test.
+	unsetenv("GTEST_TOTAL_SHARDS");
+	unsetenv("GTEST_SHARD_INDEX");
+
+	TestEventListeners& listeners = UnitTest::GetInstance()->listeners();
+	if (TestEventListener* pPrinter = listeners.Release(listeners.default_result_printer()))
+		listeners.Append(new IsolatedTestPrinter(pPrinter));
+
+	GTEST_FLAG(filter) = name;
+	return RUN_ALL_TESTS() == 0;
+}
+
+inline long ElapsedMs(std::chrono::steady_clock::time_point start)
+{
+	return static_cast<long>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+}
+
+inline const char* Plural(size_t n, const char* single, const char* plural)
+{
+	return n == 1 ? single : plural;
+}
+
+// Runs each selected test in a forked process of its own. A test that crashes
+// its process is reported as aborted and the run continues with the next test.
+inline int RunIsolatedTests()
+{
+	typedef std::vector<std::string> Names;
+	typedef std::vector<std::pair<std::string, Names> > Suites;
+
+	SelectTests();
+	UnitTest& unitTest = *UnitTest::GetInstance();
+	Suites suites;
+	size_t testCount = 0;
+	for (int i = 0; i < unitTest.total_test_case_count(); ++i)
+	{
+		const TestCase& testCase = *unitTest.GetTestCase(i);
+		Names names;
+		for (int j = 0; j < testCase.total_test_count(); ++j)
+		{
+			const TestInfo& info = *testCase.GetTestInfo(j);
+			if (info.should_run())
+				names.push_back(FullName(info));
+		}
+		if (names.empty())
+			continue;
+		testCount += names.size();
+		suites.push_back(std::make_pair(testCase.name(), names));
+	}
+
+	// Shuffles the test suites and the tests in each suite, like gtest does.
+	if (GTEST_FLAG(shuffle))
+	{
+		int seed = GTEST_FLAG(random_seed) != 0 ? GTEST_FLAG(random_seed) : static_cast<int>(std::time(0) % 99999) + 1;
+		std::cout << "Note: Randomizing tests' orders with a seed of " << seed << " ." << std::endl;
+		std::mt19937 random(seed);
+		std::shuffle(suites.begin(), suites.end(), random);
+		for (Suites::iterator suite = suites.begin(); suite != suites.end(); ++suite)
+			std::shuffle(suite->second.begin(), suite->second.end(), random);
+	}
+
+	bool events = EventChannel::is_open();
+	if (events)
+	{
+		WriteEvent(EventChannel::iteration_start, static_cast<unsigned>(testCount));
+		WriteEvent(EventChannel::unit_start);
+	}
+	std::cout << "[==========] Running " << testCount << Plural(testCount, " test", " tests") << " from " << suites.size() << Plural(suites.size(), " test suite.", " test suites.") << std::endl;
+	std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+	size_t passed = 0;
+	for (Suites::const_iterator suite = suites.begin(); suite != suites.end(); ++suite)
+	{
+		const Names& names = suite->second;
+		if (events)
+			WriteEvent(EventChannel::unit_start, 0, suite->first);
+		std::cout << "[----------] " << names.size() << Plural(names.size(), " test", " tests") << " from " << suite->first << std::endl;
+		std::chrono::steady_clock::time_point suiteStart = std::chrono::steady_clock::now();
+		for (Names::const_iterator name = names.begin(); name != names.end(); ++name)
+		{
+			std::chrono::steady_clock::time_point testStart = std::chrono::steady_clock::now();
+			const std::string& test = *name;
+			boosttestui::isolated_result result = boosttestui::run_isolated([&test] { return RunIsolatedTest(test); });
+			if (result == boosttestui::isolated_passed)
+				++passed;
+			if (result != boosttestui::isolated_crashed)
+				continue;
+
+			if (events)
+			{
+				WriteEvent(EventChannel::unit_aborted, 0, *name);
+				WriteEvent(EventChannel::unit_failed, static_cast<unsigned>(ElapsedMs(testStart)), *name);
+			}
+			else
+				std::cout << "#unit_aborted " << *name << std::endl;
+			std::cout << "[  FAILED  ] " << *name << " (" << ElapsedMs(testStart) << " ms)" << std::endl;
+		}
+		std::cout << "[----------] " << names.size() << Plural(names.size(), " test", " tests") << " from " << suite->first << " (" << ElapsedMs(suiteStart) << " ms total)\n" << std::endl;
+		if (events)
+			WriteEvent(EventChannel::unit_finish, static_cast<unsigned>(ElapsedMs(suiteStart)), suite->first);
+	}
+	std::cout << "[==========] " << testCount << Plural(testCount, " test", " tests") << " from " << suites.size() << Plural(suites.size(), " test suite", " test suites") << " ran. (" << ElapsedMs(runStart) << " ms total)" << std::endl;
+	if (events)
+	{
+		WriteEvent(EventChannel::unit_finish, static_cast<unsigned>(ElapsedMs(runStart)));
+		WriteEvent(EventChannel::iteration_finish);
+	}
+	std::cout << "[  PASSED  ] " << passed << Plural(passed, " test.", " tests.") << std::endl;
+	if (passed < testCount)
+		std::cout << "[  FAILED  ] " << testCount - passed << Plural(testCount - passed, " test.", " tests.") << std::endl;
+	return passed == testCount ? 0 : 1;
+}
+
+} // namespace gui
+
+#endif // !_WIN32
+
+// Reads batches of test names from stdin, one name per line and an empty line
+// after each batch, and runs each batch as a test iteration of its own.
+// An empty batch or the end of stdin ends the worker.
+inline void RunGoogleTestWorker(bool isolate)
+{
+	for (;;)
+	{
+		gui::WriteWaiting();
+
+		std::vector<std::string> batch;
+		if (!boosttestui::read_batch(batch))
+			break;
+
+		std::string filter;
+		for (std::vector<std::string>::const_iterator it = batch.begin(); it != batch.end(); ++it)
+		{
+			if (!filter.empty())
+				filter += ':';
+			filter += *it;
+		}
+
+		GTEST_FLAG(filter) = filter;
+		// The gui runner gets the results from the output.
+#ifndef _WIN32
+		if (isolate)
+		{
+			gui::RunIsolatedTests();
+			continue;
+		}
+#endif
+		int failed = RUN_ALL_TESTS();
+		(void)failed;
+	}
+	gui::EventChannel::flush();
+	std::exit(0);
+}
+
+// Repeats the test run in this process, each run is a test iteration of its own.
+// It stops after count runs or at the first run that fails, count 0 has no limit.
+inline int RunGoogleTestRepeated(bool isolate, int count)
+{
+	int result = 0;
+	for (int i = 0; result == 0 && (count == 0 || i < count); ++i)
+	{
+#ifndef _WIN32
+		if (isolate)
+		{
+			result = gui::RunIsolatedTests();
+			continue;
+		}
+#else
+		(void)isolate;
+#endif
+		result = RUN_ALL_TESTS();
+	}
+	return result;
+}
+
 void InitGoogleTestGui(int* argc, char** argv)
 {
+	bool wait = false;
+	bool worker = false;
+	bool isolate = false;
+	int zygote = 0;
+	int repeat = 1;
 	int arg = 1;
 	while (arg < *argc)
 	{
@@ -17,8 +346,34 @@ void InitGoogleTestGui(int* argc, char** argv)
 			value = opt.substr(p + 1);
 		if (name == "--gui_wait")
 		{
-			std::cout << "#waiting" << std::endl;
-			std::getchar();
+			wait = true;
+		}
+		else if (name == "--gui_events")
+		{
+			// The binary event channel needs an inherited file descriptor, POSIX only.
+#ifndef _WIN32
+			gui::EventChannel::open(std::atoi(value.c_str()));
+			UnitTest::GetInstance()->listeners().Append(new gui::EventListener);
+#endif
+		}
+		else if (name == "--gui_worker")
+		{
+			worker = true;
+		}
+		else if (name == "--gui_zygote")
+		{
+			// Fork the workers from this initialized process, POSIX only.
+			zygote = std::atoi(value.c_str());
+			worker = true;
+		}
+		else if (name == "--gui_isolate")
+		{
+			// Fork-per-test isolation needs POSIX fork(), it is ignored on Windows.
+			isolate = true;
+		}
+		else if (name == "--gui_repeat")
+		{
+			repeat = std::atoi(value.c_str());
 		}
 		else
 		{
@@ -30,10 +385,42 @@ void InitGoogleTestGui(int* argc, char** argv)
 		for (int i = arg; i < *argc; ++i)
 			argv[i] = argv[i + 1];
 	}
+
+	if (wait)
+	{
+		gui::WriteWaiting();
+		std::getchar();
+	}
+
+#ifndef _WIN32
+	if (zygote > 0)
+		boosttestui::fork_workers(zygote);
+#endif
+	if (worker)
+		RunGoogleTestWorker(isolate);
+
+	if (repeat != 1)
+	{
+		int result = RunGoogleTestRepeated(isolate, repeat);
+		gui::EventChannel::flush();
+		std::exit(result);
+	}
+
+#ifndef _WIN32
+	if (isolate)
+	{
+		int result = gui::RunIsolatedTests();
+		gui::EventChannel::flush();
+		std::exit(result);
+	}
+#else
+	(void)isolate;
+	(void)zygote;
+#endif
 }
 
 } // namespace testing
 
-extern "C" __declspec(dllexport) void unit_test_type_google()
+BOOST_TESTUI_EXPORT void unit_test_type_google()
 {
 }